@@ -53,6 +53,11 @@ mod ffi {
 
         pub cpu_opt_combo: String,
         pub custom_name_edit: String,
+
+        pub compiler_cache_combo: String,
+        pub compiler_cache_size: i32,
+        pub tmpfs_build_check: bool,
+        pub incremental_build_check: bool,
     }
 
     extern "Rust" {
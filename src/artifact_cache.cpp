@@ -0,0 +1,93 @@
+// Copyright (C) 2022-2024 Vladislav Nepogodin
+//
+// This file is part of CachyOS kernel manager.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include "artifact_cache.hpp"
+#include "utils.hpp"
+
+#include <filesystem>    // for exists, create_hard_link, copy_file, directory_iterator
+#include <system_error>  // for error_code
+
+#include <fmt/compile.h>
+#include <fmt/core.h>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// NOTE: packages of the single build take 200-300 MiB, together with the headers.
+constexpr std::size_t artifacts_limit = 4;
+
+}  // namespace
+
+namespace build {
+
+auto ArtifactCache::instance() noexcept -> ArtifactCache& {
+    static ArtifactCache cache{utils::fix_path("~/.cache/cachyos-km/artifacts")};
+    return cache;
+}
+
+auto ArtifactCache::get_entry_dir(std::string_view fingerprint) const noexcept -> std::string {
+    return fmt::format(FMT_COMPILE("{}/{}"), m_cache_dir, fingerprint);
+}
+
+auto ArtifactCache::find(std::string_view fingerprint) const noexcept -> std::optional<std::string> {
+    auto entry_dir = get_entry_dir(fingerprint);
+    std::error_code err_code{};
+    /* clang-format off */
+    if (!fs::is_directory(entry_dir, err_code) || fs::is_empty(entry_dir, err_code)) { return std::nullopt; }
+    /* clang-format on */
+    fs::last_write_time(entry_dir, fs::file_time_type::clock::now(), err_code);
+    return entry_dir;
+}
+
+auto ArtifactCache::hand_out(std::string_view fingerprint, std::string_view dest_dir) const noexcept -> bool {
+    std::error_code err_code{};
+    fs::create_directories(dest_dir, err_code);
+    if (err_code) {
+        fmt::print(stderr, "Failed to create {}: {}\n", dest_dir, err_code.message());
+        return false;
+    }
+
+    for (auto&& dir_entry : fs::directory_iterator{get_entry_dir(fingerprint), err_code}) {
+        const auto& dest_path = fs::path{dest_dir} / dir_entry.path().filename();
+        fs::remove(dest_path, err_code);
+        // NOTE: hardlinks don't work across the filesystems, the packages are copied then.
+        fs::create_hard_link(dir_entry.path(), dest_path, err_code);
+        if (err_code && !fs::copy_file(dir_entry.path(), dest_path, err_code)) {
+            fmt::print(stderr, "Failed to hand out {}: {}\n", dir_entry.path().string(), err_code.message());
+            return false;
+        }
+    }
+    return !err_code;
+}
+
+auto ArtifactCache::make_store_cmd(std::string_view fingerprint, std::string_view package_globs) const noexcept -> std::string {
+    const auto& entry_dir = get_entry_dir(fingerprint);
+
+    // the entry appears at once, so the interrupted store isn't taken for the cached build
+    const auto& quoted_dir      = utils::shell_quote(entry_dir);
+    const auto& quoted_temp_dir = utils::shell_quote(fmt::format(FMT_COMPILE("{}.tmp"), entry_dir));
+    // NOTE: the failed or canceled build doesn't evict anything. The least recently used entries are dropped
+    // only after the successful build, the stored entry is the newest one then and is kept.
+    const auto& quoted_cache_dir = utils::shell_quote(m_cache_dir);
+    return fmt::format(FMT_COMPILE("[ \"$build_status\" -eq 0 ] && {{ rm -rf -- {0} && mkdir -p -- {0} && {{ cp -l -- {1} {0}/ 2>/dev/null || cp -- {1} {0}/; }} && rm -rf -- {2} && mv -T -- {0} {2}; "
+                                   "ls -1dt -- {3}/*/ 2>/dev/null | tail -n +{4} | xargs -r -d '\\n' rm -rf --; }}"),
+        quoted_temp_dir, package_globs, quoted_dir, quoted_cache_dir, artifacts_limit + 1);
+}
+
+}  // namespace build
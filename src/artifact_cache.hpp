@@ -0,0 +1,62 @@
+// Copyright (C) 2022-2024 Vladislav Nepogodin
+//
+// This file is part of CachyOS kernel manager.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#ifndef ARTIFACT_CACHE_HPP
+#define ARTIFACT_CACHE_HPP
+
+#include <optional>     // for optional
+#include <string>       // for string
+#include <string_view>  // for string_view
+#include <utility>      // for move
+
+namespace build {
+
+/// @brief Packages of the finished builds, keyed by the fingerprint of the build inputs,
+/// so the build with the same inputs is skipped.
+///
+/// Each entry is a directory <cache>/<fingerprint> with the packages,
+/// only the most recently used entries are kept.
+class ArtifactCache {
+ public:
+    explicit ArtifactCache(std::string cache_dir) noexcept
+      : m_cache_dir(std::move(cache_dir)) { }
+
+    /// @brief Process-wide cache at ~/.cache/cachyos-km/artifacts.
+    static auto instance() noexcept -> ArtifactCache&;
+
+    /// @brief Directory with the packages of the build, nullopt if it isn't cached.
+    /// The entry becomes the most recently used one.
+    auto find(std::string_view fingerprint) const noexcept -> std::optional<std::string>;
+
+    /// @brief Links (or copies) the cached packages into dest_dir.
+    auto hand_out(std::string_view fingerprint, std::string_view dest_dir) const noexcept -> bool;
+
+    /// @brief Shell command, which stores the packages, if the build has succeeded.
+    /// Then the least recently used entries are dropped, the failed build keeps the cache as is.
+    /// @param package_globs Globs of the packages, relative to the build directory.
+    auto make_store_cmd(std::string_view fingerprint, std::string_view package_globs) const noexcept -> std::string;
+
+ private:
+    auto get_entry_dir(std::string_view fingerprint) const noexcept -> std::string;
+
+    std::string m_cache_dir{};
+};
+
+}  // namespace build
+
+#endif  // ARTIFACT_CACHE_HPP
@@ -17,6 +17,7 @@
 // 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
 
 #include "aur_kernel.hpp"
+#include "build_state.hpp"
 #include "utils.hpp"
 
 #include <cstdio>   // for perror
@@ -80,8 +81,14 @@ void install_aur_kernels(std::span<std::string_view> kernel_list) noexcept {
 
         prepare_build_environment(kernel_name);
 
+        // NOTE: the tree is kept out of the package repository, which is cleaned by git,
+        // so the build of the same commit resumes after the failure.
+        const auto& commit    = utils::exec("git rev-parse HEAD");
+        const auto& aur_build = build::plan_aur_build(kernel_name, commit, "i");
+        const auto& build_cmd = fmt::format("export BUILDDIR={}\n{}", utils::shell_quote(aur_build.build_dir), aur_build.script);
+
         // Run our build command!
-        utils::runCmdTerminal("makepkg -sicf --cleanbuild --skipchecksums", false);
+        utils::runCmdTerminal(QString::fromStdString(build_cmd), false);
     }
 }
 
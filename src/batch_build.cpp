@@ -0,0 +1,229 @@
+// Copyright (C) 2022-2024 Vladislav Nepogodin
+//
+// This file is part of CachyOS kernel manager.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include "batch_build.hpp"
+#include "artifact_cache.hpp"
+#include "build_job.hpp"
+#include "build_monitor.hpp"
+#include "build_telemetry.hpp"
+#include "utils.hpp"
+
+#include <cstdio>        // for fflush
+#include <filesystem>    // for absolute, exists, remove
+#include <optional>      // for optional
+#include <string_view>   // for string_view
+#include <system_error>  // for error_code
+#include <utility>       // for move
+
+#if defined(__clang__)
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wsign-conversion"
+#pragma clang diagnostic ignored "-Wshorten-64-to-32"
+#elif defined(__GNUC__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuseless-cast"
+#pragma GCC diagnostic ignored "-Wsign-conversion"
+#pragma GCC diagnostic ignored "-Wconversion"
+#pragma GCC diagnostic ignored "-Wsuggest-attribute=pure"
+#endif
+
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QProcess>
+
+#if defined(__clang__)
+#pragma clang diagnostic pop
+#elif defined(__GNUC__)
+#pragma GCC diagnostic pop
+#endif
+
+#include <fmt/compile.h>
+#include <fmt/core.h>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+struct BuildOutcome {
+    /// Why the build has failed, empty on success.
+    std::string error{};
+    double elapsed_secs{};
+    /// The packages were taken from the artifact cache.
+    bool cached{};
+};
+
+void print_event(const QJsonObject& event) noexcept {
+    const auto& event_line = QJsonDocument{event}.toJson(QJsonDocument::Compact);
+    fmt::print("{}\n", std::string_view{event_line.constData(), static_cast<std::size_t>(event_line.size())});
+    std::fflush(stdout);
+}
+
+auto run_job(const build::BuildJob& job, std::string_view packages_dir, const QString& config_name) noexcept -> BuildOutcome {
+    const auto& option_values = build::get_option_values(job.options);
+    if (!build::restore_pkgbuild(job.variant)) {
+        return {.error = "Failed to restore PKGBUILD"};
+    }
+
+    auto prepared = build::prepare_sources(job, option_values, {});
+    if (!prepared.patch_issues.empty()) {
+        std::string error{"Failed to fetch patches:"};
+        for (auto&& patch_issue : prepared.patch_issues) {
+            error += fmt::format(FMT_COMPILE(" {}: {};"), patch_issue.patch, patch_issue.reason);
+        }
+        return {.error = std::move(error)};
+    }
+    const auto& artifact_cache = build::ArtifactCache::instance();
+    if (prepared.fingerprint && artifact_cache.find(*prepared.fingerprint) && artifact_cache.hand_out(*prepared.fingerprint, packages_dir)) {
+        return {.cached = true};
+    }
+
+    auto planned_build = build::plan_build(job, option_values, std::move(prepared));
+    if (!planned_build.error.empty()) {
+        return {.error = std::move(planned_build.error)};
+    }
+
+    // NOTE: stdout is reserved for the progress events.
+    const auto& command = fmt::format(FMT_COMPILE("exec 1>&2\n{}\n{}"), planned_build.command, build::make_collect_packages_cmd(job, packages_dir));
+
+    build::BuildTracker build_tracker{job.variant, option_values, planned_build.log_file, planned_build.cgroup_file};
+    const auto& build_estimate = build::BuildHistory::instance().estimate(job.variant, build_tracker.get_record().options_key);
+
+    // nobody is there to answer, e.g. pacman takes the default answers
+    QProcess build_process{};
+    build_process.setProcessChannelMode(QProcess::ForwardedChannels);
+    build_process.setStandardInputFile(QProcess::nullDevice());
+    build_process.setWorkingDirectory(QString::fromStdString(planned_build.working_path));
+    build_process.start(QStringLiteral("bash"), {QStringLiteral("-c"), QString::fromStdString(command)});
+    if (!build_process.waitForStarted()) {
+        return {.error = "Failed to start the build"};
+    }
+
+    std::optional<build::BuildPhase> reported_phase{};
+    while (!build_process.waitForFinished(1000) && build_process.state() != QProcess::NotRunning) {
+        build_tracker.poll();
+        // NOTE: nothing else is running in the batch mode, so /proc is walked right here.
+        if (build_tracker.is_sampling_process_tree()) {
+            build_tracker.add_process_tree_sample(build::ResourceSampler::read({}).counters);
+        }
+        const auto current_phase = build_tracker.get_current_phase();
+        /* clang-format off */
+        if (!current_phase || current_phase == reported_phase) { continue; }
+        /* clang-format on */
+        reported_phase = current_phase;
+
+        const auto& phase_name = build::build_phase_names[static_cast<std::size_t>(*current_phase)];
+        QJsonObject phase_event{
+            {"event", "phase"},
+            {"config", config_name},
+            {"phase", QString::fromUtf8(phase_name.data(), static_cast<qsizetype>(phase_name.size()))},
+            {"elapsed", build_tracker.get_elapsed_secs()},
+        };
+        if (build_estimate) {
+            phase_event.insert("eta", build_tracker.get_eta_secs(*build_estimate));
+        }
+        print_event(phase_event);
+    }
+
+    // the build ended without the status in its log, e.g. was killed
+    build_tracker.poll();
+    if (!build_tracker.is_finished()) {
+        build_tracker.finish(false);
+    }
+    build::BuildHistory::instance().append(build_tracker.get_record());
+
+    std::error_code err_code{};
+    const bool is_succeeded = fs::remove(fmt::format(FMT_COMPILE("{}/.done-status"), planned_build.working_path), err_code);
+    BuildOutcome outcome{.elapsed_secs = build_tracker.get_record().get_total_secs()};
+    if (!is_succeeded) {
+        outcome.error = fmt::format(FMT_COMPILE("makepkg has failed, see {}"), planned_build.log_file);
+    }
+    return outcome;
+}
+
+}  // namespace
+
+namespace build {
+
+auto run_batch_build(const BatchBuildArgs& args) noexcept -> std::int32_t {
+    // NOTE: the paths are resolved, before the working directory is changed to the repository.
+    std::vector<std::string> config_paths{};
+    for (auto&& config_file : args.config_files) {
+        config_paths.emplace_back(fs::absolute(config_file).string());
+    }
+    const auto& output_dir = fs::absolute(args.output_dir).string();
+    // the local patches too, e.g. "--patch ./fix.patch" or "fix.patch::./fix.patch", the URLs are kept as is
+    std::vector<std::string> patches{};
+    for (auto&& patch : args.patches) {
+        const auto name_end = patch.find("::");
+        const auto url_pos  = (name_end == std::string::npos) ? 0 : name_end + 2;
+        if (patch.find("://", url_pos) != std::string::npos) {
+            patches.emplace_back(patch);
+            continue;
+        }
+        patches.emplace_back(patch.substr(0, url_pos) + fs::absolute(patch.substr(url_pos)).string());
+    }
+
+    utils::prepare_build_environment();
+    if (!fs::exists(fmt::format(FMT_COMPILE("{}/PKGBUILD"), args.variant))) {
+        fmt::print(stderr, "Unknown kernel variant: {}\n", args.variant);
+        return 1;
+    }
+
+    std::int32_t succeeded_count{};
+    std::int32_t failed_count{};
+    for (std::size_t i = 0; i < config_paths.size(); ++i) {
+        const auto& config_path = config_paths[i];
+        const auto& config_name = fs::path{config_path}.stem().string();
+        const auto& config_qstr = QString::fromStdString(config_name);
+        print_event({
+            {"event", "start"},
+            {"config", config_qstr},
+            {"index", static_cast<qint64>(i + 1)},
+            {"total", static_cast<qint64>(config_paths.size())},
+            {"variant", QString::fromStdString(args.variant)},
+        });
+
+        const auto& packages_dir = fmt::format(FMT_COMPILE("{}/{}"), output_dir, config_name);
+        BuildOutcome outcome{.error = "Failed to parse the configuration"};
+        if (auto config_options = ConfigOptions::parse_from_file(config_path)) {
+            outcome = run_job(BuildJob{.variant = args.variant, .options = std::move(*config_options), .patches = patches, .compression = args.compression}, packages_dir, config_qstr);
+        }
+
+        const bool is_succeeded = outcome.error.empty();
+        QJsonObject finish_event{
+            {"event", "finish"},
+            {"config", config_qstr},
+            {"succeeded", is_succeeded},
+            {"elapsed", outcome.elapsed_secs},
+            {"cached", outcome.cached},
+        };
+        if (is_succeeded) {
+            finish_event.insert("packages", QString::fromStdString(packages_dir));
+            ++succeeded_count;
+        } else {
+            finish_event.insert("error", QString::fromStdString(outcome.error));
+            ++failed_count;
+        }
+        print_event(finish_event);
+    }
+
+    print_event({{"event", "summary"}, {"succeeded", succeeded_count}, {"failed", failed_count}});
+    return (failed_count == 0) ? 0 : 1;
+}
+
+}  // namespace build
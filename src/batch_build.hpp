@@ -0,0 +1,55 @@
+// Copyright (C) 2022-2024 Vladislav Nepogodin
+//
+// This file is part of CachyOS kernel manager.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#ifndef BATCH_BUILD_HPP
+#define BATCH_BUILD_HPP
+
+#include "build_command.hpp"
+
+#include <cstdint>  // for int32_t
+#include <string>   // for string
+#include <vector>   // for vector
+
+namespace build {
+
+struct BatchBuildArgs {
+    /// Directory of PKGBUILD in the repository, e.g. "linux-cachyos-bore".
+    std::string variant{};
+    /// Saved configurations, the kernel is built once per each of them.
+    std::vector<std::string> config_files{};
+    std::vector<std::string> patches{};
+    /// Packages of each build are moved into <output_dir>/<config name>.
+    std::string output_dir{};
+    /// The packages are usually published from the build host, so they are compressed as configured.
+    PackageCompression compression{PackageCompression::Default};
+};
+
+/// @brief Builds the variant with each configuration one after another, without any interaction.
+///
+/// Progress is printed to stdout as JSON, one event per line:
+///   {"event":"start","config":...,"index":1,"total":2,"variant":...}
+///   {"event":"phase","config":...,"phase":"build","elapsed":12.5,"eta":1800}
+///   {"event":"finish","config":...,"succeeded":true,"elapsed":...,"cached":false,"packages":...}
+///   {"event":"summary","succeeded":1,"failed":1}
+/// Output of the builds goes to stderr. Builds with the same inputs as before are taken from the artifact cache.
+/// @return 0 if all builds succeeded.
+auto run_batch_build(const BatchBuildArgs& args) noexcept -> std::int32_t;
+
+}  // namespace build
+
+#endif  // BATCH_BUILD_HPP
@@ -0,0 +1,335 @@
+// Copyright (C) 2022-2024 Vladislav Nepogodin
+//
+// This file is part of CachyOS kernel manager.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include "build_command.hpp"
+#include "utils.hpp"
+
+#include <algorithm>     // for min
+#include <array>         // for array
+#include <charconv>      // for from_chars
+#include <cstdlib>       // for getenv
+#include <filesystem>    // for exists, create_directories, permissions
+#include <optional>      // for optional
+#include <system_error>  // for error_code
+#include <thread>        // for hardware_concurrency
+
+#include <linux/magic.h>  // for TMPFS_MAGIC
+#include <sys/vfs.h>      // for statfs
+
+#include <fmt/compile.h>
+#include <fmt/core.h>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+constexpr std::uint64_t gib = 1024ULL * 1024ULL * 1024ULL;
+
+// NOTE: RAM left for the compiler processes and the rest of the system, while the tree is on tmpfs.
+constexpr std::uint64_t memory_reserve = 4 * gib;
+
+// NOTE: approximate peak memory of the single compile job, LTO keeps much more IR in memory.
+constexpr auto get_memory_per_job(std::string_view lto_mode) noexcept -> std::uint64_t {
+    using namespace std::string_view_literals;
+    if (lto_mode == "full"sv) {
+        return 3 * gib;
+    } else if (lto_mode == "thin"sv) {
+        return 2 * gib;
+    }
+    return gib;
+}
+
+// NOTE: zstd level 1 is several times faster than the usual levels of makepkg.conf,
+// while the packages are only ~10% larger.
+constexpr std::string_view fast_makepkg_conf = R"(source /etc/makepkg.conf
+for conf in /etc/makepkg.conf.d/*.conf; do
+    [[ -r $conf ]] && source "$conf"
+done
+COMPRESSZST=(zstd -c -T0 -1 -)
+)";
+
+// compilers, which the kernel build may invoke through PATH
+constexpr std::array compiler_names{"cc", "gcc", "c++", "g++", "clang", "clang++"};
+
+// NOTE: sccache can't masquerade as the compiler, unlike ccache,
+// so tiny wrappers are put in front of the real compilers.
+auto prepare_sccache_wrappers(const fs::path& wrappers_dir) noexcept -> bool {
+    std::error_code err_code{};
+    fs::create_directories(wrappers_dir, err_code);
+    if (err_code) {
+        fmt::print(stderr, "Failed to create sccache wrappers directory: {}\n", err_code.message());
+        return false;
+    }
+
+    for (auto&& compiler_name : compiler_names) {
+        const auto& compiler_path = fmt::format(FMT_COMPILE("/usr/bin/{}"), compiler_name);
+        /* clang-format off */
+        if (!fs::exists(compiler_path)) { continue; }
+        /* clang-format on */
+
+        const auto& wrapper_path = wrappers_dir / compiler_name;
+        const auto& wrapper_data = fmt::format(FMT_COMPILE("#!/bin/sh\nexec /usr/bin/sccache {} \"$@\"\n"), compiler_path);
+        if (!utils::write_to_file(wrapper_path.string(), wrapper_data)) {
+            return false;
+        }
+        fs::permissions(wrapper_path, fs::perms::owner_all | fs::perms::group_read | fs::perms::group_exec | fs::perms::others_read | fs::perms::others_exec, err_code);
+        if (err_code) {
+            fmt::print(stderr, "Failed to make sccache wrapper executable: {}\n", err_code.message());
+            return false;
+        }
+    }
+    return true;
+}
+
+auto get_meminfo_value(std::string_view field_name) noexcept -> std::uint64_t {
+    // the line looks like 'MemAvailable:   16123456 kB'
+    const auto& meminfo = utils::read_whole_file("/proc/meminfo");
+    for (auto&& line : utils::make_split_view(meminfo, '\n')) {
+        /* clang-format off */
+        if (!line.starts_with(field_name) || !line.substr(field_name.size()).starts_with(':')) { continue; }
+        /* clang-format on */
+
+        auto value_str = line.substr(field_name.size() + 1);
+        value_str.remove_prefix(std::min(value_str.find_first_not_of(' '), value_str.size()));
+
+        std::uint64_t value_kib{};
+        std::from_chars(value_str.data(), value_str.data() + value_str.size(), value_kib);
+        return value_kib * 1024;
+    }
+    return 0;
+}
+
+auto get_tmpfs_free_space(const char* mount_path) noexcept -> std::optional<std::uint64_t> {
+    struct statfs fs_info{};
+    if (::statfs(mount_path, &fs_info) != 0 || fs_info.f_type != TMPFS_MAGIC) {
+        return std::nullopt;
+    }
+    return static_cast<std::uint64_t>(fs_info.f_bavail) * static_cast<std::uint64_t>(fs_info.f_bsize);
+}
+
+// systemd-run --user needs the user manager, which isn't there e.g. under sudo
+auto has_systemd_user_manager() noexcept -> bool {
+    const char* runtime_dir = std::getenv("XDG_RUNTIME_DIR");
+    if (runtime_dir == nullptr || !fs::exists("/usr/bin/systemd-run")) {
+        return false;
+    }
+    return fs::exists(fmt::format(FMT_COMPILE("{}/bus"), runtime_dir));
+}
+
+constexpr auto to_gib(std::uint64_t size) noexcept -> double {
+    return static_cast<double>(size) / static_cast<double>(gib);
+}
+
+}  // namespace
+
+namespace build {
+
+void BuildCommand::set_launcher(std::string launcher) noexcept {
+    m_launcher = std::move(launcher);
+}
+
+void BuildCommand::set_env(std::string_view name, std::string_view value) noexcept {
+    m_env.emplace_back(name, value);
+}
+
+void BuildCommand::prepend_path(std::string_view dir) noexcept {
+    m_path_dirs.emplace_back(dir);
+}
+
+void BuildCommand::add_pre_step(std::string cmd) noexcept {
+    m_pre_steps.emplace_back(std::move(cmd));
+}
+
+void BuildCommand::add_post_step(std::string cmd) noexcept {
+    m_post_steps.emplace_back(std::move(cmd));
+}
+
+void BuildCommand::set_log_file(std::string log_file, std::string cgroup_file) noexcept {
+    m_log_file    = std::move(log_file);
+    m_cgroup_file = std::move(cgroup_file);
+}
+
+auto BuildCommand::to_string() const noexcept -> std::string {
+    std::string result{};
+    for (auto&& [env_name, env_value] : m_env) {
+        result += fmt::format(FMT_COMPILE("export {}={}\n"), env_name, utils::shell_quote(env_value));
+    }
+    for (auto&& path_dir : m_path_dirs) {
+        result += fmt::format(FMT_COMPILE("export PATH={}:\"$PATH\"\n"), utils::shell_quote(path_dir));
+    }
+    for (auto&& pre_step : m_pre_steps) {
+        result += pre_step;
+        result += '\n';
+    }
+
+    std::string build_cmd{};
+    if (!m_launcher.empty()) {
+        build_cmd += m_launcher;
+        build_cmd += ' ';
+    }
+    if (!m_cgroup_file.empty()) {
+        build_cmd += fmt::format(FMT_COMPILE("bash -c 'cut -d: -f3 /proc/self/cgroup > \"$0\"; exec \"$@\"' {} "), utils::shell_quote(m_cgroup_file));
+    }
+    build_cmd += m_makepkg_cmd;
+
+    if (m_log_file.empty()) {
+        result += build_cmd;
+        result += "\nbuild_status=$?\n";
+    } else {
+        // NOTE: script keeps the terminal for makepkg, e.g. for menuconfig, and copies the output into the log.
+        const auto& quoted_log_file = utils::shell_quote(m_log_file);
+        result += fmt::format(FMT_COMPILE("SHELL=/bin/bash script -qefc {} {}\nbuild_status=$?\n"), utils::shell_quote(build_cmd), quoted_log_file);
+        result += fmt::format(FMT_COMPILE("echo \"km-build-status=$build_status\" >> {}\n"), quoted_log_file);
+    }
+
+    for (auto&& post_step : m_post_steps) {
+        result += post_step;
+        result += '\n';
+    }
+    result += "[ \"$build_status\" -eq 0 ] && touch .done-status";
+    return result;
+}
+
+auto setup_compiler_cache(BuildCommand& build_cmd, CompilerCache compiler_cache, std::int32_t size_limit_gib) noexcept -> bool {
+    const auto& cache_size = fmt::format(FMT_COMPILE("{}G"), size_limit_gib);
+
+    switch (compiler_cache) {
+    case CompilerCache::None:
+        return true;
+    case CompilerCache::Ccache:
+        if (!fs::exists("/usr/bin/ccache") || !fs::exists("/usr/lib/ccache/bin")) {
+            fmt::print(stderr, "ccache is not installed\n");
+            return false;
+        }
+        build_cmd.set_env("CCACHE_DIR", utils::fix_path("~/.cache/cachyos-km/ccache"));
+        build_cmd.set_env("CCACHE_MAXSIZE", cache_size);
+        build_cmd.prepend_path("/usr/lib/ccache/bin");
+
+        // NOTE: paths are made relative to the build directory, so rebuilds hit the cache
+        // even if the sources were extracted into the different location.
+        build_cmd.add_pre_step("export CCACHE_BASEDIR=\"${BUILDDIR:-$PWD}\"");
+        build_cmd.add_pre_step("ccache --zero-stats >/dev/null");
+        build_cmd.add_post_step("ccache --show-stats");
+        return true;
+    case CompilerCache::Sccache: {
+        if (!fs::exists("/usr/bin/sccache")) {
+            fmt::print(stderr, "sccache is not installed\n");
+            return false;
+        }
+        const fs::path wrappers_dir{utils::fix_path("~/.cache/cachyos-km/sccache-bin")};
+        if (!prepare_sccache_wrappers(wrappers_dir)) {
+            return false;
+        }
+        build_cmd.set_env("SCCACHE_DIR", utils::fix_path("~/.cache/cachyos-km/sccache"));
+        build_cmd.set_env("SCCACHE_CACHE_SIZE", cache_size);
+        build_cmd.prepend_path(wrappers_dir.string());
+
+        // restart the server, it keeps the cache directory and size of the previous run
+        build_cmd.add_pre_step("sccache --stop-server >/dev/null 2>&1");
+        build_cmd.add_pre_step("sccache --zero-stats >/dev/null");
+        build_cmd.add_post_step("sccache --show-stats");
+        return true;
+    }
+    }
+    return false;
+}
+
+auto get_expected_tree_size(bool with_debug_info) noexcept -> std::uint64_t {
+    // NOTE: approximation of sources, objects and the packaging directory,
+    // debug information inflates the objects several times.
+    return with_debug_info ? 24 * gib : 8 * gib;
+}
+
+auto setup_build_location(BuildCommand& build_cmd, std::uint64_t expected_tree_size) noexcept -> BuildLocation {
+    // packages must end up on disk, so they survive the removal of the tmpfs directory
+    build_cmd.add_pre_step("export PKGDEST=\"$PWD\"");
+
+    const auto available_memory = get_meminfo_value("MemAvailable");
+    const auto tmpfs_free_space = get_tmpfs_free_space("/tmp");
+    if (!tmpfs_free_space || *tmpfs_free_space < expected_tree_size || available_memory < expected_tree_size + memory_reserve) {
+        const auto& report = fmt::format(FMT_COMPILE("==> Building on disk: {:.1f} GiB needed, {:.1f} GiB of RAM and {:.1f} GiB of tmpfs available"),
+            to_gib(expected_tree_size), to_gib(available_memory), to_gib(tmpfs_free_space.value_or(0)));
+        build_cmd.add_pre_step(fmt::format(FMT_COMPILE("echo {}"), utils::shell_quote(report)));
+        return BuildLocation::Disk;
+    }
+
+    // NOTE: the directory is private to the build (mktemp creates it with 0700), as the other users
+    // could prepare the predictable one in /tmp, and change the tree, which is installed afterwards.
+    // The build goes on on disk, if the directory can't be created, the terminal must stay open until the end.
+    build_cmd.add_pre_step(
+        "if km_build_dir=\"$(mktemp -d /tmp/cachyos-km-build.XXXXXX)\"; then export BUILDDIR=\"$km_build_dir\"; echo \"==> Building in tmpfs: $km_build_dir\"; "
+        "else km_build_dir=''; echo '==> Failed to create the tmpfs directory, falling back to disk'; fi");
+    build_cmd.add_post_step("[ -z \"$km_build_dir\" ] || rm -rf -- \"$km_build_dir\"");
+    return BuildLocation::Tmpfs;
+}
+
+void setup_package_compression(BuildCommand& build_cmd, PackageCompression compression) noexcept {
+    switch (compression) {
+    case PackageCompression::Default:
+        return;
+    case PackageCompression::Fast: {
+        // makepkg.conf can't be overridden from the environment, except of PKGEXT, so it's wrapped instead
+        const auto& conf_path = utils::fix_path("~/.cache/cachyos-km/makepkg-fast.conf");
+        std::error_code err_code{};
+        fs::create_directories(fs::path{conf_path}.parent_path(), err_code);
+        if (err_code || !utils::write_to_file(conf_path, fast_makepkg_conf)) {
+            fmt::print(stderr, "Failed to write {}, using the default compression\n", conf_path);
+            return;
+        }
+        build_cmd.set_env("MAKEPKG_CONF", conf_path);
+        build_cmd.set_env("PKGEXT", ".pkg.tar.zst");
+        return;
+    }
+    case PackageCompression::None:
+        build_cmd.set_env("PKGEXT", ".pkg.tar");
+        return;
+    }
+}
+
+auto setup_resource_limits(BuildCommand& build_cmd, std::string_view lto_mode, std::uint64_t reserved_memory) noexcept -> std::uint32_t {
+    const auto total_memory     = get_meminfo_value("MemTotal");
+    const auto available_memory = get_meminfo_value("MemAvailable");
+    const auto cores_count      = std::max(std::thread::hardware_concurrency(), 1U);
+
+    // jobs are limited by the cores, and by the memory left after the reserve
+    const auto usable_memory = available_memory - std::min(available_memory, reserved_memory + memory_reserve);
+    const auto memory_jobs   = usable_memory / get_memory_per_job(lto_mode);
+    const auto jobs_count    = static_cast<std::uint32_t>(std::clamp<std::uint64_t>(memory_jobs, 1, cores_count));
+
+    // NOTE: PKGBUILD may pass -j"$(nproc)" to make explicitly, nproc honors OMP_NUM_THREADS.
+    build_cmd.set_env("MAKEFLAGS", fmt::format(FMT_COMPILE("-j{}"), jobs_count));
+    build_cmd.set_env("OMP_NUM_THREADS", fmt::format(FMT_COMPILE("{}"), jobs_count));
+
+    auto report = fmt::format(FMT_COMPILE("==> Using {} make jobs ({} cores, {:.1f} GiB of RAM available, LTO: {})"),
+        jobs_count, cores_count, to_gib(available_memory), lto_mode);
+
+    // the build is throttled above memory.high instead of OOM-killing the session,
+    // and gets less CPU/IO than the desktop, when they compete
+    if (has_systemd_user_manager() && total_memory > memory_reserve) {
+        const auto memory_high = total_memory - memory_reserve;
+        build_cmd.set_launcher(fmt::format(FMT_COMPILE("systemd-run --user --scope --quiet --collect -p CPUWeight=20 -p IOWeight=20 -p MemoryHigh={} --"), memory_high));
+        report += fmt::format(FMT_COMPILE(", memory.high: {:.1f} GiB"), to_gib(memory_high));
+    } else {
+        build_cmd.set_launcher("nice -n 10");
+    }
+
+    build_cmd.add_pre_step(fmt::format(FMT_COMPILE("echo {}"), utils::shell_quote(report)));
+    return jobs_count;
+}
+
+}  // namespace build
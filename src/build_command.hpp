@@ -0,0 +1,110 @@
+// Copyright (C) 2022-2024 Vladislav Nepogodin
+//
+// This file is part of CachyOS kernel manager.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#ifndef BUILD_COMMAND_HPP
+#define BUILD_COMMAND_HPP
+
+#include <cstdint>      // for int32_t, uint8_t, uint32_t, uint64_t
+#include <string>       // for string
+#include <string_view>  // for string_view
+#include <utility>      // for move, pair
+#include <vector>       // for vector
+
+namespace build {
+
+enum class CompilerCache : std::uint8_t {
+    None,
+    Ccache,
+    Sccache,
+};
+
+enum class BuildLocation : std::uint8_t {
+    Disk,
+    Tmpfs,
+};
+
+enum class PackageCompression : std::uint8_t {
+    /// As configured in makepkg.conf, e.g. for the packages, which are published.
+    Default,
+    /// Multithreaded zstd at the low level, for the packages, which are installed right away.
+    Fast,
+    None,
+};
+
+/// @brief Shell script, which runs makepkg in the build directory.
+///
+/// The environment is exported only for the build itself,
+/// so nothing leaks into the environment of the manager.
+/// Steps after the build run regardless of its result,
+/// .done-status is created only if makepkg succeeded.
+class BuildCommand {
+ public:
+    explicit BuildCommand(std::string makepkg_cmd) noexcept
+      : m_makepkg_cmd(std::move(makepkg_cmd)) { }
+
+    /// @brief Runs makepkg through the launcher, e.g. systemd-run.
+    void set_launcher(std::string launcher) noexcept;
+    void set_env(std::string_view name, std::string_view value) noexcept;
+    void prepend_path(std::string_view dir) noexcept;
+    void add_pre_step(std::string cmd) noexcept;
+    void add_post_step(std::string cmd) noexcept;
+    /// @brief Copies the output of makepkg into log_file, followed by 'km-build-status=<code>',
+    /// and writes the cgroup of the build into cgroup_file.
+    void set_log_file(std::string log_file, std::string cgroup_file) noexcept;
+
+    [[nodiscard]] auto to_string() const noexcept -> std::string;
+
+ private:
+    std::string m_makepkg_cmd{};
+    std::string m_launcher{};
+    std::string m_log_file{};
+    std::string m_cgroup_file{};
+    std::vector<std::pair<std::string, std::string>> m_env{};
+    std::vector<std::string> m_path_dirs{};
+    std::vector<std::string> m_pre_steps{};
+    std::vector<std::string> m_post_steps{};
+};
+
+/// @brief Routes the compiler through ccache/sccache with the persistent cache
+/// at ~/.cache/cachyos-km/<ccache|sccache>, limited to size_limit_gib.
+/// Statistics are reset before the build and shown after it.
+/// @return false, if the requested cache isn't installed.
+auto setup_compiler_cache(BuildCommand& build_cmd, CompilerCache compiler_cache, std::int32_t size_limit_gib) noexcept -> bool;
+
+/// @brief Rough size of the kernel build tree, including sources and objects.
+auto get_expected_tree_size(bool with_debug_info) noexcept -> std::uint64_t;
+
+/// @brief Places makepkg's BUILDDIR on tmpfs, if the build tree fits into it and into available RAM,
+/// otherwise the build stays on disk. Packages are always written to the build working directory,
+/// and the private tmpfs directory of the build is removed after it. If it can't be created, the build falls back to disk.
+auto setup_build_location(BuildCommand& build_cmd, std::uint64_t expected_tree_size) noexcept -> BuildLocation;
+
+/// @brief Overrides PKGEXT and the compressor of makepkg.conf, unless the compression is Default.
+/// NOTE: makepkg.conf is still sourced, the override is applied on top of it.
+void setup_package_compression(BuildCommand& build_cmd, PackageCompression compression) noexcept;
+
+/// @brief Sets the make job count from the cores, available memory and LTO mode,
+/// and runs the build in its own systemd user scope with lower CPU/IO weight and memory.high,
+/// so the desktop stays responsive and the OOM killer isn't triggered.
+/// @param reserved_memory Memory already taken by the build, e.g. the tree on tmpfs.
+/// @return The make job count.
+auto setup_resource_limits(BuildCommand& build_cmd, std::string_view lto_mode, std::uint64_t reserved_memory) noexcept -> std::uint32_t;
+
+}  // namespace build
+
+#endif  // BUILD_COMMAND_HPP
@@ -0,0 +1,494 @@
+// Copyright (C) 2022-2024 Vladislav Nepogodin
+//
+// This file is part of CachyOS kernel manager.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include "build_job.hpp"
+#include "artifact_cache.hpp"
+#include "build_command.hpp"
+#include "build_state.hpp"
+#include "build_telemetry.hpp"
+#include "compile_options.hpp"
+#include "module_profile.hpp"
+#include "pkgbuild_cache.hpp"
+#include "pkgbuild_eval.hpp"
+#include "utils.hpp"
+
+#include <algorithm>   // for copy_if
+#include <array>       // for array
+#include <cstdlib>     // for system
+#include <filesystem>  // for current_path
+#include <iterator>    // for back_inserter
+#include <optional>    // for optional
+#include <ranges>      // for ranges::*
+#include <tuple>       // for tie
+
+#include <fmt/compile.h>
+#include <fmt/core.h>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+constexpr auto convert_to_varname(std::string_view option) noexcept {
+    // force constexpr call with lambda
+    return [option] { return detail::option_map.at(option); }();
+}
+
+inline auto convert_to_var_assign(std::string_view option, std::string_view value) noexcept {
+    return fmt::format(FMT_COMPILE("{}={}\n"), convert_to_varname(option), value);
+}
+
+/// return flag to enable if the option is enabled, otherwise do nothing
+constexpr auto convert_to_var_assign_empty_wrapped(std::string_view option_name, bool option_enabled) noexcept {
+    using namespace std::string_view_literals;
+    if (option_enabled) {
+        return convert_to_var_assign(option_name, "y"sv);
+    }
+    return std::string{};
+}
+
+constexpr auto get_compiler_cache(std::string_view compiler_cache) noexcept -> build::CompilerCache {
+    using namespace std::string_view_literals;
+    if (compiler_cache == "ccache"sv) {
+        return build::CompilerCache::Ccache;
+    } else if (compiler_cache == "sccache"sv) {
+        return build::CompilerCache::Sccache;
+    }
+    return build::CompilerCache::None;
+}
+
+auto get_source_array_from_pkgbuild(std::string_view kernel_name_path, std::string_view options_set) noexcept -> std::vector<std::string> {
+    using namespace std::string_view_literals;
+    static constexpr std::array variables{"source"sv};
+
+    const auto& working_dir   = fs::current_path().string();
+    const auto& pkgbuild_path = fmt::format(FMT_COMPILE("{}/PKGBUILD"), kernel_name_path);
+
+    auto eval_result = pkgbuild::EvalServer::instance().evaluate({
+        .file_path   = pkgbuild_path,
+        .working_dir = working_dir,
+        .prelude     = options_set,
+        .variables   = variables,
+    });
+    if (!eval_result) {
+        return {};
+    }
+    return utils::make_multiline(eval_result->values[0], ' ');
+}
+
+auto get_pkgext_value_from_makepkgconf() noexcept -> std::string {
+    using namespace std::string_view_literals;
+    using namespace std::string_literals;
+    static constexpr std::array variables{"PKGEXT"sv};
+
+    auto eval_result = pkgbuild::EvalServer::instance().evaluate({
+        .file_path   = "/etc/makepkg.conf"sv,
+        .working_dir = "/"sv,
+        .variables   = variables,
+    });
+    if (!eval_result || eval_result->values[0].empty()) {
+        fmt::print(stderr, "failed to get PKGEXT from /etc/makepkg.conf");
+        return ".pkg.tar.zst"s;
+    }
+    return std::move(eval_result->values[0]);
+}
+
+auto get_package_ext(build::PackageCompression compression) noexcept -> std::string {
+    using namespace std::string_literals;
+    switch (compression) {
+    case build::PackageCompression::Fast:
+        return ".pkg.tar.zst"s;
+    case build::PackageCompression::None:
+        return ".pkg.tar"s;
+    case build::PackageCompression::Default:
+        break;
+    }
+    // fetch the pkgext from /etc/makepkg.conf, and fallback to '.pkg.tar.zst' which is default value of makepkg
+    return get_pkgext_value_from_makepkgconf();
+}
+
+auto prepare_func_names(std::vector<std::string> parse_lines, std::string_view pkgver_str, std::string_view pkgext_val) noexcept -> std::vector<std::string> {
+    using namespace std::string_view_literals;
+
+    static constexpr auto functor = [](auto&& rng) {
+        auto rng_str = std::string_view(&*rng.begin(), static_cast<size_t>(std::ranges::distance(rng)));
+        return rng_str.starts_with("package_"sv);
+    };
+
+    std::vector<std::string> pkg_globs{};
+    pkg_globs = parse_lines
+        | std::ranges::views::transform([&](auto&& rng) {
+              auto&& line = std::string_view(&*rng.begin(), static_cast<size_t>(std::ranges::distance(rng)));
+
+              static constexpr auto needle_prefix = "declare -f "sv;
+              if (line.starts_with(needle_prefix)) {
+                  line.remove_prefix(needle_prefix.size());
+              }
+              return line;
+          })
+        | std::ranges::views::filter(functor)
+        | std::ranges::views::transform([&](auto&& rng) {
+              auto&& line = std::string_view(&*rng.begin(), static_cast<size_t>(std::ranges::distance(rng)));
+
+              static constexpr auto needle_prefix = "package_"sv;
+              if (line.starts_with(needle_prefix)) {
+                  line.remove_prefix(needle_prefix.size());
+              }
+              return fmt::format(FMT_COMPILE("{}-{}-*{}"), line, pkgver_str, pkgext_val);
+          })
+        | std::ranges::to<std::vector<std::string>>();
+    return pkg_globs;
+}
+
+// NOTE: the configuration editors change the kernel configuration interactively,
+// so such builds can't be reproduced from their inputs.
+auto get_build_fingerprint(const build::BuildJob& job, std::string_view option_values, std::string_view srcdest) noexcept -> std::optional<std::string> {
+    const auto& options = job.options;
+    /* clang-format off */
+    if (options.nconfig_check || options.menuconfig_check || options.xconfig_check || options.gconfig_check) { return std::nullopt; }
+    /* clang-format on */
+
+    // blobs of the PKGBUILD directory, as checked out from the repository
+    const auto& variant_blobs = utils::exec(fmt::format(FMT_COMPILE("git ls-files -s -- {}"), utils::shell_quote(job.variant)));
+    /* clang-format off */
+    if (variant_blobs.empty()) { return std::nullopt; }
+    /* clang-format on */
+    // NOTE: the cache hit skips the build, so the different inputs must never give the same key,
+    // the fields are hashed with SHA-256 each prefixed with its length.
+    std::vector<std::string> fields{variant_blobs, std::string{option_values}, options.custom_name_edit};
+    fields.emplace_back(fmt::format(FMT_COMPILE("patches={}"), job.patches.size()));
+    const auto& startdir = fmt::format(FMT_COMPILE("{}/{}"), fs::current_path().string(), job.variant);
+    for (auto&& patch : job.patches) {
+        fields.emplace_back(utils::read_whole_file(build::get_fetched_patch_path(srcdest, startdir, patch)));
+    }
+    if (options.localmodcfg_check) {
+        fields.emplace_back(utils::read_whole_file(utils::fix_path("~/.config/modprobed.db")));
+    }
+
+    // NOTE: the packages aren't reproducible bit by bit anyway, only the toolchain versions matter.
+    fields.emplace_back(utils::exec("pacman -Q gcc clang llvm lld binutils rust 2>/dev/null"));
+    fields.emplace_back(get_package_ext(job.compression));
+    return utils::sha256_hex_fields(fields);
+}
+
+bool insert_new_source_array_into_pkgbuild(std::string_view kernel_name_path, const std::vector<std::string>& patches, const std::vector<std::string>& orig_source_array) noexcept {
+    static constexpr auto functor = [](auto&& rng) {
+        auto rng_str = std::string_view(&*rng.begin(), static_cast<size_t>(std::ranges::distance(rng)));
+        return !rng_str.ends_with(".patch");
+    };
+
+    auto array_entries = orig_source_array
+        | std::ranges::views::filter(functor)
+        | std::ranges::views::transform([](auto&& rng) { return fmt::format(FMT_COMPILE("\"{}\""), rng); })
+        | std::ranges::to<std::vector<std::string>>();
+
+    for (auto&& patch : patches) {
+        array_entries.emplace_back(fmt::format(FMT_COMPILE("\"{}\""), patch));
+    }
+    const auto& pkgbuild_path = fmt::format(FMT_COMPILE("{}/PKGBUILD"), kernel_name_path);
+    auto pkgbuildsrc          = utils::read_whole_file(pkgbuild_path);
+
+    const auto& new_source_array = fmt::format(FMT_COMPILE("source=(\n{})\n"), array_entries | std::ranges::views::join_with('\n') | std::ranges::to<std::string>());
+    if (auto foundpos = pkgbuildsrc.find("prepare()"); foundpos != std::string::npos) {
+        if (auto last_newline_before = pkgbuildsrc.find_last_of('\n', foundpos); last_newline_before != std::string::npos) {
+            pkgbuildsrc.insert(last_newline_before, new_source_array);
+        }
+    }
+    return utils::write_to_file(pkgbuild_path, pkgbuildsrc);
+}
+
+bool set_custom_name_in_pkgbuild(std::string_view kernel_name_path, std::string_view custom_name) noexcept {
+    const auto& pkgbuild_path = fmt::format(FMT_COMPILE("{}/PKGBUILD"), kernel_name_path);
+    auto pkgbuildsrc          = utils::read_whole_file(pkgbuild_path);
+
+    const auto& custom_name_var = fmt::format(FMT_COMPILE("\n\npkgbase=\"{}\""), custom_name);
+    if (auto foundpos = pkgbuildsrc.find("_major="); foundpos != std::string::npos) {
+        if (auto last_newline_before = pkgbuildsrc.find_last_of('\n', foundpos); last_newline_before != std::string::npos) {
+            pkgbuildsrc.insert(last_newline_before, custom_name_var);
+        }
+    }
+    return utils::write_to_file(pkgbuild_path, pkgbuildsrc);
+}
+
+// NOTE: makepkg doesn't extract the kernel tarball, prepare() copies the pristine tree instead.
+bool use_pristine_tree_in_pkgbuild(std::string_view kernel_name_path, std::string_view tarball_name, std::string_view pristine_dir) noexcept {
+    const auto& pkgbuild_path = fmt::format(FMT_COMPILE("{}/PKGBUILD"), kernel_name_path);
+    auto pkgbuildsrc          = utils::read_whole_file(pkgbuild_path);
+
+    auto foundpos = pkgbuildsrc.find("prepare()");
+    /* clang-format off */
+    if (foundpos == std::string::npos) { return false; }
+    /* clang-format on */
+    if (auto body_pos = pkgbuildsrc.find("{\n", foundpos); body_pos != std::string::npos) {
+        pkgbuildsrc.insert(body_pos + 2, build::SourceStore::make_pristine_restore_cmd(pristine_dir, tarball_name));
+    }
+    if (auto last_newline_before = pkgbuildsrc.find_last_of('\n', foundpos); last_newline_before != std::string::npos) {
+        pkgbuildsrc.insert(last_newline_before, fmt::format(FMT_COMPILE("\nnoextract+=({})\n"), utils::shell_quote(tarball_name)));
+    }
+    return utils::write_to_file(pkgbuild_path, pkgbuildsrc);
+}
+
+}  // namespace
+
+namespace build {
+
+auto get_option_values(const ConfigOptions& options) noexcept -> std::string {
+    std::string result{};
+
+    // checkboxes values,
+    // which becomes enabled with any value passed,
+    // and if nothing passed means it's disabled.
+    result += convert_to_var_assign_empty_wrapped("hardly", options.hardly_check);
+    result += convert_to_var_assign_empty_wrapped("per_gov", options.per_gov_check);
+    result += convert_to_var_assign_empty_wrapped("tcp_bbr3", options.tcp_bbr3_check);
+    result += convert_to_var_assign_empty_wrapped("auto_optim", options.auto_optim_check);
+
+    result += convert_to_var_assign_empty_wrapped("cachy_config", options.cachy_config_check);
+    result += convert_to_var_assign_empty_wrapped("nconfig", options.nconfig_check);
+    result += convert_to_var_assign_empty_wrapped("menuconfig", options.menuconfig_check);
+    result += convert_to_var_assign_empty_wrapped("xconfig", options.xconfig_check);
+    result += convert_to_var_assign_empty_wrapped("gconfig", options.gconfig_check);
+    result += convert_to_var_assign_empty_wrapped("localmodcfg", options.localmodcfg_check);
+    result += convert_to_var_assign_empty_wrapped("numa", options.numa_check);
+    result += convert_to_var_assign_empty_wrapped("damon", options.damon_check);
+    result += convert_to_var_assign_empty_wrapped("builtin_zfs", options.builtin_zfs_check);
+    result += convert_to_var_assign_empty_wrapped("builtin_nvidia", options.builtin_nvidia_check);
+    result += convert_to_var_assign_empty_wrapped("builtin_nvidia_open", options.builtin_nvidia_open_check);
+    result += convert_to_var_assign_empty_wrapped("build_debug", options.build_debug_check);
+
+    // combobox values
+    result += convert_to_var_assign("HZ_ticks", options.hz_ticks_combo);
+    result += convert_to_var_assign("tickrate", options.tickrate_combo);
+    result += convert_to_var_assign("preempt", options.preempt_combo);
+    result += convert_to_var_assign("hugepage", options.hugepage_combo);
+    result += convert_to_var_assign("lto", options.lto_combo);
+
+    if (!options.cpu_opt_combo.empty() && options.cpu_opt_combo != "manual") {
+        result += convert_to_var_assign("cpu_opt", options.cpu_opt_combo);
+    }
+
+    // NOTE: workaround PKGBUILD incorrectly working with custom pkgname
+    if (options.lto_combo != "none" && options.custom_name_edit != "$pkgbase") {
+        result += "_use_lto_suffix=n\n";
+    }
+
+    return result;
+}
+
+auto get_source_array_cached(std::string_view variant, std::string_view option_values) noexcept -> std::vector<std::string> {
+    const auto& pkgbuild_src = utils::read_whole_file(fmt::format(FMT_COMPILE("{}/PKGBUILD"), variant));
+    const auto cache_key     = pkgbuild::EvalCache::make_key(pkgbuild_src, variant, option_values);
+    return pkgbuild::EvalCache::instance().get_or_eval(cache_key, [&] { return get_source_array_from_pkgbuild(variant, option_values); });
+}
+
+auto get_source_entries(std::string_view variant, std::string_view option_values) noexcept -> std::vector<SourceEntry> {
+    using namespace std::string_view_literals;
+    static constexpr std::array variables{"source"sv, "b2sums"sv, "sha512sums"sv, "sha256sums"sv};
+    static constexpr std::array checksum_algos{"b2"sv, "sha512"sv, "sha256"sv};
+
+    const auto& working_dir   = fs::current_path().string();
+    const auto& pkgbuild_path = fmt::format(FMT_COMPILE("{}/PKGBUILD"), variant);
+
+    auto eval_result = pkgbuild::EvalServer::instance().evaluate({
+        .file_path   = pkgbuild_path,
+        .working_dir = working_dir,
+        .prelude     = option_values,
+        .variables   = variables,
+    });
+    if (!eval_result) {
+        return {};
+    }
+
+    const auto& sources = utils::make_multiline(eval_result->values[0], ' ');
+    std::vector<SourceEntry> entries{};
+    for (auto&& source : sources) {
+        entries.emplace_back(SourceEntry{.source = source});
+    }
+    for (std::size_t i = 0; i < checksum_algos.size(); ++i) {
+        const auto& checksums = utils::make_multiline(eval_result->values[i + 1], ' ');
+        /* clang-format off */
+        if (checksums.size() != entries.size()) { continue; }
+        /* clang-format on */
+
+        for (std::size_t j = 0; j < entries.size(); ++j) {
+            if (checksums[j] != "SKIP") {
+                entries[j].checksum_algo = checksum_algos[i];
+                entries[j].checksum      = checksums[j];
+            }
+        }
+        break;
+    }
+    return entries;
+}
+
+auto find_kernel_tarball(std::span<const SourceEntry> source_entries) noexcept -> const SourceEntry* {
+    for (auto&& entry : source_entries) {
+        const auto source_name = get_source_name(entry.source);
+        if (source_name.starts_with("linux-") && source_name.find(".tar") != std::string_view::npos) {
+            return &entry;
+        }
+    }
+    return nullptr;
+}
+
+auto get_package_globs(std::string_view variant, PackageCompression compression) noexcept -> std::vector<std::string> {
+    using namespace std::string_view_literals;
+    static constexpr std::array variables{"pkgver"sv, "pkgrel"sv};
+
+    const auto& working_dir   = fs::current_path().string();
+    const auto& pkgbuild_path = fmt::format(FMT_COMPILE("{}/PKGBUILD"), variant);
+
+    // version and package functions are fetched with the single query
+    auto eval_result = pkgbuild::EvalServer::instance().evaluate({
+        .file_path      = pkgbuild_path,
+        .working_dir    = working_dir,
+        .variables      = variables,
+        .list_functions = true,
+    });
+    if (!eval_result || eval_result->values[0].empty()) {
+        fmt::print(stderr, "broken pkgbuild; pkgver must be present\n");
+        return {};
+    }
+    const auto& pkgver_str = fmt::format(FMT_COMPILE("{}-{}"), eval_result->values[0], eval_result->values[1]);
+
+    return prepare_func_names(std::move(eval_result->functions), pkgver_str, get_package_ext(compression));
+}
+
+auto make_collect_packages_cmd(const BuildJob& job, std::string_view packages_dir) noexcept -> std::string {
+    const auto& quoted_packages_dir = utils::shell_quote(packages_dir);
+    const auto& package_globs       = get_package_globs(job.variant, job.compression) | std::ranges::views::join_with(' ') | std::ranges::to<std::string>();
+    return fmt::format(FMT_COMPILE("[ \"$build_status\" -eq 0 ] && mkdir -p -- {0} && mv -f -- {1} {0}/"), quoted_packages_dir, package_globs);
+}
+
+auto restore_pkgbuild(std::string_view variant) noexcept -> bool {
+    return std::system(fmt::format(FMT_COMPILE("git checkout --force -- {}"), utils::shell_quote(variant)).c_str()) == 0;
+}
+
+auto prepare_sources(const BuildJob& job, std::string_view option_values, std::stop_token stop_token) noexcept -> PreparedSources {
+    // Sources shared with the other variants are taken from the store, instead of downloading them.
+    auto& source_store  = SourceStore::instance();
+    const auto& srcdest = source_store.get_srcdest(job.variant);
+    PreparedSources prepared{.entries = get_source_entries(job.variant, option_values)};
+    prepared.reused_count = source_store.hand_out(srcdest, prepared.entries);
+    prepared.patch_issues = prefetch_patches(srcdest, fmt::format(FMT_COMPILE("{}/{}"), fs::current_path().string(), job.variant), job.patches, stop_token);
+
+    // _localmodcfg of PKGBUILD reads the module list, it is written from the collected modules
+    if (job.options.localmodcfg_check) {
+        const auto& profile_path = get_module_profile_path();
+        collect_loaded_modules(profile_path);
+        write_modprobed_db(load_module_profile(profile_path), utils::fix_path("~/.config/modprobed.db"));
+    }
+    if (prepared.patch_issues.empty()) {
+        prepared.fingerprint = get_build_fingerprint(job, option_values, srcdest);
+    }
+    return prepared;
+}
+
+auto plan_build(const BuildJob& job, std::string_view option_values, PreparedSources&& prepared) noexcept -> PlannedBuild {
+    const auto& variant = job.variant;
+
+    // Only files which end with .patch,
+    // are considered as patches.
+    const auto& orig_src_array = get_source_array_cached(variant, option_values);
+    const auto& orig_pkgbuild  = utils::read_whole_file(fmt::format(FMT_COMPILE("{}/PKGBUILD"), variant));
+    auto& source_entries       = prepared.entries;
+    if (!insert_new_source_array_into_pkgbuild(variant, job.patches, orig_src_array)) {
+        return {.error = "Failed to insert new source array into pkgbuild"};
+    }
+    if (!set_custom_name_in_pkgbuild(variant, job.options.custom_name_edit)) {
+        return {.error = "Failed to set custom name in pkgbuild"};
+    }
+    const auto* kernel_tarball = find_kernel_tarball(source_entries);
+    if (kernel_tarball != nullptr) {
+        const auto& pristine_dir = SourceStore::instance().use_pristine_dir(*kernel_tarball);
+        if (!use_pristine_tree_in_pkgbuild(variant, get_source_name(kernel_tarball->source), pristine_dir)) {
+            fmt::print(stderr, "Failed to use pristine tree in pkgbuild\n");
+        }
+    }
+    PlannedBuild planned{.working_path = fmt::format(FMT_COMPILE("{}/{}"), fs::current_path().string(), variant)};
+
+    // NOTE: the incremental build keeps the tree in its own BUILDDIR on disk, instead of cleaning it.
+    const bool is_incremental = job.options.incremental_build_check;
+    std::string makepkg_cmd{"makepkg -scf --cleanbuild --skipchecksums"};
+    std::string incremental_build_dir{};
+    if (is_incremental) {
+        TreeState wanted_state{
+            .base_key    = utils::fnv1a_append(utils::fnv1a_append(utils::fnv1a_offset_basis, orig_pkgbuild), job.options.custom_name_edit),
+            .options_key = utils::fnv1a_append(utils::fnv1a_offset_basis, option_values),
+        };
+        // patches, which prepare() of PKGBUILD applies
+        std::ranges::copy_if(job.patches, std::back_inserter(wanted_state.patches), [](auto&& patch) { return patch.ends_with(".patch"); });
+        auto incremental_build = plan_incremental_build(variant, wanted_state);
+        makepkg_cmd            = fmt::format(FMT_COMPILE("bash -c {}"), utils::shell_quote(incremental_build.script));
+        incremental_build_dir  = std::move(incremental_build.build_dir);
+    }
+
+    BuildCommand build_cmd{std::move(makepkg_cmd)};
+    if (is_incremental) {
+        build_cmd.set_env("BUILDDIR", incremental_build_dir);
+    }
+
+    // The options are exported only for the build, so they don't leak into the other builds.
+    for (auto&& option_value : utils::make_split_view(option_values, '\n')) {
+        const auto delim_pos = option_value.find('=');
+        /* clang-format off */
+        if (delim_pos == std::string_view::npos) { continue; }
+        /* clang-format on */
+        build_cmd.set_env(option_value.substr(0, delim_pos), option_value.substr(delim_pos + 1));
+    }
+
+    // The stored sources and the prefetched patches are already in SRCDEST.
+    const auto& source_store = SourceStore::instance();
+    const auto& srcdest      = source_store.get_srcdest(variant);
+    for (auto&& patch : job.patches) {
+        source_entries.emplace_back(SourceEntry{.source = patch});
+    }
+    build_cmd.set_env("SRCDEST", srcdest);
+    build_cmd.add_pre_step(fmt::format(FMT_COMPILE("echo '==> Reusing {} stored sources'"), prepared.reused_count));
+    build_cmd.add_post_step(source_store.make_ingest_cmd(srcdest, source_entries));
+
+    // NOTE: BUILDDIR on tmpfs is created by the script, before the compiler cache takes it as the base directory.
+    const auto expected_tree_size = get_expected_tree_size(job.options.build_debug_check);
+    auto build_location           = BuildLocation::Disk;
+    if (!is_incremental && job.options.tmpfs_build_check) {
+        build_location = setup_build_location(build_cmd, expected_tree_size);
+    }
+
+    if (!setup_compiler_cache(build_cmd, get_compiler_cache(job.options.compiler_cache_combo), job.options.compiler_cache_size)) {
+        return {.error = fmt::format(FMT_COMPILE("Failed to setup compiler cache!\nPlease check that {} is installed"), job.options.compiler_cache_combo)};
+    }
+
+    setup_package_compression(build_cmd, job.compression);
+
+    // NOTE: the tree on tmpfs takes the memory, which otherwise would be used by make jobs.
+    setup_resource_limits(build_cmd, job.options.lto_combo, (build_location == BuildLocation::Tmpfs) ? expected_tree_size : 0);
+
+    // Packages of the succeeded build are cached, so the same build isn't repeated.
+    if (prepared.fingerprint) {
+        const auto& package_globs = get_package_globs(variant, job.compression) | std::ranges::views::join_with(' ') | std::ranges::to<std::string>();
+        build_cmd.add_post_step(ArtifactCache::instance().make_store_cmd(*prepared.fingerprint, package_globs));
+    }
+
+    // Phases of the build are measured from its log, and stored into the history.
+    std::tie(planned.log_file, planned.cgroup_file) = BuildTracker::make_log_paths(variant);
+    build_cmd.set_log_file(planned.log_file, planned.cgroup_file);
+
+    planned.command = build_cmd.to_string();
+    return planned;
+}
+
+}  // namespace build
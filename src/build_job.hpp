@@ -0,0 +1,102 @@
+// Copyright (C) 2022-2024 Vladislav Nepogodin
+//
+// This file is part of CachyOS kernel manager.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#ifndef BUILD_JOB_HPP
+#define BUILD_JOB_HPP
+
+#include "build_command.hpp"
+#include "config-options.hpp"
+#include "patch_prefetch.hpp"
+#include "source_store.hpp"
+
+#include <cstddef>      // for size_t
+#include <cstdint>      // for uint64_t
+#include <optional>     // for optional
+#include <span>         // for span
+#include <stop_token>   // for stop_token
+#include <string>       // for string
+#include <string_view>  // for string_view
+#include <vector>       // for vector
+
+namespace build {
+
+/// @brief Build of the kernel variant, described independently of the configure window.
+struct BuildJob {
+    /// Directory of PKGBUILD in the repository, e.g. "linux-cachyos-bore".
+    std::string variant{};
+    ConfigOptions options{};
+    /// Entries of the source array after the kernel sources, e.g. patches, in the order of application.
+    std::vector<std::string> patches{};
+    PackageCompression compression{};
+};
+
+/// @brief Sources of the build, prepared in the background.
+struct PreparedSources {
+    std::vector<SourceEntry> entries{};
+    /// Count of the sources, which were handed out from the store.
+    std::size_t reused_count{};
+    std::vector<PatchIssue> patch_issues{};
+    /// Fingerprint of the build inputs, nullopt if the build can't be cached.
+    std::optional<std::string> fingerprint{};
+};
+
+/// @brief Build, which is ready to run in the terminal.
+struct PlannedBuild {
+    /// Why the build can't run, empty on success.
+    std::string error{};
+    std::string command{};
+    /// PKGBUILD directory, the build runs there.
+    std::string working_path{};
+    std::string log_file{};
+    std::string cgroup_file{};
+};
+
+/// @brief Variables, which configure PKGBUILD, one 'name=value' per line.
+auto get_option_values(const ConfigOptions& options) noexcept -> std::string;
+
+/// @brief Source array of PKGBUILD, bash is only invoked for new combinations
+/// of PKGBUILD content, variant and options.
+auto get_source_array_cached(std::string_view variant, std::string_view option_values) noexcept -> std::vector<std::string>;
+
+/// @brief Sources with the checksums declared by PKGBUILD, the strongest available algorithm is used.
+auto get_source_entries(std::string_view variant, std::string_view option_values) noexcept -> std::vector<SourceEntry>;
+
+/// @brief Kernel tarball among the sources, nullptr if there is none.
+auto find_kernel_tarball(std::span<const SourceEntry> source_entries) noexcept -> const SourceEntry*;
+
+/// @brief Globs of the packages, which PKGBUILD builds, e.g. 'linux-cachyos-6.9.1-1-*.pkg.tar.zst'.
+auto get_package_globs(std::string_view variant, PackageCompression compression) noexcept -> std::vector<std::string>;
+
+/// @brief Shell step after the build, which moves the packages into packages_dir if the build succeeded,
+/// so the next builds of the variant don't overwrite them.
+auto make_collect_packages_cmd(const BuildJob& job, std::string_view packages_dir) noexcept -> std::string;
+
+/// @brief Checks PKGBUILD of the variant out of the repository again, dropping the changes of the previous build.
+auto restore_pkgbuild(std::string_view variant) noexcept -> bool;
+
+/// @brief Hands out the stored sources into SRCDEST of the variant, and prefetches the patches.
+/// NOTE: SRCDEST is shared by the builds of the variant, so it must not be building meanwhile.
+auto prepare_sources(const BuildJob& job, std::string_view option_values, std::stop_token stop_token) noexcept -> PreparedSources;
+
+/// @brief Writes the job into PKGBUILD of the variant, and composes the build command.
+/// PKGBUILD is expected to be as checked out from the repository.
+auto plan_build(const BuildJob& job, std::string_view option_values, PreparedSources&& prepared) noexcept -> PlannedBuild;
+
+}  // namespace build
+
+#endif  // BUILD_JOB_HPP
@@ -0,0 +1,284 @@
+// Copyright (C) 2022-2024 Vladislav Nepogodin
+//
+// This file is part of CachyOS kernel manager.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include "build_monitor.hpp"
+#include "utils.hpp"
+
+#include <charconv>       // for from_chars
+#include <filesystem>     // for directory_iterator
+#include <fstream>        // for ifstream
+#include <unordered_map>  // for unordered_map
+#include <utility>        // for move
+#include <vector>         // for vector
+
+#include <unistd.h>  // for sysconf
+
+#include <fmt/compile.h>
+#include <fmt/core.h>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// NOTE: thresholds are rough, the build is considered stalled on the resource
+// above them, and CPU-bound if almost every core is used.
+constexpr double memory_pressure_threshold = 10.0;
+constexpr double io_pressure_threshold     = 20.0;
+constexpr double cpu_usage_threshold       = 0.9;
+
+template <typename T>
+auto parse_number(std::string_view value) noexcept -> std::optional<T> {
+    T result{};
+    const auto [ptr, err_code] = std::from_chars(value.data(), value.data() + value.size(), result);
+    if (err_code != std::errc{} || ptr != value.data() + value.size()) {
+        return std::nullopt;
+    }
+    return result;
+}
+
+// PSI file looks like 'some avg10=1.23 avg60=0.50 avg300=0.10 total=12345'
+auto read_pressure(const std::string& pressure_path) noexcept -> double {
+    std::ifstream pressure_file{pressure_path};
+    std::string line{};
+    while (std::getline(pressure_file, line)) {
+        /* clang-format off */
+        if (!line.starts_with("some ")) { continue; }
+        /* clang-format on */
+        for (auto&& field : utils::make_split_view(line, ' ')) {
+            if (field.starts_with("avg10=")) {
+                return parse_number<double>(field.substr(6)).value_or(0);
+            }
+        }
+    }
+    return 0;
+}
+
+// io.stat looks like '259:0 rbytes=123 wbytes=456 rios=1 wios=2 dbytes=0 dios=0', one line per device
+void read_io_stat(const std::string& io_stat_path, std::uint64_t& read_bytes, std::uint64_t& write_bytes) noexcept {
+    std::ifstream io_stat_file{io_stat_path};
+    std::string line{};
+    while (std::getline(io_stat_file, line)) {
+        for (auto&& field : utils::make_split_view(line, ' ')) {
+            if (field.starts_with("rbytes=")) {
+                read_bytes += parse_number<std::uint64_t>(field.substr(7)).value_or(0);
+            } else if (field.starts_with("wbytes=")) {
+                write_bytes += parse_number<std::uint64_t>(field.substr(7)).value_or(0);
+            }
+        }
+    }
+}
+
+struct ProcessStat {
+    std::uint64_t ppid{};
+    std::string comm{};
+    /// utime + stime + cutime + cstime, the children reaped in the tree are counted by their parent.
+    std::uint64_t cpu_ticks{};
+    std::uint64_t rss_pages{};
+};
+
+// /proc/<pid>/stat looks like '123 (comm) S 1 ...', comm may contain spaces and parentheses
+auto read_process_stat(const fs::path& proc_dir) noexcept -> std::optional<ProcessStat> {
+    std::ifstream stat_file{proc_dir / "stat"};
+    std::string content{};
+    /* clang-format off */
+    if (!std::getline(stat_file, content)) { return std::nullopt; }
+    /* clang-format on */
+
+    const auto comm_start = content.find('(');
+    const auto comm_end   = content.rfind(')');
+    if (comm_start == std::string::npos || comm_end == std::string::npos || comm_end < comm_start) {
+        return std::nullopt;
+    }
+    ProcessStat result{.comm = content.substr(comm_start + 1, comm_end - comm_start - 1)};
+
+    // fields after comm start from the state (3rd field)
+    const auto& fields = utils::make_multiline_view(std::string_view{content}.substr(comm_end + 1), ' ');
+    /* clang-format off */
+    if (fields.size() < 22) { return std::nullopt; }
+    /* clang-format on */
+    result.ppid = parse_number<std::uint64_t>(fields[1]).value_or(0);
+    for (std::size_t field = 11; field <= 14; ++field) {
+        result.cpu_ticks += parse_number<std::uint64_t>(fields[field]).value_or(0);
+    }
+    result.rss_pages = parse_number<std::uint64_t>(fields[21]).value_or(0);
+    return result;
+}
+
+// /proc/<pid>/io has 'read_bytes: 123' and 'write_bytes: 456', which are the actual storage I/O
+void read_process_io(const fs::path& proc_dir, std::uint64_t& read_bytes, std::uint64_t& write_bytes) noexcept {
+    std::ifstream io_file{proc_dir / "io"};
+    std::string line{};
+    while (std::getline(io_file, line)) {
+        if (line.starts_with("read_bytes: ")) {
+            read_bytes += parse_number<std::uint64_t>(std::string_view{line}.substr(12)).value_or(0);
+        } else if (line.starts_with("write_bytes: ")) {
+            write_bytes += parse_number<std::uint64_t>(std::string_view{line}.substr(13)).value_or(0);
+        }
+    }
+}
+
+}  // namespace
+
+namespace build {
+
+auto get_bottleneck(const ResourceSample& sample, std::uint32_t cores_count) noexcept -> BuildBottleneck {
+    if (sample.memory_pressure >= memory_pressure_threshold) {
+        return BuildBottleneck::Memory;
+    } else if (sample.io_pressure >= io_pressure_threshold) {
+        return BuildBottleneck::Io;
+    } else if (sample.cpu_cores >= cpu_usage_threshold * cores_count) {
+        return BuildBottleneck::Cpu;
+    }
+    return BuildBottleneck::None;
+}
+
+// NOTE: sysfs files report the page size as their size, and are gone with the scope,
+// so they are read without the size and errors of utils::read_whole_file.
+auto read_cgroup_value(std::string_view cgroup_dir, std::string_view file_name, std::string_view key) noexcept -> std::optional<std::uint64_t> {
+    std::ifstream cgroup_file{fmt::format(FMT_COMPILE("{}/{}"), cgroup_dir, file_name)};
+    std::string line{};
+    while (std::getline(cgroup_file, line)) {
+        // keyed files look like 'usage_usec 123', the others hold only the value
+        std::string_view value{line};
+        if (!key.empty()) {
+            /* clang-format off */
+            if (!value.starts_with(key) || !value.substr(key.size()).starts_with(' ')) { continue; }
+            /* clang-format on */
+            value.remove_prefix(key.size() + 1);
+        }
+        return parse_number<std::uint64_t>(value);
+    }
+    return std::nullopt;
+}
+
+void ResourceSampler::set_cgroup_dir(std::string_view cgroup_dir) noexcept {
+    /* clang-format off */
+    if (cgroup_dir == m_cgroup_dir) { return; }
+    /* clang-format on */
+
+    // the counters of /proc and cgroup aren't comparable
+    m_cgroup_dir = cgroup_dir;
+    m_last_counters.reset();
+}
+
+void ResourceSampler::reset() noexcept {
+    m_cgroup_dir.clear();
+    m_last_counters.reset();
+    m_history.clear();
+}
+
+auto ResourceSampler::read(std::string cgroup_dir) noexcept -> Reading {
+    Reading reading{.read_at = std::chrono::steady_clock::now()};
+    reading.counters = read_counters(cgroup_dir);
+    if (reading.counters) {
+        const auto& pressure_prefix = cgroup_dir.empty() ? std::string{"/proc/pressure/"} : fmt::format(FMT_COMPILE("{}/"), cgroup_dir);
+        const auto& pressure_suffix = cgroup_dir.empty() ? std::string_view{} : std::string_view{".pressure"};
+        reading.cpu_pressure        = read_pressure(fmt::format(FMT_COMPILE("{}cpu{}"), pressure_prefix, pressure_suffix));
+        reading.memory_pressure     = read_pressure(fmt::format(FMT_COMPILE("{}memory{}"), pressure_prefix, pressure_suffix));
+        reading.io_pressure         = read_pressure(fmt::format(FMT_COMPILE("{}io{}"), pressure_prefix, pressure_suffix));
+    }
+    reading.cgroup_dir = std::move(cgroup_dir);
+    return reading;
+}
+
+void ResourceSampler::push(const Reading& reading) noexcept {
+    /* clang-format off */
+    if (reading.cgroup_dir != m_cgroup_dir) { return; }
+    /* clang-format on */
+    const auto& counters = reading.counters;
+    if (!counters) {
+        m_last_counters.reset();
+        return;
+    }
+
+    if (m_last_counters) {
+        const auto elapsed_secs = std::chrono::duration<double>(reading.read_at - m_last_sampled_at).count();
+        // counters of the process tree go down, when the processes exit
+        const auto get_rate = [elapsed_secs](std::uint64_t current, std::uint64_t last) {
+            return (current > last && elapsed_secs > 0) ? static_cast<double>(current - last) / elapsed_secs : 0.0;
+        };
+
+        m_history.push(ResourceSample{
+            .cpu_cores       = get_rate(counters->cpu_usec, m_last_counters->cpu_usec) / 1e6,
+            .memory_bytes    = counters->memory_bytes,
+            .io_read_bps     = get_rate(counters->read_bytes, m_last_counters->read_bytes),
+            .io_write_bps    = get_rate(counters->write_bytes, m_last_counters->write_bytes),
+            .cpu_pressure    = reading.cpu_pressure,
+            .memory_pressure = reading.memory_pressure,
+            .io_pressure     = reading.io_pressure,
+        });
+    }
+    m_last_counters   = counters;
+    m_last_sampled_at = reading.read_at;
+}
+
+auto ResourceSampler::read_counters(std::string_view cgroup_dir) noexcept -> std::optional<Counters> {
+    Counters counters{};
+    if (!cgroup_dir.empty()) {
+        const auto cpu_usec = read_cgroup_value(cgroup_dir, "cpu.stat", "usage_usec");
+        /* clang-format off */
+        if (!cpu_usec) { return std::nullopt; }
+        /* clang-format on */
+        counters.cpu_usec     = *cpu_usec;
+        counters.memory_bytes = read_cgroup_value(cgroup_dir, "memory.current").value_or(0);
+        read_io_stat(fmt::format(FMT_COMPILE("{}/io.stat"), cgroup_dir), counters.read_bytes, counters.write_bytes);
+        return counters;
+    }
+
+    // the tree of the makepkg processes, e.g. make and the compilers spawned by it
+    std::unordered_map<std::uint64_t, ProcessStat> processes{};
+    std::error_code err_code{};
+    for (auto&& dir_entry : fs::directory_iterator{"/proc", err_code}) {
+        const auto pid = parse_number<std::uint64_t>(dir_entry.path().filename().string());
+        /* clang-format off */
+        if (!pid) { continue; }
+        /* clang-format on */
+        if (auto process_stat = read_process_stat(dir_entry.path())) {
+            processes.emplace(*pid, std::move(*process_stat));
+        }
+    }
+
+    std::vector<std::uint64_t> tree_pids{};
+    for (auto&& [pid, process_stat] : processes) {
+        // NOTE: parents may be missing, if they have just exited.
+        for (auto ancestor = pid; processes.contains(ancestor); ancestor = processes[ancestor].ppid) {
+            if (processes[ancestor].comm == "makepkg") {
+                tree_pids.emplace_back(pid);
+                break;
+            }
+            /* clang-format off */
+            if (processes[ancestor].ppid == ancestor) { break; }
+            /* clang-format on */
+        }
+    }
+    /* clang-format off */
+    if (tree_pids.empty()) { return std::nullopt; }
+    /* clang-format on */
+
+    static const auto ticks_per_sec = static_cast<std::uint64_t>(::sysconf(_SC_CLK_TCK));
+    static const auto page_size     = static_cast<std::uint64_t>(::sysconf(_SC_PAGESIZE));
+    for (auto&& pid : tree_pids) {
+        const auto& process_stat = processes[pid];
+        counters.cpu_usec += process_stat.cpu_ticks * 1'000'000 / ticks_per_sec;
+        counters.memory_bytes += process_stat.rss_pages * page_size;
+        read_process_io(fs::path{"/proc"} / std::to_string(pid), counters.read_bytes, counters.write_bytes);
+    }
+    return counters;
+}
+
+}  // namespace build
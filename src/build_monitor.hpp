@@ -0,0 +1,155 @@
+// Copyright (C) 2022-2024 Vladislav Nepogodin
+//
+// This file is part of CachyOS kernel manager.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#ifndef BUILD_MONITOR_HPP
+#define BUILD_MONITOR_HPP
+
+#include <array>        // for array
+#include <chrono>       // for steady_clock
+#include <cstddef>      // for size_t
+#include <cstdint>      // for uint8_t, uint64_t
+#include <optional>     // for optional
+#include <string>       // for string
+#include <string_view>  // for string_view
+
+namespace build {
+
+/// @brief Fixed-size ring buffer, the oldest element is overwritten, once it's full.
+template <typename T, std::size_t Capacity>
+class RingBuffer {
+ public:
+    void push(const T& value) noexcept {
+        m_data[(m_first + m_size) % Capacity] = value;
+        if (m_size < Capacity) {
+            ++m_size;
+        } else {
+            m_first = (m_first + 1) % Capacity;
+        }
+    }
+
+    void clear() noexcept {
+        m_first = 0;
+        m_size  = 0;
+    }
+
+    /* clang-format off */
+    constexpr auto size() const noexcept -> std::size_t
+    { return m_size; }
+
+    constexpr auto empty() const noexcept -> bool
+    { return m_size == 0; }
+
+    /// Index 0 is the oldest element.
+    constexpr auto operator[](std::size_t index) const noexcept -> const T&
+    { return m_data[(m_first + index) % Capacity]; }
+
+    constexpr auto back() const noexcept -> const T&
+    { return (*this)[m_size - 1]; }
+    /* clang-format on */
+
+ private:
+    std::array<T, Capacity> m_data{};
+    std::size_t m_first{};
+    std::size_t m_size{};
+};
+
+struct ResourceSample {
+    /// CPU time per second, 1.0 is one fully used core.
+    double cpu_cores{};
+    std::uint64_t memory_bytes{};
+    double io_read_bps{};
+    double io_write_bps{};
+    /// Share of the time, when some tasks were stalled on the resource (PSI 'some avg10'), in percents.
+    double cpu_pressure{};
+    double memory_pressure{};
+    double io_pressure{};
+};
+
+enum class BuildBottleneck : std::uint8_t {
+    None,
+    Cpu,
+    Io,
+    Memory,
+};
+
+/// @brief What limits the build at the moment of the sample.
+/// NOTE: the memory stalls are checked first, they also show up as I/O on swap and reclaim.
+auto get_bottleneck(const ResourceSample& sample, std::uint32_t cores_count) noexcept -> BuildBottleneck;
+
+/// @brief Reads the value of the cgroup file, either the whole file (e.g. memory.current),
+/// or the keyed line (e.g. 'usage_usec 123' of cpu.stat).
+auto read_cgroup_value(std::string_view cgroup_dir, std::string_view file_name, std::string_view key = {}) noexcept -> std::optional<std::uint64_t>;
+
+/// @brief Samples the resources of the running build: its cgroup, if the build runs in its own scope,
+/// otherwise the process tree of makepkg from /proc, with the system-wide pressure.
+class ResourceSampler {
+ public:
+    static constexpr std::size_t history_capacity = 300;
+
+    using history_t = RingBuffer<ResourceSample, history_capacity>;
+
+    struct Counters {
+        std::uint64_t cpu_usec{};
+        std::uint64_t read_bytes{};
+        std::uint64_t write_bytes{};
+        std::uint64_t memory_bytes{};
+    };
+
+    /// @brief Counters and pressure at the moment of the reading.
+    struct Reading {
+        /// Where it was read from, empty for /proc.
+        std::string cgroup_dir{};
+        /// nullopt if the build isn't running.
+        std::optional<Counters> counters{};
+        double cpu_pressure{};
+        double memory_pressure{};
+        double io_pressure{};
+        std::chrono::steady_clock::time_point read_at{};
+    };
+
+    /// @brief Reads the cgroup of the build, or walks /proc if cgroup_dir is empty.
+    /// NOTE: walking /proc is slow, it is meant to run off the GUI thread, it doesn't touch the sampler.
+    static auto read(std::string cgroup_dir) noexcept -> Reading;
+
+    /// @brief Switches to the cgroup of the build, empty to sample /proc.
+    void set_cgroup_dir(std::string_view cgroup_dir) noexcept;
+
+    /// @brief Adds the reading to the history, the rates are computed since the previous one,
+    /// so the first reading only sets the baseline. The reading of the other cgroup is dropped.
+    void push(const Reading& reading) noexcept;
+    void reset() noexcept;
+
+    /* clang-format off */
+    auto get_cgroup_dir() const noexcept -> const std::string&
+    { return m_cgroup_dir; }
+    auto get_history() const noexcept -> const history_t&
+    { return m_history; }
+    /* clang-format on */
+
+ private:
+    static auto read_counters(std::string_view cgroup_dir) noexcept -> std::optional<Counters>;
+
+    std::string m_cgroup_dir{};
+    std::optional<Counters> m_last_counters{};
+    std::chrono::steady_clock::time_point m_last_sampled_at{};
+    history_t m_history{};
+};
+
+}  // namespace build
+
+#endif  // BUILD_MONITOR_HPP
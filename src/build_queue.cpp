@@ -0,0 +1,261 @@
+// Copyright (C) 2022-2024 Vladislav Nepogodin
+//
+// This file is part of CachyOS kernel manager.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include "build_queue.hpp"
+#include "utils.hpp"
+
+#include <algorithm>      // for sort, find_if, replace, max
+#include <array>          // for array
+#include <charconv>       // for from_chars
+#include <cstddef>        // for ptrdiff_t
+#include <filesystem>     // for create_directories, directory_iterator, remove_all
+#include <limits>         // for numeric_limits
+#include <system_error>   // for error_code
+#include <unordered_set>  // for unordered_set
+#include <utility>        // for move
+
+#include <fmt/compile.h>
+#include <fmt/core.h>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+constexpr std::string_view entry_file_name   = "entry";
+constexpr std::string_view options_file_name = "options.toml";
+
+constexpr std::array queue_state_names{"pending", "running", "done", "failed"};
+constexpr std::array compression_names{"default", "fast", "none"};
+
+auto parse_queue_state(std::string_view state_name) noexcept -> build::QueueState {
+    for (std::size_t i = 0; i < queue_state_names.size(); ++i) {
+        if (state_name == queue_state_names[i]) {
+            return static_cast<build::QueueState>(i);
+        }
+    }
+    return build::QueueState::Pending;
+}
+
+auto parse_compression(std::string_view compression_name) noexcept -> build::PackageCompression {
+    for (std::size_t i = 0; i < compression_names.size(); ++i) {
+        if (compression_name == compression_names[i]) {
+            return static_cast<build::PackageCompression>(i);
+        }
+    }
+    return build::PackageCompression::Default;
+}
+
+// options, which aren't the same in both jobs
+auto count_changed_options(std::string_view lhs_values, std::string_view rhs_values) noexcept -> std::uint32_t {
+    const auto& lhs_lines = utils::make_multiline_view(lhs_values, '\n');
+    const auto& rhs_lines = utils::make_multiline_view(rhs_values, '\n');
+    const std::unordered_set<std::string_view> lhs_set{lhs_lines.begin(), lhs_lines.end()};
+    const std::unordered_set<std::string_view> rhs_set{rhs_lines.begin(), rhs_lines.end()};
+
+    std::uint32_t result{};
+    for (auto&& line : lhs_set) {
+        result += rhs_set.contains(line) ? 0U : 1U;
+    }
+    for (auto&& line : rhs_set) {
+        result += lhs_set.contains(line) ? 0U : 1U;
+    }
+    return result;
+}
+
+}  // namespace
+
+namespace build {
+
+auto get_switch_cost(const BuildJob& previous, const BuildJob& next) noexcept -> std::uint32_t {
+    // NOTE: weights are rough, the flags invalidate the whole compiler cache,
+    // while the other options change only the part of the kernel configuration.
+    std::uint32_t cost{};
+    if (previous.options.lto_combo != next.options.lto_combo) {
+        cost += 4;
+    }
+    if (previous.options.cpu_opt_combo != next.options.cpu_opt_combo) {
+        cost += 4;
+    }
+    if (previous.options.compiler_cache_combo != next.options.compiler_cache_combo) {
+        cost += 4;
+    }
+    if (previous.variant != next.variant) {
+        cost += 2;
+    }
+    if (previous.patches != next.patches) {
+        cost += 1;
+    }
+    return cost + count_changed_options(get_option_values(previous.options), get_option_values(next.options));
+}
+
+auto plan_queue_order(std::span<const QueueEntry> entries, const BuildJob* last_job) noexcept -> std::vector<std::size_t> {
+    std::vector<std::size_t> pending_indices{};
+    for (std::size_t i = 0; i < entries.size(); ++i) {
+        if (entries[i].state == QueueState::Pending) {
+            pending_indices.emplace_back(i);
+        }
+    }
+
+    std::vector<std::size_t> result{};
+    const auto* previous_job = last_job;
+    while (!pending_indices.empty()) {
+        // greedy, the queue is short enough, to not bother about the optimal order
+        std::size_t best_pos{};
+        auto best_cost = std::numeric_limits<std::uint32_t>::max();
+        for (std::size_t pos = 0; previous_job != nullptr && pos < pending_indices.size(); ++pos) {
+            const auto cost = get_switch_cost(*previous_job, entries[pending_indices[pos]].job);
+            if (cost < best_cost) {
+                best_pos  = pos;
+                best_cost = cost;
+            }
+        }
+        result.emplace_back(pending_indices[best_pos]);
+        previous_job = &entries[pending_indices[best_pos]].job;
+        pending_indices.erase(pending_indices.begin() + static_cast<std::ptrdiff_t>(best_pos));
+    }
+    return result;
+}
+
+BuildQueue::BuildQueue(std::string queue_dir) noexcept
+  : m_queue_dir(std::move(queue_dir)) {
+    load();
+}
+
+auto BuildQueue::instance() noexcept -> BuildQueue& {
+    static BuildQueue queue{utils::fix_path("~/.cache/cachyos-km/queue")};
+    return queue;
+}
+
+auto BuildQueue::enqueue(BuildJob job) noexcept -> std::uint64_t {
+    auto& entry = m_entries.emplace_back(QueueEntry{.id = m_next_id++, .job = std::move(job)});
+    store(entry);
+    return entry.id;
+}
+
+void BuildQueue::remove(std::uint64_t id) noexcept {
+    std::error_code err_code{};
+    fs::remove_all(get_entry_dir(id), err_code);
+    std::erase_if(m_entries, [id](auto&& entry) { return entry.id == id; });
+}
+
+void BuildQueue::set_state(std::uint64_t id, QueueState state, std::string reason) noexcept {
+    auto entry_it = std::ranges::find_if(m_entries, [id](auto&& entry) { return entry.id == id; });
+    /* clang-format off */
+    if (entry_it == m_entries.end()) { return; }
+    /* clang-format on */
+    entry_it->state  = state;
+    entry_it->reason = std::move(reason);
+    store(*entry_it);
+}
+
+auto BuildQueue::find(std::uint64_t id) const noexcept -> const QueueEntry* {
+    auto entry_it = std::ranges::find_if(m_entries, [id](auto&& entry) { return entry.id == id; });
+    return (entry_it != m_entries.end()) ? &*entry_it : nullptr;
+}
+
+auto BuildQueue::pick_next(std::uint64_t last_id) const noexcept -> const QueueEntry* {
+    const auto* last_entry = find(last_id);
+    const auto& order      = plan_queue_order(m_entries, (last_entry != nullptr) ? &last_entry->job : nullptr);
+    return order.empty() ? nullptr : &m_entries[order.front()];
+}
+
+auto BuildQueue::get_packages_dir(std::uint64_t id) const noexcept -> std::string {
+    return fmt::format(FMT_COMPILE("{}/packages"), get_entry_dir(id));
+}
+
+auto BuildQueue::get_entry_dir(std::uint64_t id) const noexcept -> std::string {
+    return fmt::format(FMT_COMPILE("{}/{}"), m_queue_dir, id);
+}
+
+void BuildQueue::load() noexcept {
+    std::error_code err_code{};
+    for (auto&& dir_entry : fs::directory_iterator{m_queue_dir, err_code}) {
+        const auto& dir_name = dir_entry.path().filename().string();
+        std::uint64_t id{};
+        const auto [ptr, parse_err] = std::from_chars(dir_name.data(), dir_name.data() + dir_name.size(), id);
+        /* clang-format off */
+        if (parse_err != std::errc{} || ptr != dir_name.data() + dir_name.size()) { continue; }
+        /* clang-format on */
+
+        const auto& entry_path   = fmt::format(FMT_COMPILE("{}/{}"), dir_entry.path().string(), entry_file_name);
+        const auto& options_path = fmt::format(FMT_COMPILE("{}/{}"), dir_entry.path().string(), options_file_name);
+        auto options             = fs::exists(options_path, err_code) ? ConfigOptions::parse_from_file(options_path) : std::nullopt;
+        if (!options || !fs::exists(entry_path, err_code)) {
+            fmt::print(stderr, "Skipping broken queue entry: {}\n", dir_entry.path().string());
+            continue;
+        }
+
+        QueueEntry entry{.id = id, .job = BuildJob{.options = std::move(*options)}};
+        const auto& content = utils::read_whole_file(entry_path);
+        for (auto&& line : utils::make_split_view(content, '\n')) {
+            const auto delim_pos = line.find('=');
+            /* clang-format off */
+            if (delim_pos == std::string_view::npos) { continue; }
+            /* clang-format on */
+
+            const auto field_name  = line.substr(0, delim_pos);
+            const auto field_value = line.substr(delim_pos + 1);
+            if (field_name == "variant") {
+                entry.job.variant = field_value;
+            } else if (field_name == "state") {
+                entry.state = parse_queue_state(field_value);
+            } else if (field_name == "reason") {
+                entry.reason = field_value;
+            } else if (field_name == "compression") {
+                entry.job.compression = parse_compression(field_value);
+            } else if (field_name == "patch") {
+                entry.job.patches.emplace_back(field_value);
+            }
+        }
+        // the build was interrupted, e.g. the manager was closed
+        if (entry.state == QueueState::Running) {
+            entry.state = QueueState::Pending;
+        }
+        m_next_id = std::max(m_next_id, id + 1);
+        m_entries.emplace_back(std::move(entry));
+    }
+    std::ranges::sort(m_entries, {}, &QueueEntry::id);
+}
+
+void BuildQueue::store(const QueueEntry& entry) const noexcept {
+    const auto& entry_dir = get_entry_dir(entry.id);
+    std::error_code err_code{};
+    fs::create_directories(entry_dir, err_code);
+    if (err_code) {
+        fmt::print(stderr, "Failed to create queue entry: {}\n", err_code.message());
+        return;
+    }
+
+    auto content = fmt::format(FMT_COMPILE("variant={}\nstate={}\ncompression={}\n"), entry.job.variant, queue_state_names[static_cast<std::size_t>(entry.state)],
+        compression_names[static_cast<std::size_t>(entry.job.compression)]);
+    if (!entry.reason.empty()) {
+        auto reason = entry.reason;
+        std::ranges::replace(reason, '\n', ' ');
+        content += fmt::format(FMT_COMPILE("reason={}\n"), reason);
+    }
+    for (auto&& patch : entry.job.patches) {
+        content += fmt::format(FMT_COMPILE("patch={}\n"), patch);
+    }
+    const auto& options_path = fmt::format(FMT_COMPILE("{}/{}"), entry_dir, options_file_name);
+    if (!fs::exists(options_path, err_code)) {
+        ConfigOptions::write_config_file(entry.job.options, options_path);
+    }
+    utils::write_to_file(fmt::format(FMT_COMPILE("{}/{}"), entry_dir, entry_file_name), content);
+}
+
+}  // namespace build
@@ -0,0 +1,96 @@
+// Copyright (C) 2022-2024 Vladislav Nepogodin
+//
+// This file is part of CachyOS kernel manager.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#ifndef BUILD_QUEUE_HPP
+#define BUILD_QUEUE_HPP
+
+#include "build_job.hpp"
+
+#include <cstddef>      // for size_t
+#include <cstdint>      // for uint64_t, uint8_t, uint32_t
+#include <span>         // for span
+#include <string>       // for string
+#include <string_view>  // for string_view
+#include <vector>       // for vector
+
+namespace build {
+
+enum class QueueState : std::uint8_t {
+    Pending,
+    Running,
+    Done,
+    Failed,
+};
+
+struct QueueEntry {
+    std::uint64_t id{};
+    QueueState state{};
+    BuildJob job{};
+    /// Why the build has failed, if it didn't start at all.
+    std::string reason{};
+};
+
+/// @brief Cost of building the job right after the previous one: the compiler cache doesn't hit
+/// with the different compiler flags, and the sources and the kept tree are per variant.
+auto get_switch_cost(const BuildJob& previous, const BuildJob& next) noexcept -> std::uint32_t;
+
+/// @brief Order of the pending entries, each next one is the cheapest to build after the previous,
+/// ties are resolved in the order of the queue.
+/// @param last_job Job built the last, nullptr to start with the oldest entry.
+/// @return Indices of the pending entries.
+auto plan_queue_order(std::span<const QueueEntry> entries, const BuildJob* last_job) noexcept -> std::vector<std::size_t>;
+
+/// @brief Build queue, which is persisted at ~/.cache/cachyos-km/queue, one directory per entry
+/// with the options in TOML, so it survives the restart of the manager.
+class BuildQueue {
+ public:
+    explicit BuildQueue(std::string queue_dir) noexcept;
+
+    /// @brief Process-wide queue, entries interrupted by the previous run are pending again.
+    static auto instance() noexcept -> BuildQueue&;
+
+    auto enqueue(BuildJob job) noexcept -> std::uint64_t;
+    /// @brief Removes the entry together with its built packages.
+    void remove(std::uint64_t id) noexcept;
+    void set_state(std::uint64_t id, QueueState state, std::string reason = {}) noexcept;
+
+    auto find(std::uint64_t id) const noexcept -> const QueueEntry*;
+    /// @brief Next entry to build, after the entry with last_id.
+    auto pick_next(std::uint64_t last_id) const noexcept -> const QueueEntry*;
+
+    /// @brief Directory, where the packages of the entry are moved after the build.
+    auto get_packages_dir(std::uint64_t id) const noexcept -> std::string;
+
+    /* clang-format off */
+    auto get_entries() const noexcept -> const std::vector<QueueEntry>&
+    { return m_entries; }
+    /* clang-format on */
+
+ private:
+    void load() noexcept;
+    void store(const QueueEntry& entry) const noexcept;
+    auto get_entry_dir(std::uint64_t id) const noexcept -> std::string;
+
+    std::string m_queue_dir{};
+    std::vector<QueueEntry> m_entries{};
+    std::uint64_t m_next_id{1};
+};
+
+}  // namespace build
+
+#endif  // BUILD_QUEUE_HPP
@@ -0,0 +1,225 @@
+// Copyright (C) 2022-2024 Vladislav Nepogodin
+//
+// This file is part of CachyOS kernel manager.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include "build_state.hpp"
+#include "source_store.hpp"
+#include "utils.hpp"
+
+#include <algorithm>     // for mismatch
+#include <charconv>      // for from_chars
+#include <filesystem>    // for exists, create_directories, directory_iterator
+#include <system_error>  // for error_code
+
+#include <fmt/compile.h>
+#include <fmt/core.h>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+constexpr std::string_view state_file_name  = ".km-build-state";
+constexpr std::string_view patches_dir_name = ".km-patches";
+
+// Stored copy of the applied patch, the original can be gone by the time it has to be reverted.
+auto get_stored_patch_path(std::string_view patches_dir, std::size_t index, std::string_view patch) noexcept -> std::string {
+    return fmt::format(FMT_COMPILE("{}/{:03}-{}"), patches_dir, index, build::get_source_name(patch));
+}
+
+// makepkg keeps the tree at BUILDDIR/<pkgbase>/src
+auto has_kept_tree(const fs::path& build_dir) noexcept -> bool {
+    std::error_code err_code{};
+    for (auto&& dir_entry : fs::directory_iterator{build_dir, err_code}) {
+        if (fs::is_directory(dir_entry.path() / "src", err_code)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+auto parse_key(std::string_view value) noexcept -> std::optional<std::uint64_t> {
+    std::uint64_t key{};
+    const auto [ptr, err_code] = std::from_chars(value.data(), value.data() + value.size(), key, 16);
+    if (err_code != std::errc{} || ptr != value.data() + value.size()) {
+        return std::nullopt;
+    }
+    return key;
+}
+
+auto make_prepare_clean_func(const std::vector<std::string>& patches, std::string_view patches_dir) noexcept -> std::string {
+    std::string result{"km_prepare_clean() {\n"};
+    result += fmt::format(FMT_COMPILE("    rm -rf -- {0} && mkdir -p -- {0} || return 1\n"), utils::shell_quote(patches_dir));
+    result += "    makepkg -sof --cleanbuild --skipchecksums || return 1\n";
+    for (std::size_t i = 0; i < patches.size(); ++i) {
+        result += fmt::format(FMT_COMPILE("    cp -- \"$SRCDEST\"/{} {} || return 1\n"), utils::shell_quote(build::get_source_name(patches[i])),
+            utils::shell_quote(get_stored_patch_path(patches_dir, i, patches[i])));
+    }
+    result += "}\n";
+    return result;
+}
+
+auto make_repatch_func(const build::TreeState& current, const build::TreeState& wanted, std::string_view build_dir, std::string_view patches_dir) noexcept -> std::string {
+    const auto common_count = static_cast<std::size_t>(std::ranges::mismatch(current.patches, wanted.patches).in1 - current.patches.begin());
+
+    std::string result{"km_repatch() {\n"};
+    // download the new patches
+    result += "    makepkg --verifysource --skipchecksums || return 1\n";
+    result += "    tree_dir=''\n";
+    result += fmt::format(FMT_COMPILE("    for kconfig in {}/*/src/linux-*/Kconfig; do tree_dir=${{kconfig%/Kconfig}}; break; done\n"), utils::shell_quote(build_dir));
+    result += "    [ -d \"$tree_dir\" ] || return 1\n";
+
+    // revert the changed tail in the reverse order
+    for (std::size_t i = current.patches.size(); i > common_count; --i) {
+        const auto& stored_path = utils::shell_quote(get_stored_patch_path(patches_dir, i - 1, current.patches[i - 1]));
+        result += fmt::format(FMT_COMPILE("    echo {}\n"), utils::shell_quote(fmt::format(FMT_COMPILE("==> Reverting {}"), current.patches[i - 1])));
+        result += fmt::format(FMT_COMPILE("    (cd \"$tree_dir\" && patch -Rp1 -s) < {0} && rm -f -- {0} || return 1\n"), stored_path);
+    }
+    for (std::size_t i = common_count; i < wanted.patches.size(); ++i) {
+        const auto& source_path = fmt::format(FMT_COMPILE("\"$SRCDEST\"/{}"), utils::shell_quote(build::get_source_name(wanted.patches[i])));
+        result += fmt::format(FMT_COMPILE("    echo {}\n"), utils::shell_quote(fmt::format(FMT_COMPILE("==> Applying {}"), wanted.patches[i])));
+        result += fmt::format(FMT_COMPILE("    (cd \"$tree_dir\" && patch -Np1 -s) < {0} && cp -- {0} {1} || return 1\n"), source_path,
+            utils::shell_quote(get_stored_patch_path(patches_dir, i, wanted.patches[i])));
+    }
+    result += "}\n";
+    return result;
+}
+
+}  // namespace
+
+namespace build {
+
+auto TreeState::parse(std::string_view content) noexcept -> std::optional<TreeState> {
+    TreeState state{};
+    bool has_base_key{};
+    bool has_options_key{};
+    for (auto&& line : utils::make_split_view(content, '\n')) {
+        const auto delim_pos = line.find('=');
+        /* clang-format off */
+        if (delim_pos == std::string_view::npos) { return std::nullopt; }
+        /* clang-format on */
+
+        const auto field_name  = line.substr(0, delim_pos);
+        const auto field_value = line.substr(delim_pos + 1);
+        if (field_name == "base") {
+            auto key = parse_key(field_value);
+            /* clang-format off */
+            if (!key) { return std::nullopt; }
+            /* clang-format on */
+            state.base_key = *key;
+            has_base_key   = true;
+        } else if (field_name == "options") {
+            auto key = parse_key(field_value);
+            /* clang-format off */
+            if (!key) { return std::nullopt; }
+            /* clang-format on */
+            state.options_key = *key;
+            has_options_key   = true;
+        } else if (field_name == "patch") {
+            state.patches.emplace_back(field_value);
+        }
+    }
+    if (!has_base_key || !has_options_key) {
+        return std::nullopt;
+    }
+    return std::make_optional(std::move(state));
+}
+
+auto TreeState::to_string() const noexcept -> std::string {
+    auto result = fmt::format(FMT_COMPILE("base={:016x}\noptions={:016x}\n"), base_key, options_key);
+    for (auto&& patch : patches) {
+        result += fmt::format(FMT_COMPILE("patch={}\n"), patch);
+    }
+    return result;
+}
+
+auto plan_incremental_build(std::string_view variant, const TreeState& wanted) noexcept -> IncrementalBuild {
+    IncrementalBuild plan{.build_dir = utils::fix_path(fmt::format(FMT_COMPILE("~/.cache/cachyos-km/build-trees/{}"), variant))};
+    const auto& state_path    = fmt::format(FMT_COMPILE("{}/{}"), plan.build_dir, state_file_name);
+    const auto& patches_dir   = fmt::format(FMT_COMPILE("{}/{}"), plan.build_dir, patches_dir_name);
+    const auto& next_state    = fmt::format(FMT_COMPILE("{}.next"), state_path);
+    const auto& current_state = fs::exists(state_path) ? TreeState::parse(utils::read_whole_file(state_path)) : std::nullopt;
+
+    if (!current_state || !has_kept_tree(plan.build_dir) || current_state->base_key != wanted.base_key || current_state->options_key != wanted.options_key) {
+        plan.mode = BuildMode::Clean;
+    } else if (current_state->patches != wanted.patches) {
+        plan.mode = BuildMode::Repatch;
+    } else {
+        plan.mode = BuildMode::Resume;
+    }
+
+    // the state is committed by the script, once the tree is prepared
+    std::error_code err_code{};
+    fs::create_directories(plan.build_dir, err_code);
+    if (err_code || !utils::write_to_file(next_state, wanted.to_string())) {
+        fmt::print(stderr, "Failed to write build state: {}\n", err_code.message());
+        plan.mode = BuildMode::Clean;
+    }
+
+    // NOTE: packages are pinned to the PKGBUILD directory, as well as the sources,
+    // unless they are handed out from the store.
+    plan.script = "export SRCDEST=\"${SRCDEST:-$PWD}\" PKGDEST=\"$PWD\"\n";
+    // NOTE: the old state is dropped before the tree is touched, so the tree, which failed to prepare,
+    // is never resumed, even if the old inputs are wanted again.
+    if (plan.mode != BuildMode::Resume) {
+        plan.script += fmt::format(FMT_COMPILE("rm -f -- {} || exit 1\n"), utils::shell_quote(state_path));
+    }
+    switch (plan.mode) {
+    case BuildMode::Clean:
+        plan.script += make_prepare_clean_func(wanted.patches, patches_dir);
+        plan.script += "echo '==> Preparing the tree from scratch'\n";
+        plan.script += "km_prepare_clean || exit 1\n";
+        break;
+    case BuildMode::Repatch:
+        plan.script += make_prepare_clean_func(wanted.patches, patches_dir);
+        plan.script += make_repatch_func(*current_state, wanted, plan.build_dir, patches_dir);
+        plan.script += "echo '==> Re-applying the changed patches'\n";
+        plan.script += "km_repatch || { echo '==> Failed to re-apply patches, preparing the tree from scratch'; km_prepare_clean; } || exit 1\n";
+        break;
+    case BuildMode::Resume:
+        plan.script += "echo '==> Resuming the build in the kept tree'\n";
+        break;
+    }
+    plan.script += fmt::format(FMT_COMPILE("mv -f -- {} {} || exit 1\n"), utils::shell_quote(next_state), utils::shell_quote(state_path));
+    plan.script += "makepkg -sef --skipchecksums";
+    return plan;
+}
+
+auto plan_aur_build(std::string_view package_name, std::string_view commit, std::string_view makepkg_flags) noexcept -> IncrementalBuild {
+    IncrementalBuild plan{.build_dir = utils::fix_path("~/.cache/cachyos-km/build-trees/aur")};
+    const auto& state_path = fmt::format(FMT_COMPILE("{}/{}{}"), plan.build_dir, package_name, state_file_name);
+
+    // the state holds the commit, which was prepared but not built successfully yet.
+    // NOTE: the build directory is shared by the AUR packages, only the tree of this one counts.
+    std::error_code err_code{};
+    const bool has_package_tree = fs::is_directory(fmt::format(FMT_COMPILE("{}/{}/src"), plan.build_dir, package_name), err_code);
+    const bool is_prepared      = fs::exists(state_path) && utils::read_whole_file(state_path) == commit && has_package_tree;
+    plan.mode              = is_prepared ? BuildMode::Resume : BuildMode::Clean;
+
+    const auto& quoted_state_path = utils::shell_quote(state_path);
+    if (plan.mode == BuildMode::Clean) {
+        plan.script = fmt::format(FMT_COMPILE("mkdir -p -- {} && makepkg -sof --cleanbuild --skipchecksums && printf '%s' {} > {} && "),
+            utils::shell_quote(plan.build_dir), utils::shell_quote(commit), quoted_state_path);
+    } else {
+        plan.script = "echo '==> Resuming the previous build' && ";
+    }
+    // the tree is kept only for the failed build, the successful one isn't resumed
+    plan.script += fmt::format(FMT_COMPILE("makepkg -se{}f --skipchecksums && rm -f -- {} && rm -rf -- {}"), makepkg_flags, quoted_state_path,
+        utils::shell_quote(fmt::format(FMT_COMPILE("{}/{}"), plan.build_dir, package_name)));
+    return plan;
+}
+
+}  // namespace build
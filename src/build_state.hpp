@@ -0,0 +1,74 @@
+// Copyright (C) 2022-2024 Vladislav Nepogodin
+//
+// This file is part of CachyOS kernel manager.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#ifndef BUILD_STATE_HPP
+#define BUILD_STATE_HPP
+
+#include <cstdint>      // for uint64_t, uint8_t
+#include <optional>     // for optional
+#include <string>       // for string
+#include <string_view>  // for string_view
+#include <vector>       // for vector
+
+namespace build {
+
+enum class BuildMode : std::uint8_t {
+    /// Extract and prepare the tree from scratch.
+    Clean,
+    /// Continue the build in the unchanged tree.
+    Resume,
+    /// Re-apply only the changed tail of the patch stack, then continue the build.
+    Repatch,
+};
+
+/// @brief What was applied to the kept source tree.
+struct TreeState {
+    /// Hash of the non-patch sources and package name, the tree is extracted again if it changes.
+    std::uint64_t base_key{};
+    /// Hash of the option environment, which configures the kernel in prepare().
+    std::uint64_t options_key{};
+    /// Patch stack in the order of application, as written in the source array.
+    std::vector<std::string> patches{};
+
+    static auto parse(std::string_view content) noexcept -> std::optional<TreeState>;
+    [[nodiscard]] auto to_string() const noexcept -> std::string;
+};
+
+/// @brief Plan of the build in the kept tree.
+struct IncrementalBuild {
+    BuildMode mode{};
+    /// makepkg BUILDDIR, the tree is kept there between the builds.
+    std::string build_dir{};
+    /// Commands, which bring the tree into the wanted state and build the packages.
+    std::string script{};
+};
+
+/// @brief Compares the wanted state with the state of the tree kept at
+/// ~/.cache/cachyos-km/build-trees/<variant>, and picks the cheapest way to build it.
+/// NOTE: prepare() of PKGBUILD both patches and configures the kernel, and makepkg can't run it
+/// without extraction, so changed options restart the build from extraction.
+auto plan_incremental_build(std::string_view variant, const TreeState& wanted) noexcept -> IncrementalBuild;
+
+/// @brief Plans the build of the AUR package, which resumes after prepare(),
+/// if the previous build of the same commit has failed. The tree is removed after the successful build.
+/// @param makepkg_flags Extra short makepkg flags, e.g. "i" to install the packages.
+auto plan_aur_build(std::string_view package_name, std::string_view commit, std::string_view makepkg_flags) noexcept -> IncrementalBuild;
+
+}  // namespace build
+
+#endif  // BUILD_STATE_HPP
@@ -0,0 +1,431 @@
+// Copyright (C) 2022-2024 Vladislav Nepogodin
+//
+// This file is part of CachyOS kernel manager.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include "build_telemetry.hpp"
+#include "build_monitor.hpp"
+#include "utils.hpp"
+
+#include <algorithm>     // for max, sort, ranges::find
+#include <charconv>      // for from_chars
+#include <ctime>         // for time
+#include <filesystem>    // for create_directories, directory_iterator, remove
+#include <fstream>       // for ifstream, ofstream
+#include <iterator>      // for istreambuf_iterator
+#include <numeric>       // for accumulate
+#include <set>           // for set
+#include <system_error>  // for error_code
+
+#include <fmt/compile.h>
+#include <fmt/core.h>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// NOTE: the builds are compared only with the recent ones, older hardware or compiler might be slower.
+constexpr std::size_t estimate_builds_limit = 5;
+constexpr std::size_t logs_limit            = 20;
+
+template <typename T>
+auto parse_number(std::string_view value) noexcept -> std::optional<T> {
+    T result{};
+    const auto [ptr, err_code] = std::from_chars(value.data(), value.data() + value.size(), result);
+    if (err_code != std::errc{} || ptr != value.data() + value.size()) {
+        return std::nullopt;
+    }
+    return result;
+}
+
+// Drops the terminal escape sequences and carriage returns of the progress output, which script records.
+auto strip_terminal_output(std::string_view line) noexcept -> std::string {
+    while (line.ends_with('\r')) {
+        line.remove_suffix(1);
+    }
+    if (auto cr_pos = line.rfind('\r'); cr_pos != std::string_view::npos) {
+        line.remove_prefix(cr_pos + 1);
+    }
+
+    std::string result{};
+    for (std::size_t i = 0; i < line.size(); ++i) {
+        if (line[i] != '\x1b') {
+            result += line[i];
+            continue;
+        }
+        // CSI sequence ends with the letter, e.g. '\x1b[1;32m'
+        if (i + 1 < line.size() && line[i + 1] == '[') {
+            i += 2;
+            while (i < line.size() && (line[i] < '@' || line[i] > '~')) {
+                ++i;
+            }
+        }
+    }
+    return result;
+}
+
+auto get_average_durations(const std::vector<const build::BuildRecord*>& records) noexcept -> std::optional<build::PhaseDurations> {
+    /* clang-format off */
+    if (records.empty()) { return std::nullopt; }
+    /* clang-format on */
+
+    // the latest builds are at the end
+    const auto first_index = records.size() - std::min(records.size(), estimate_builds_limit);
+    const auto count       = static_cast<double>(records.size() - first_index);
+
+    build::PhaseDurations result{};
+    for (std::size_t i = first_index; i < records.size(); ++i) {
+        for (std::size_t phase = 0; phase < build::build_phases_count; ++phase) {
+            result[phase] += records[i]->phases[phase].wall_secs / count;
+        }
+    }
+    return result;
+}
+
+}  // namespace
+
+namespace build {
+
+auto parse_phase_marker(std::string_view line) noexcept -> std::optional<BuildPhase> {
+    /* clang-format off */
+    if (!line.starts_with("==> ")) { return std::nullopt; }
+    /* clang-format on */
+    line.remove_prefix(4);
+
+    if (line.starts_with("Retrieving sources")) {
+        return BuildPhase::Retrieve;
+    } else if (line.starts_with("Extracting sources")) {
+        return BuildPhase::Extract;
+    } else if (line.starts_with("Starting prepare()")) {
+        return BuildPhase::Prepare;
+    } else if (line.starts_with("Starting build()")) {
+        return BuildPhase::Build;
+    } else if (line.starts_with("Entering fakeroot environment") || line.starts_with("Starting package")) {
+        return BuildPhase::Package;
+    }
+    return std::nullopt;
+}
+
+auto BuildRecord::get_total_secs() const noexcept -> double {
+    return std::accumulate(phases.begin(), phases.end(), 0.0, [](double total, auto&& stats) { return total + stats.wall_secs; });
+}
+
+// 'finished_at<TAB>variant<TAB>options_key<TAB>succeeded<TAB>wall/cpu/memory,...<TAB>option,...'
+auto BuildRecord::parse(std::string_view line) noexcept -> std::optional<BuildRecord> {
+    std::vector<std::string_view> fields{};
+    for (std::size_t pos{}; pos <= line.size();) {
+        const auto tab_pos = std::min(line.find('\t', pos), line.size());
+        fields.emplace_back(line.substr(pos, tab_pos - pos));
+        pos = tab_pos + 1;
+    }
+    /* clang-format off */
+    if (fields.size() != 6) { return std::nullopt; }
+    /* clang-format on */
+
+    BuildRecord record{.variant = std::string{fields[1]}, .succeeded = (fields[3] == "1")};
+    const auto finished_at = parse_number<std::int64_t>(fields[0]);
+    const auto options_key = [&]() -> std::optional<std::uint64_t> {
+        std::uint64_t key{};
+        const auto [ptr, err_code] = std::from_chars(fields[2].data(), fields[2].data() + fields[2].size(), key, 16);
+        return (err_code == std::errc{}) ? std::make_optional(key) : std::nullopt;
+    }();
+    if (!finished_at || !options_key) {
+        return std::nullopt;
+    }
+    record.finished_at = *finished_at;
+    record.options_key = *options_key;
+
+    std::size_t phase{};
+    for (auto&& phase_stats : utils::make_split_view(fields[4], ',')) {
+        /* clang-format off */
+        if (phase >= build_phases_count) { return std::nullopt; }
+        /* clang-format on */
+        const auto& values = utils::make_multiline_view(phase_stats, '/');
+        if (values.size() != 3) {
+            return std::nullopt;
+        }
+        auto& stats       = record.phases[phase++];
+        stats.wall_secs   = parse_number<double>(values[0]).value_or(0);
+        stats.cpu_secs    = parse_number<double>(values[1]).value_or(0);
+        stats.peak_memory = parse_number<std::uint64_t>(values[2]).value_or(0);
+    }
+    for (auto&& option : utils::make_split_view(fields[5], ',')) {
+        record.options.emplace_back(option);
+    }
+    return std::make_optional(std::move(record));
+}
+
+auto BuildRecord::to_string() const noexcept -> std::string {
+    auto result = fmt::format(FMT_COMPILE("{}\t{}\t{:016x}\t{}\t"), finished_at, variant, options_key, succeeded ? 1 : 0);
+    for (std::size_t phase = 0; phase < build_phases_count; ++phase) {
+        result += fmt::format(FMT_COMPILE("{}{:.1f}/{:.1f}/{}"), (phase == 0) ? "" : ",", phases[phase].wall_secs, phases[phase].cpu_secs, phases[phase].peak_memory);
+    }
+    result += '\t';
+    for (std::size_t i = 0; i < options.size(); ++i) {
+        result += fmt::format(FMT_COMPILE("{}{}"), (i == 0) ? "" : ",", options[i]);
+    }
+    return result;
+}
+
+auto BuildHistory::instance() noexcept -> BuildHistory& {
+    static BuildHistory history{utils::fix_path("~/.cache/cachyos-km/build-history")};
+    return history;
+}
+
+auto BuildHistory::load() const noexcept -> std::vector<BuildRecord> {
+    std::vector<BuildRecord> records{};
+    /* clang-format off */
+    if (!fs::exists(m_file_path)) { return records; }
+    /* clang-format on */
+
+    const auto& content = utils::read_whole_file(m_file_path);
+    for (auto&& line : utils::make_split_view(content, '\n')) {
+        if (auto record = BuildRecord::parse(line)) {
+            records.emplace_back(std::move(*record));
+        }
+    }
+    return records;
+}
+
+auto BuildHistory::append(const BuildRecord& record) const noexcept -> bool {
+    std::error_code err_code{};
+    fs::create_directories(fs::path{m_file_path}.parent_path(), err_code);
+
+    std::ofstream history_file{m_file_path, std::ios::app};
+    if (!history_file.is_open()) {
+        fmt::print(stderr, "Failed to open build history: {}\n", m_file_path);
+        return false;
+    }
+    history_file << record.to_string() << '\n';
+    return true;
+}
+
+auto BuildHistory::estimate(std::string_view variant, std::uint64_t options_key) const noexcept -> std::optional<PhaseDurations> {
+    const auto& records = load();
+
+    std::vector<const BuildRecord*> same_options{};
+    std::vector<const BuildRecord*> same_variant{};
+    for (auto&& record : records) {
+        /* clang-format off */
+        if (!record.succeeded || record.variant != variant) { continue; }
+        /* clang-format on */
+        same_variant.emplace_back(&record);
+        if (record.options_key == options_key) {
+            same_options.emplace_back(&record);
+        }
+    }
+    return same_options.empty() ? get_average_durations(same_variant) : get_average_durations(same_options);
+}
+
+auto BuildHistory::get_option_costs() const noexcept -> std::vector<OptionCost> {
+    auto records = load();
+    std::erase_if(records, [](auto&& record) { return !record.succeeded; });
+
+    std::set<std::string_view> all_options{};
+    for (auto&& record : records) {
+        all_options.insert(record.options.begin(), record.options.end());
+    }
+
+    std::vector<OptionCost> result{};
+    for (auto&& option : all_options) {
+        double secs_with{};
+        double secs_without{};
+        std::size_t builds_with{};
+        for (auto&& record : records) {
+            if (std::ranges::find(record.options, option) != record.options.end()) {
+                secs_with += record.get_total_secs();
+                ++builds_with;
+            } else {
+                secs_without += record.get_total_secs();
+            }
+        }
+        // the option was used either in every build or in none, nothing to compare with
+        /* clang-format off */
+        if (builds_with == records.size()) { continue; }
+        /* clang-format on */
+
+        result.emplace_back(OptionCost{
+            .option           = std::string{option},
+            .builds_with      = builds_with,
+            .avg_secs_with    = secs_with / static_cast<double>(builds_with),
+            .avg_secs_without = secs_without / static_cast<double>(records.size() - builds_with),
+        });
+    }
+    std::ranges::sort(result, [](auto&& lhs, auto&& rhs) { return (lhs.avg_secs_with - lhs.avg_secs_without) > (rhs.avg_secs_with - rhs.avg_secs_without); });
+    return result;
+}
+
+BuildTracker::BuildTracker(std::string variant, std::string_view options, std::string log_file, std::string cgroup_file) noexcept
+  : m_log_file(std::move(log_file)), m_cgroup_file(std::move(cgroup_file)) {
+    m_record.variant     = std::move(variant);
+    m_record.options_key = utils::fnv1a_append(utils::fnv1a_offset_basis, options);
+    for (auto&& option : utils::make_split_view(options, '\n')) {
+        m_record.options.emplace_back(option);
+    }
+}
+
+auto BuildTracker::make_log_paths(std::string_view variant) noexcept -> std::pair<std::string, std::string> {
+    const auto& logs_dir = utils::fix_path("~/.cache/cachyos-km/logs");
+
+    std::error_code err_code{};
+    fs::create_directories(logs_dir, err_code);
+
+    // keep only the most recent logs
+    std::vector<fs::directory_entry> log_files{};
+    for (auto&& dir_entry : fs::directory_iterator{logs_dir, err_code}) {
+        if (dir_entry.path().extension() == ".log") {
+            log_files.emplace_back(dir_entry);
+        }
+    }
+    std::ranges::sort(log_files, [](auto&& lhs, auto&& rhs) { return lhs.last_write_time() > rhs.last_write_time(); });
+    for (std::size_t i = logs_limit - 1; i < log_files.size(); ++i) {
+        auto cgroup_file = log_files[i].path();
+        fs::remove(cgroup_file.replace_extension(".cgroup"), err_code);
+        fs::remove(log_files[i].path(), err_code);
+    }
+
+    const auto& base_path = fmt::format(FMT_COMPILE("{}/{}-{}"), logs_dir, variant, std::time(nullptr));
+    return {fmt::format(FMT_COMPILE("{}.log"), base_path), fmt::format(FMT_COMPILE("{}.cgroup"), base_path)};
+}
+
+void BuildTracker::poll() noexcept {
+    /* clang-format off */
+    if (is_finished()) { return; }
+    /* clang-format on */
+    sample_cgroup();
+
+    std::ifstream log_stream{m_log_file, std::ios::binary};
+    /* clang-format off */
+    if (!log_stream.is_open()) { return; }
+    /* clang-format on */
+    log_stream.seekg(static_cast<std::streamoff>(m_log_offset));
+    const std::string new_content{std::istreambuf_iterator<char>{log_stream}, std::istreambuf_iterator<char>{}};
+    m_log_offset += new_content.size();
+
+    m_partial_line += new_content;
+    std::size_t line_start{};
+    for (auto newline_pos = m_partial_line.find('\n'); newline_pos != std::string::npos; newline_pos = m_partial_line.find('\n', line_start)) {
+        process_line(strip_terminal_output(std::string_view{m_partial_line}.substr(line_start, newline_pos - line_start)));
+        line_start = newline_pos + 1;
+    }
+    m_partial_line.erase(0, line_start);
+}
+
+auto BuildTracker::get_elapsed_secs() const noexcept -> double {
+    return std::chrono::duration<double>(clock_t::now() - m_started_at).count();
+}
+
+auto BuildTracker::get_eta_secs(const PhaseDurations& expected) const noexcept -> double {
+    /* clang-format off */
+    if (!m_phase) { return std::accumulate(expected.begin(), expected.end(), 0.0); }
+    /* clang-format on */
+
+    const auto phase_index   = static_cast<std::size_t>(*m_phase);
+    const auto phase_elapsed = std::chrono::duration<double>(clock_t::now() - m_phase_started_at).count();
+    return std::max(expected[phase_index] - phase_elapsed, 0.0) + std::accumulate(expected.begin() + static_cast<std::ptrdiff_t>(phase_index) + 1, expected.end(), 0.0);
+}
+
+void BuildTracker::finish(bool succeeded) noexcept {
+    /* clang-format off */
+    if (is_finished()) { return; }
+    /* clang-format on */
+    sample_cgroup();
+    enter_phase(std::nullopt);
+    m_record.succeeded   = succeeded;
+    m_record.finished_at = std::time(nullptr);
+}
+
+void BuildTracker::process_line(std::string_view line) noexcept {
+    if (line.starts_with("km-build-status=")) {
+        finish(line.substr(16) == "0");
+        return;
+    }
+
+    // NOTE: package phase is started once per split package, only the first one is taken.
+    const auto phase = parse_phase_marker(line);
+    if (phase && (!m_phase || *phase > *m_phase)) {
+        enter_phase(phase);
+    }
+}
+
+void BuildTracker::enter_phase(std::optional<BuildPhase> phase) noexcept {
+    const auto now = clock_t::now();
+    if (m_phase) {
+        auto& stats = m_record.phases[static_cast<std::size_t>(*m_phase)];
+        stats.wall_secs += std::chrono::duration<double>(now - m_phase_started_at).count();
+        stats.cpu_secs += static_cast<double>(m_last_cpu_usec - m_phase_cpu_usec) / 1e6;
+    }
+    m_phase            = phase;
+    m_phase_started_at = now;
+    m_phase_cpu_usec   = m_last_cpu_usec;
+}
+
+void BuildTracker::sample_cgroup() noexcept {
+    if (m_cgroup_dir.empty()) {
+        // only the scope started by systemd-run belongs to the build alone
+        /* clang-format off */
+        if (m_is_process_tree || !fs::exists(m_cgroup_file)) { return; }
+        /* clang-format on */
+        auto cgroup_path = utils::read_whole_file(m_cgroup_file);
+        while (cgroup_path.ends_with('\n')) {
+            cgroup_path.pop_back();
+        }
+        /* clang-format off */
+        if (cgroup_path.empty()) { return; }
+        /* clang-format on */
+        const auto scope_name = fs::path{cgroup_path}.filename().string();
+        if (!scope_name.starts_with("run-") || !scope_name.ends_with(".scope")) {
+            // e.g. the nice fallback, or no user manager, the process tree is sampled instead
+            m_is_process_tree = true;
+            return;
+        }
+        m_cgroup_dir = fmt::format(FMT_COMPILE("/sys/fs/cgroup{}"), cgroup_path);
+    }
+
+    // the scope is gone, once the build is finished, the last sample is kept then
+    m_last_cpu_usec = read_cgroup_value(m_cgroup_dir, "cpu.stat", "usage_usec").value_or(m_last_cpu_usec);
+
+    // NOTE: memory.peak (Linux 5.19+) also catches the short spikes between the samples, e.g. of LTO.
+    // It is the peak of the whole build, so only its growth is taken for the current phase.
+    auto memory_bytes = read_cgroup_value(m_cgroup_dir, "memory.current").value_or(0);
+    if (const auto memory_peak = read_cgroup_value(m_cgroup_dir, "memory.peak"); memory_peak && *memory_peak > m_last_memory_peak) {
+        memory_bytes       = std::max(memory_bytes, *memory_peak);
+        m_last_memory_peak = *memory_peak;
+    }
+    add_memory_sample(memory_bytes);
+}
+
+void BuildTracker::add_process_tree_sample(const std::optional<ResourceSampler::Counters>& counters) noexcept {
+    /* clang-format off */
+    if (!m_is_process_tree || !counters || is_finished()) { return; }
+    /* clang-format on */
+
+    // counters of the tree go down, when the processes exit, only the growth is counted
+    if (counters->cpu_usec > m_tree_cpu_usec) {
+        m_last_cpu_usec += counters->cpu_usec - m_tree_cpu_usec;
+    }
+    m_tree_cpu_usec = counters->cpu_usec;
+    add_memory_sample(counters->memory_bytes);
+}
+
+void BuildTracker::add_memory_sample(std::uint64_t memory_bytes) noexcept {
+    if (m_phase) {
+        auto& stats       = m_record.phases[static_cast<std::size_t>(*m_phase)];
+        stats.peak_memory = std::max(stats.peak_memory, memory_bytes);
+    }
+}
+
+}  // namespace build
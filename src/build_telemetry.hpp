@@ -0,0 +1,186 @@
+// Copyright (C) 2022-2024 Vladislav Nepogodin
+//
+// This file is part of CachyOS kernel manager.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#ifndef BUILD_TELEMETRY_HPP
+#define BUILD_TELEMETRY_HPP
+
+#include "build_monitor.hpp"
+
+#include <array>        // for array
+#include <chrono>       // for steady_clock
+#include <cstddef>      // for size_t
+#include <cstdint>      // for int64_t, uint8_t, uint64_t
+#include <optional>     // for optional
+#include <string>       // for string
+#include <string_view>  // for string_view
+#include <utility>      // for move
+#include <vector>       // for vector
+
+namespace build {
+
+enum class BuildPhase : std::uint8_t {
+    Retrieve,
+    Extract,
+    Prepare,
+    Build,
+    Package,
+};
+
+constexpr std::size_t build_phases_count = 5;
+
+constexpr std::array<std::string_view, build_phases_count> build_phase_names{"retrieve", "extract", "prepare", "build", "package"};
+
+/// @brief Phase, which is started by the makepkg message, e.g. "==> Starting build()...".
+/// The line must be stripped of the terminal escape sequences.
+auto parse_phase_marker(std::string_view line) noexcept -> std::optional<BuildPhase>;
+
+struct PhaseStats {
+    double wall_secs{};
+    /// CPU time of the build cgroup, or of its makepkg process tree, if the build didn't run in its own scope.
+    double cpu_secs{};
+    /// Peak memory of the phase, from memory.peak of the cgroup where available, otherwise the peak of the samples.
+    std::uint64_t peak_memory{};
+};
+
+using PhaseDurations = std::array<double, build_phases_count>;
+
+/// @brief Finished build, as stored in the history.
+struct BuildRecord {
+    /// Unix time of the build end.
+    std::int64_t finished_at{};
+    std::string variant{};
+    /// Hash of the option environment.
+    std::uint64_t options_key{};
+    bool succeeded{};
+    std::array<PhaseStats, build_phases_count> phases{};
+    /// Options of the build, e.g. "_use_llvm_lto=full".
+    std::vector<std::string> options{};
+
+    [[nodiscard]] auto get_total_secs() const noexcept -> double;
+
+    static auto parse(std::string_view line) noexcept -> std::optional<BuildRecord>;
+    [[nodiscard]] auto to_string() const noexcept -> std::string;
+};
+
+/// @brief Average cost of the option over the successful builds.
+struct OptionCost {
+    std::string option{};
+    std::size_t builds_with{};
+    double avg_secs_with{};
+    double avg_secs_without{};
+};
+
+/// @brief Append-only history of the builds at ~/.cache/cachyos-km/build-history,
+/// one record per line.
+class BuildHistory {
+ public:
+    explicit BuildHistory(std::string file_path) noexcept
+      : m_file_path(std::move(file_path)) { }
+
+    static auto instance() noexcept -> BuildHistory&;
+
+    auto load() const noexcept -> std::vector<BuildRecord>;
+    auto append(const BuildRecord& record) const noexcept -> bool;
+
+    /// @brief Expected duration of each phase, averaged over the recent successful builds
+    /// of the variant with the same options, or of the variant with any options.
+    auto estimate(std::string_view variant, std::uint64_t options_key) const noexcept -> std::optional<PhaseDurations>;
+
+    /// @brief Options sorted by the difference of the average build time with and without them.
+    auto get_option_costs() const noexcept -> std::vector<OptionCost>;
+
+ private:
+    std::string m_file_path{};
+};
+
+/// @brief Follows the log of the running build, and measures its phases.
+/// NOTE: phases are timed, when poll() sees the marker, so the precision is the poll interval.
+class BuildTracker {
+ public:
+    BuildTracker(std::string variant, std::string_view options, std::string log_file, std::string cgroup_file) noexcept;
+
+    /// @brief Log and cgroup files of the new build in ~/.cache/cachyos-km/logs,
+    /// older logs are removed.
+    static auto make_log_paths(std::string_view variant) noexcept -> std::pair<std::string, std::string>;
+
+    /// @brief Reads the new lines of the log, and samples the cgroup.
+    void poll() noexcept;
+
+    /* clang-format off */
+    auto is_finished() const noexcept -> bool
+    { return m_record.finished_at != 0; }
+
+    auto get_current_phase() const noexcept -> std::optional<BuildPhase>
+    { return m_phase; }
+
+    auto get_record() const noexcept -> const BuildRecord&
+    { return m_record; }
+
+    auto get_log_file() const noexcept -> const std::string&
+    { return m_log_file; }
+
+    /// Cgroup of the build, empty until the build has started in its own scope.
+    auto get_cgroup_dir() const noexcept -> const std::string&
+    { return m_cgroup_dir; }
+
+    /// The build has started without its own scope, e.g. with the nice fallback,
+    /// so its makepkg process tree is sampled instead.
+    auto is_sampling_process_tree() const noexcept -> bool
+    { return m_is_process_tree; }
+    /* clang-format on */
+
+    /// @brief Adds the counters of the makepkg process tree, see ResourceSampler::read,
+    /// ignored while the build has its own scope.
+    void add_process_tree_sample(const std::optional<ResourceSampler::Counters>& counters) noexcept;
+
+    auto get_elapsed_secs() const noexcept -> double;
+
+    /// @brief Remaining time of the build by the expected phase durations.
+    auto get_eta_secs(const PhaseDurations& expected) const noexcept -> double;
+
+    /// @brief Finishes the build, which ended without the status in the log, e.g. was killed.
+    void finish(bool succeeded) noexcept;
+
+ private:
+    using clock_t = std::chrono::steady_clock;
+
+    void process_line(std::string_view line) noexcept;
+    void enter_phase(std::optional<BuildPhase> phase) noexcept;
+    void sample_cgroup() noexcept;
+    void add_memory_sample(std::uint64_t memory_bytes) noexcept;
+
+    std::string m_log_file{};
+    std::string m_cgroup_file{};
+    std::string m_cgroup_dir{};
+    std::size_t m_log_offset{};
+    std::string m_partial_line{};
+
+    BuildRecord m_record{};
+    std::optional<BuildPhase> m_phase{};
+    clock_t::time_point m_started_at{clock_t::now()};
+    clock_t::time_point m_phase_started_at{clock_t::now()};
+    std::uint64_t m_phase_cpu_usec{};
+    std::uint64_t m_last_cpu_usec{};
+    bool m_is_process_tree{};
+    std::uint64_t m_tree_cpu_usec{};
+    std::uint64_t m_last_memory_peak{};
+};
+
+}  // namespace build
+
+#endif  // BUILD_TELEMETRY_HPP
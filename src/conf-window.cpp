@@ -17,17 +17,32 @@
 // 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
 
 #include "conf-window.hpp"
+#include "artifact_cache.hpp"
+#include "build_command.hpp"
+#include "build_monitor.hpp"
+#include "build_state.hpp"
+#include "build_telemetry.hpp"
 #include "compile_options.hpp"
 #include "config-options.hpp"
+#include "cpu_target.hpp"
+#include "module_profile.hpp"
+#include "pkgbuild_cache.hpp"
+#include "patch_prefetch.hpp"
+#include "patch_stack.hpp"
+#include "pkgbuild_eval.hpp"
+#include "resource-graph.hpp"
+#include "source_store.hpp"
 #include "utils.hpp"
 
 #include <cstdio>
 #include <cstdlib>
 
 #include <algorithm>    // for for_each, transform
-#include <filesystem>   // for permissions
+#include <array>        // for array
+#include <filesystem>   // for current_path
 #include <ranges>       // for ranges::*
 #include <string_view>  // for string_view
+#include <thread>       // for thread
 
 #if defined(__clang__)
 #pragma clang diagnostic push
@@ -46,7 +61,9 @@
 #include <QInputDialog>
 #include <QLineEdit>
 #include <QMessageBox>
+#include <QSpinBox>
 #include <QStringList>
+#include <QTreeWidget>
 
 #if defined(__clang__)
 #pragma clang diagnostic pop
@@ -106,6 +123,7 @@ GENERATE_CONST_LOOKUP_OPTION_VALUES(preempt_mode, "full", "voluntary", "server")
 GENERATE_CONST_LOOKUP_OPTION_VALUES(lto_mode, "none", "full", "thin")
 GENERATE_CONST_LOOKUP_OPTION_VALUES(hugepage_mode, "always", "madvise")
 GENERATE_CONST_LOOKUP_OPTION_VALUES(cpu_opt_mode, "manual", "generic", "native_amd", "native_intel", "zen", "zen2", "zen3", "sandybridge", "ivybridge", "haswell", "icelake", "tigerlake", "alderlake")
+GENERATE_CONST_LOOKUP_OPTION_VALUES(compiler_cache, "none", "ccache", "sccache")
 
 // NOLINTEND(cppcoreguidelines-macro-usage)
 
@@ -147,6 +165,10 @@ constexpr auto get_kernel_name_path(std::string_view kernel_name) noexcept {
     return "linux-cachyos"sv;
 }
 
+// NOTE: packages built from the window are installed locally, right after the build or from the queue,
+// so they aren't worth compressing hard.
+constexpr auto local_install_compression = build::PackageCompression::Fast;
+
 inline bool checkstate_checked(QCheckBox* checkbox) noexcept {
     return (checkbox->checkState() == Qt::Checked);
 }
@@ -163,159 +185,63 @@ inline auto set_combobox_val(QComboBox* combobox, ssize_t index) noexcept {
     return 0;
 }
 
-constexpr auto convert_to_varname(std::string_view option) noexcept {
-    // force constexpr call with lambda
-    return [option] { return detail::option_map.at(option); }();
-}
-
-inline auto convert_to_var_assign(std::string_view option, std::string_view value) noexcept {
-    return fmt::format(FMT_COMPILE("{}={}\n"), convert_to_varname(option), value);
-}
-
-/// return flag to enable if the option is enabled, otherwise do nothing
-constexpr auto convert_to_var_assign_empty_wrapped(std::string_view option_name, bool option_enabled) noexcept {
-    using namespace std::string_view_literals;
-    if (option_enabled) {
-        return convert_to_var_assign(option_name, "y"sv);
-    }
-    return std::string{};
-}
-
-auto get_source_array_from_pkgbuild(std::string_view kernel_name_path, std::string_view options_set) noexcept {
-    const auto& testscript_src  = fmt::format(FMT_COMPILE("#!/usr/bin/bash\n{}\nsource \"$1\"\n{}"), options_set, "echo \"${source[@]}\"");
-    const auto& testscript_path = fmt::format(FMT_COMPILE("{}/.testscript"), kernel_name_path);
-
-    if (utils::write_to_file(testscript_path, testscript_src)) {
-        fs::permissions(testscript_path,
-            fs::perms::owner_exec | fs::perms::group_exec | fs::perms::others_exec,
-            fs::perm_options::add);
-    }
-
-    const auto& src_entries = utils::exec(fmt::format(FMT_COMPILE("{} {}/PKGBUILD"), testscript_path, kernel_name_path));
-    return utils::make_multiline(src_entries, ' ');
-}
-
-auto get_pkgext_value_from_makepkgconf() noexcept -> std::string {
-    using namespace std::string_view_literals;
-    using namespace std::string_literals;
-    static constexpr auto testscript_src = "#!/usr/bin/bash\nsource \"/etc/makepkg.conf\"\necho \"${PKGEXT}\""sv;
-
-    const auto& testscript_path = fmt::format(FMT_COMPILE("{}/.testscriptpkgext"), fs::current_path().string());
-    if (utils::write_to_file(testscript_path, testscript_src)) {
-        fs::permissions(testscript_path,
-            fs::perms::owner_exec | fs::perms::group_exec | fs::perms::others_exec,
-            fs::perm_options::add);
-    }
+struct PatchStackReport {
+    std::string error{};
+    std::vector<build::PatchCheck> checks{};
+};
 
-    auto pkgext_val = utils::exec(testscript_path);
-    if (pkgext_val.empty()) {
-        fmt::print(stderr, "failed to get PKGEXT from /etc/makepkg.conf");
-        return ".pkg.tar.zst"s;
+auto check_patches(std::string_view kernel_name_path, std::string_view options_set, const std::vector<std::string>& patches, std::stop_token stop_token) noexcept -> PatchStackReport {
+    const auto& source_entries = build::get_source_entries(kernel_name_path, options_set);
+    const auto* kernel_tarball = build::find_kernel_tarball(source_entries);
+    if (kernel_tarball == nullptr) {
+        return {.error = "Kernel tarball isn't found in PKGBUILD"};
     }
-    return pkgext_val;
-}
 
-auto prepare_func_names(std::vector<std::string> parse_lines, std::string_view pkgver_str) noexcept -> std::vector<std::string> {
-    using namespace std::string_view_literals;
+    auto& source_store   = build::SourceStore::instance();
+    const auto& srcdest  = source_store.get_srcdest(kernel_name_path);
+    const auto& startdir = fmt::format(FMT_COMPILE("{}/{}"), fs::current_path().string(), kernel_name_path);
+    source_store.hand_out(srcdest, source_entries);
 
-    static constexpr auto functor = [](auto&& rng) {
-        auto rng_str = std::string_view(&*rng.begin(), static_cast<size_t>(std::ranges::distance(rng)));
-        return rng_str.starts_with("package_"sv);
-    };
+    const auto& patch_issues = build::prefetch_patches(srcdest, startdir, patches, stop_token);
+    const auto& pristine_dir = source_store.use_pristine_dir(*kernel_tarball);
+    const auto& tarball_path = fmt::format(FMT_COMPILE("{}/{}"), srcdest, build::get_source_name(kernel_tarball->source));
 
-    // fetch the pkgext from /etc/makepkg.conf, and fallback to '.pkg.tar.zst' which is default value of makepkg
-    const auto& pkgext_val = get_pkgext_value_from_makepkgconf();
-
-    std::vector<std::string> pkg_globs{};
-    pkg_globs = parse_lines
-        | std::ranges::views::transform([&](auto&& rng) {
-              auto&& line = std::string_view(&*rng.begin(), static_cast<size_t>(std::ranges::distance(rng)));
-
-              static constexpr auto needle_prefix = "declare -f "sv;
-              if (line.starts_with(needle_prefix)) {
-                  line.remove_prefix(needle_prefix.size());
-              }
-              return line;
-          })
-        | std::ranges::views::filter(functor)
-        | std::ranges::views::transform([&](auto&& rng) {
-              auto&& line = std::string_view(&*rng.begin(), static_cast<size_t>(std::ranges::distance(rng)));
-
-              static constexpr auto needle_prefix = "package_"sv;
-              if (line.starts_with(needle_prefix)) {
-                  line.remove_prefix(needle_prefix.size());
-              }
-              return fmt::format(FMT_COMPILE("{}-{}-*{}"), line, pkgver_str, pkgext_val);
-          })
-        | std::ranges::to<std::vector<std::string>>();
-    return pkg_globs;
-}
-
-auto get_package_names_glob_from_pkgbuild(std::string_view kernel_name_path) noexcept -> std::vector<std::string> {
-    using namespace std::string_view_literals;
-    static constexpr auto testscript_src = "#!/usr/bin/bash\nsource \"$1\"\ndeclare -F;echo \"pkgver: $pkgver-$pkgrel\""sv;
-    static constexpr auto pkgver_prefix  = "pkgver: "sv;
-
-    const auto& testscript_path = fmt::format(FMT_COMPILE("{}/.testscriptpkgnames"), kernel_name_path);
-    if (utils::write_to_file(testscript_path, testscript_src)) {
-        fs::permissions(testscript_path,
-            fs::perms::owner_exec | fs::perms::group_exec | fs::perms::others_exec,
-            fs::perm_options::add);
+    // NOTE: the pristine tree is extracted here, if no build has used it yet.
+    std::error_code err_code{};
+    if (!fs::exists(pristine_dir, err_code)) {
+        if (!fs::exists(tarball_path, err_code)) {
+            return {.error = "Kernel sources aren't downloaded yet, build the kernel once"};
+        }
+        if (std::system(build::SourceStore::make_pristine_extract_cmd(pristine_dir, utils::shell_quote(tarball_path)).c_str()) != 0) {
+            return {.error = "Failed to extract kernel sources"};
+        }
     }
-
-    const auto& src_entries = utils::exec(fmt::format(FMT_COMPILE("{} {}/PKGBUILD"), testscript_path, kernel_name_path));
-    const auto& parse_lines = utils::make_multiline(src_entries, '\n');
-
-    auto it = std::ranges::find_if(parse_lines, [](auto&& line) { return line.starts_with(pkgver_prefix); });
-    if (it == std::ranges::end(parse_lines)) {
-        fmt::print(stderr, "broken pkgbuild; pkgver must be present\n");
-        return {};
+    std::string tree_dir{};
+    for (auto&& dir_entry : fs::directory_iterator{pristine_dir, err_code}) {
+        if (dir_entry.is_directory(err_code)) {
+            tree_dir = dir_entry.path().string();
+            break;
+        }
     }
-    auto pkgver_str = std::string_view{*it};
-    pkgver_str.remove_prefix(pkgver_prefix.size());
-
-    return prepare_func_names(parse_lines, pkgver_str);
-}
 
-bool insert_new_source_array_into_pkgbuild(std::string_view kernel_name_path, QListWidget* list_widget, const std::vector<std::string>& orig_source_array) noexcept {
-    static constexpr auto functor = [](auto&& rng) {
-        auto rng_str = std::string_view(&*rng.begin(), static_cast<size_t>(std::ranges::distance(rng)));
-        return !rng_str.ends_with(".patch");
-    };
-
-    auto array_entries = orig_source_array
-        | std::ranges::views::filter(functor)
-        | std::ranges::views::transform([](auto&& rng) { return fmt::format(FMT_COMPILE("\"{}\""), rng); })
-        | std::ranges::to<std::vector<std::string>>();
-
-    // Apply flag to each item in list widget
-    for (int i = 0; i < list_widget->count(); ++i) {
-        auto* item = list_widget->item(i);
-        array_entries.emplace_back(fmt::format(FMT_COMPILE("\"{}\""), item->text().toStdString()));
+    std::vector<std::string> patch_paths{};
+    for (auto&& patch : patches) {
+        patch_paths.emplace_back(build::get_fetched_patch_path(srcdest, startdir, patch));
     }
-    const auto& pkgbuild_path = fmt::format(FMT_COMPILE("{}/PKGBUILD"), kernel_name_path);
-    auto pkgbuildsrc          = utils::read_whole_file(pkgbuild_path);
-
-    const auto& new_source_array = fmt::format(FMT_COMPILE("source=(\n{})\n"), array_entries | std::ranges::views::join_with('\n') | std::ranges::to<std::string>());
-    if (auto foundpos = pkgbuildsrc.find("prepare()"); foundpos != std::string::npos) {
-        if (auto last_newline_before = pkgbuildsrc.find_last_of('\n', foundpos); last_newline_before != std::string::npos) {
-            pkgbuildsrc.insert(last_newline_before, new_source_array);
+    PatchStackReport report{.checks = build::check_patch_stack(tree_dir, patch_paths, stop_token)};
+    for (auto&& patch_issue : patch_issues) {
+        for (std::size_t i = 0; i < patches.size(); ++i) {
+            if (patches[i] == patch_issue.patch) {
+                report.checks[i] = build::PatchCheck{.status = build::PatchStatus::Failed, .details = patch_issue.reason};
+            }
         }
     }
-    return utils::write_to_file(pkgbuild_path, pkgbuildsrc);
+    return report;
 }
 
-bool set_custom_name_in_pkgbuild(std::string_view kernel_name_path, std::string_view custom_name) noexcept {
-    const auto& pkgbuild_path = fmt::format(FMT_COMPILE("{}/PKGBUILD"), kernel_name_path);
-    auto pkgbuildsrc          = utils::read_whole_file(pkgbuild_path);
-
-    const auto& custom_name_var = fmt::format(FMT_COMPILE("\n\npkgbase=\"{}\""), custom_name);
-    if (auto foundpos = pkgbuildsrc.find("_major="); foundpos != std::string::npos) {
-        if (auto last_newline_before = pkgbuildsrc.find_last_of('\n', foundpos); last_newline_before != std::string::npos) {
-            pkgbuildsrc.insert(last_newline_before, custom_name_var);
-        }
-    }
-    return utils::write_to_file(pkgbuild_path, pkgbuildsrc);
+auto format_duration(double secs) noexcept -> QString {
+    const auto total_secs = static_cast<std::int64_t>(secs);
+    return QString::fromStdString(fmt::format(FMT_COMPILE("{}:{:02}:{:02}"), total_secs / 3600, (total_secs / 60) % 60, total_secs % 60));
 }
 
 auto convert_vector_of_strings_to_stringlist(const std::vector<std::string>& vec) noexcept {
@@ -327,6 +253,9 @@ auto convert_vector_of_strings_to_stringlist(const std::vector<std::string>& vec
     return result;
 }
 
+// Original text of the patch, which was taken from PKGBUILD.
+constexpr auto pkgbuild_patch_role = Qt::UserRole + 1;
+
 inline void list_widget_apply_edit_flag(QListWidget* list_widget) noexcept {
     // Apply flag to each item in list widget
     for (int i = 0; i < list_widget->count(); ++i) {
@@ -340,7 +269,10 @@ inline void list_widget_apply_edit_flag(QListWidget* list_widget) noexcept {
 // NOTE: we use std::string const ref intentionally to prevent conversion from string_view into QString
 void ConfWindow::run_cmd_async(std::string cmd, const std::string& working_path) noexcept {
     using namespace std::string_literals;
-    cmd += "; read -p 'Press enter to exit'"s;
+    // NOTE: the queued builds continue one after another, without waiting for the user.
+    if (!m_queue_entry_id) {
+        cmd += "; read -p 'Press enter to exit'"s;
+    }
 
     // remember current build working directory
     m_build_conf_path = working_path;
@@ -359,9 +291,28 @@ void ConfWindow::finished_proc(int exit_code, QProcess::ExitStatus) noexcept {
     using namespace std::string_view_literals;
 
     m_running = false;
+    m_building_variant.clear();
+
+    // the build ended without the status in its log, e.g. the terminal was closed
+    if (m_build_tracker) {
+        m_build_tracker->poll();
+        m_build_tracker->finish(false);
+        finish_build_tracking();
+    }
+
+    // the queue continues with the next entry, once nothing is running
+    QTimer::singleShot(0, this, &ConfWindow::run_next_queue_entry);
 
     // handle exit case
     const auto& check_tmp_path = fmt::format(FMT_COMPILE("{}/.done-status"), m_build_conf_path);
+    if (m_queue_entry_id) {
+        const bool is_succeeded = fs::exists(check_tmp_path);
+        fs::remove(check_tmp_path);
+        build::BuildQueue::instance().set_state(*m_queue_entry_id, is_succeeded ? build::QueueState::Done : build::QueueState::Failed);
+        m_queue_entry_id.reset();
+        refresh_queue_tree();
+        return;
+    }
     if (fs::exists(check_tmp_path)) {
         fs::remove(check_tmp_path);
 
@@ -371,7 +322,7 @@ void ConfWindow::finished_proc(int exit_code, QProcess::ExitStatus) noexcept {
         if (res == QMessageBox::Yes) {
             fmt::print("pressed yes\n");
 
-            auto pkg_glob_list = get_package_names_glob_from_pkgbuild(m_build_conf_path);
+            auto pkg_glob_list = build::get_package_globs(m_build_conf_path, local_install_compression);
             auto pkg_globs     = pkg_glob_list | std::ranges::views::join_with(' ') | std::ranges::to<std::string>();
             auto pacman_cmd    = fmt::format(FMT_COMPILE("sudo pacman -U {}"), pkg_globs);
 
@@ -394,55 +345,71 @@ void ConfWindow::connect_all_checkboxes() noexcept {
 
     for (auto* checkbox : checkbox_list) {
         connect(checkbox, &QCheckBox::checkStateChanged, this, [this](Qt::CheckState) {
-            reset_patches_data_tab();
+            m_patches_timer.start();
         });
     }
 }
 
 std::string ConfWindow::get_all_set_values() const noexcept {
-    std::string result{};
+    return build::get_option_values(get_config_options());
+}
+
+auto ConfWindow::get_config_options() const noexcept -> ConfigOptions {
     auto* options_page_ui_obj = m_ui->conf_options_page_widget->get_ui_obj();
 
-    // checkboxes values,
-    // which becomes enabled with any value passed,
-    // and if nothing passed means it's disabled.
-    result += convert_to_var_assign_empty_wrapped("hardly", checkstate_checked(options_page_ui_obj->hardly_check));
-    result += convert_to_var_assign_empty_wrapped("per_gov", checkstate_checked(options_page_ui_obj->perfgovern_check));
-    result += convert_to_var_assign_empty_wrapped("tcp_bbr3", checkstate_checked(options_page_ui_obj->tcpbbr_check));
-    result += convert_to_var_assign_empty_wrapped("auto_optim", checkstate_checked(options_page_ui_obj->autooptim_check));
-
-    result += convert_to_var_assign_empty_wrapped("cachy_config", checkstate_checked(options_page_ui_obj->cachyconfig_check));
-    result += convert_to_var_assign_empty_wrapped("nconfig", checkstate_checked(options_page_ui_obj->nconfig_check));
-    result += convert_to_var_assign_empty_wrapped("menuconfig", checkstate_checked(options_page_ui_obj->menuconfig_check));
-    result += convert_to_var_assign_empty_wrapped("xconfig", checkstate_checked(options_page_ui_obj->xconfig_check));
-    result += convert_to_var_assign_empty_wrapped("gconfig", checkstate_checked(options_page_ui_obj->gconfig_check));
-    result += convert_to_var_assign_empty_wrapped("localmodcfg", checkstate_checked(options_page_ui_obj->localmodcfg_check));
-    result += convert_to_var_assign_empty_wrapped("numa", checkstate_checked(options_page_ui_obj->numa_check));
-    result += convert_to_var_assign_empty_wrapped("damon", checkstate_checked(options_page_ui_obj->damon_check));
-    result += convert_to_var_assign_empty_wrapped("builtin_zfs", checkstate_checked(options_page_ui_obj->builtin_zfs_check));
-    result += convert_to_var_assign_empty_wrapped("builtin_nvidia", checkstate_checked(options_page_ui_obj->builtin_nvidia_check));
-    result += convert_to_var_assign_empty_wrapped("builtin_nvidia_open", checkstate_checked(options_page_ui_obj->builtin_nvidia_open_check));
-    result += convert_to_var_assign_empty_wrapped("build_debug", checkstate_checked(options_page_ui_obj->build_debug_check));
-
-    // combobox values
-    result += convert_to_var_assign("HZ_ticks", get_hz_tick(static_cast<size_t>(options_page_ui_obj->hzticks_combo_box->currentIndex())));
-    result += convert_to_var_assign("tickrate", get_tickless_mode(static_cast<size_t>(options_page_ui_obj->tickless_combo_box->currentIndex())));
-    result += convert_to_var_assign("preempt", get_preempt_mode(static_cast<size_t>(options_page_ui_obj->preempt_combo_box->currentIndex())));
-    result += convert_to_var_assign("hugepage", get_hugepage_mode(static_cast<size_t>(options_page_ui_obj->hugepage_combo_box->currentIndex())));
-    result += convert_to_var_assign("lto", get_lto_mode(static_cast<size_t>(options_page_ui_obj->lto_combo_box->currentIndex())));
-
-    const std::string_view cpu_opt_mode = get_cpu_opt_mode(static_cast<size_t>(options_page_ui_obj->processor_opt_combo_box->currentIndex()));
-    if (cpu_opt_mode != "manual") {
-        result += convert_to_var_assign("cpu_opt", cpu_opt_mode);
-    }
-
-    // NOTE: workaround PKGBUILD incorrectly working with custom pkgname
-    const std::string_view lto_mode = get_lto_mode(static_cast<size_t>(options_page_ui_obj->lto_combo_box->currentIndex()));
-    if (lto_mode != "none" && options_page_ui_obj->custom_name_edit->text() != "$pkgbase") {
-        result += "_use_lto_suffix=n\n";
-    }
+    ConfigOptions config_options{};
 
-    return result;
+    // checkboxes values (booleans)
+    config_options.hardly_check     = checkstate_checked(options_page_ui_obj->hardly_check);
+    config_options.per_gov_check    = checkstate_checked(options_page_ui_obj->perfgovern_check);
+    config_options.tcp_bbr3_check   = checkstate_checked(options_page_ui_obj->tcpbbr_check);
+    config_options.auto_optim_check = checkstate_checked(options_page_ui_obj->autooptim_check);
+
+    config_options.cachy_config_check        = checkstate_checked(options_page_ui_obj->cachyconfig_check);
+    config_options.nconfig_check             = checkstate_checked(options_page_ui_obj->nconfig_check);
+    config_options.menuconfig_check          = checkstate_checked(options_page_ui_obj->menuconfig_check);
+    config_options.xconfig_check             = checkstate_checked(options_page_ui_obj->xconfig_check);
+    config_options.gconfig_check             = checkstate_checked(options_page_ui_obj->gconfig_check);
+    config_options.localmodcfg_check         = checkstate_checked(options_page_ui_obj->localmodcfg_check);
+    config_options.numa_check                = checkstate_checked(options_page_ui_obj->numa_check);
+    config_options.damon_check               = checkstate_checked(options_page_ui_obj->damon_check);
+    config_options.builtin_zfs_check         = checkstate_checked(options_page_ui_obj->builtin_zfs_check);
+    config_options.builtin_nvidia_check      = checkstate_checked(options_page_ui_obj->builtin_nvidia_check);
+    config_options.builtin_nvidia_open_check = checkstate_checked(options_page_ui_obj->builtin_nvidia_open_check);
+    config_options.build_debug_check         = checkstate_checked(options_page_ui_obj->build_debug_check);
+
+    // combobox values (strings that we try to find on load)
+    config_options.hz_ticks_combo = get_hz_tick(static_cast<size_t>(options_page_ui_obj->hzticks_combo_box->currentIndex()));
+    config_options.tickrate_combo = get_tickless_mode(static_cast<size_t>(options_page_ui_obj->tickless_combo_box->currentIndex()));
+    config_options.preempt_combo  = get_preempt_mode(static_cast<size_t>(options_page_ui_obj->preempt_combo_box->currentIndex()));
+    config_options.hugepage_combo = get_hugepage_mode(static_cast<size_t>(options_page_ui_obj->hugepage_combo_box->currentIndex()));
+    config_options.lto_combo      = get_lto_mode(static_cast<size_t>(options_page_ui_obj->lto_combo_box->currentIndex()));
+    config_options.cpu_opt_combo  = get_cpu_opt_mode(static_cast<size_t>(options_page_ui_obj->processor_opt_combo_box->currentIndex()));
+
+    config_options.custom_name_edit = options_page_ui_obj->custom_name_edit->text().toStdString();
+
+    config_options.compiler_cache_combo    = get_compiler_cache(static_cast<size_t>(options_page_ui_obj->compiler_cache_combo_box->currentIndex()));
+    config_options.compiler_cache_size     = options_page_ui_obj->compiler_cache_size_spin_box->value();
+    config_options.tmpfs_build_check       = checkstate_checked(options_page_ui_obj->tmpfs_build_check);
+    config_options.incremental_build_check = checkstate_checked(options_page_ui_obj->incremental_build_check);
+
+    return config_options;
+}
+
+auto ConfWindow::get_build_job() const noexcept -> build::BuildJob {
+    auto* options_page_ui_obj = m_ui->conf_options_page_widget->get_ui_obj();
+    auto* patches_page_ui_obj = m_ui->conf_patches_page_widget->get_ui_obj();
+
+    const std::int32_t main_combo_index = options_page_ui_obj->main_combo_box->currentIndex();
+    build::BuildJob job{
+        .variant = std::string{get_kernel_name_path(get_kernel_name(static_cast<size_t>(main_combo_index)))},
+        .options     = get_config_options(),
+        .compression = local_install_compression,
+    };
+    for (int i = 0; i < patches_page_ui_obj->list_widget->count(); ++i) {
+        job.patches.emplace_back(patches_page_ui_obj->list_widget->item(i)->text().toStdString());
+    }
+    return job;
 }
 
 void ConfWindow::clear_patches_data_tab() noexcept {
@@ -452,23 +419,61 @@ void ConfWindow::clear_patches_data_tab() noexcept {
 
 void ConfWindow::reset_patches_data_tab() noexcept {
     auto* options_page_ui_obj = m_ui->conf_options_page_widget->get_ui_obj();
-    auto* patches_page_ui_obj = m_ui->conf_patches_page_widget->get_ui_obj();
 
     const std::int32_t main_combo_index  = options_page_ui_obj->main_combo_box->currentIndex();
     const std::string_view cpusched_path = get_kernel_name_path(get_kernel_name(static_cast<size_t>(main_combo_index)));
 
-    auto current_array_items = get_source_array_from_pkgbuild(cpusched_path, get_all_set_values());
-    std::erase_if(current_array_items, [](auto&& item_el) { return !item_el.ends_with(".patch"); });
+    // NOTE: results of the older requests are dropped, only the newest one is applied.
+    const auto generation = ++m_patches_generation;
+    m_executor.run(
+        TaskExecutor::Lane::Pool, this,
+        [cpusched_path, all_set_values = get_all_set_values()](std::stop_token) {
+            auto current_array_items = build::get_source_array_cached(cpusched_path, all_set_values);
+            std::erase_if(current_array_items, [](auto&& item_el) { return !item_el.ends_with(".patch"); });
+            return current_array_items;
+        },
+        [this, generation](std::vector<std::string>&& patches) {
+            /* clang-format off */
+            if (generation != m_patches_generation) { return; }
+            /* clang-format on */
+            apply_patches_data_tab(patches);
+        });
+}
 
-    clear_patches_data_tab();
-    patches_page_ui_obj->list_widget->addItems(convert_vector_of_strings_to_stringlist(current_array_items));
+void ConfWindow::apply_patches_data_tab(const std::vector<std::string>& patches) noexcept {
+    auto* list_widget = m_ui->conf_patches_page_widget->get_ui_obj()->list_widget;
+
+    // Drop patches from the previous evaluation, which weren't edited by the user.
+    // Patches added or edited by the user are kept, together with the originals they replace.
+    QStringList replaced_patches{};
+    for (int i = list_widget->count() - 1; i >= 0; --i) {
+        auto* item                = list_widget->item(i);
+        const auto& original_text = item->data(pkgbuild_patch_role).toString();
+        if (original_text == item->text()) {
+            delete list_widget->takeItem(i);
+        } else if (!original_text.isEmpty()) {
+            replaced_patches << original_text;
+        }
+    }
+
+    std::int32_t insert_row{};
+    for (auto&& patch : patches) {
+        const auto& patch_text = QString::fromStdString(patch);
+        /* clang-format off */
+        if (replaced_patches.contains(patch_text) || !list_widget->findItems(patch_text, Qt::MatchExactly).isEmpty()) { continue; }
+        /* clang-format on */
+
+        auto* item = new QListWidgetItem(patch_text);
+        item->setData(pkgbuild_patch_role, patch_text);
+        list_widget->insertItem(insert_row++, item);
+    }
 
     // Apply flag to each item in list widget
-    list_widget_apply_edit_flag(patches_page_ui_obj->list_widget);
+    list_widget_apply_edit_flag(list_widget);
 }
 
-ConfWindow::ConfWindow(QWidget* parent)
-  : QMainWindow(parent) {
+ConfWindow::ConfWindow(TaskExecutor& executor, QWidget* parent)
+  : QMainWindow(parent), m_executor(executor) {
     m_ui->setupUi(this);
 
     setAttribute(Qt::WA_NativeWindow);
@@ -492,6 +497,7 @@ ConfWindow::ConfWindow(QWidget* parent)
     options_page_ui_obj->cachyconfig_check->setCheckState(Qt::Checked);
     options_page_ui_obj->hardly_check->setCheckState(Qt::Checked);
     options_page_ui_obj->tcpbbr_check->setCheckState(Qt::Checked);
+    options_page_ui_obj->tmpfs_build_check->setCheckState(Qt::Checked);
 
     QStringList hz_ticks;
     hz_ticks << "1000HZ"
@@ -527,6 +533,27 @@ ConfWindow::ConfWindow(QWidget* parent)
     options_page_ui_obj->processor_opt_combo_box->addItems(cpu_optims);
     /* clang-format on */
 
+    // The processor optimization is preselected for the host CPU.
+    const auto& cpu_target = build::detect_cpu_target();
+    if (!cpu_target.cpu_opt.empty()) {
+        set_combobox_val(options_page_ui_obj->processor_opt_combo_box, lookup_cpu_opt_mode(cpu_target.cpu_opt));
+        options_page_ui_obj->processor_opt_detected_label->setText(QString::fromStdString(cpu_target.reason));
+        options_page_ui_obj->processor_opt_combo_box->setToolTip(tr("Detected for this CPU: %1").arg(QString::fromStdString(cpu_target.reason)));
+    }
+
+    // Report of the collected modules, which localmodconfig keeps.
+    m_executor.run(
+        TaskExecutor::Lane::Pool, this,
+        [](std::stop_token) {
+            const auto& profile = build::load_module_profile(build::get_module_profile_path());
+            return build::make_module_report(profile, build::estimate_module_reduction(profile, build::get_running_modules_dir()));
+        },
+        [options_page_ui_obj](std::string&& report) {
+            const auto& tooltip = ConfWindow::tr("Only the modules, which were loaded on this machine, are built.\n%1").arg(QString::fromStdString(report));
+            options_page_ui_obj->localmodcfg_label->setToolTip(tooltip);
+            options_page_ui_obj->localmodcfg_check->setToolTip(tooltip);
+        });
+
     options_page_ui_obj->autooptim_check->setCheckState(Qt::Checked);
 
     QStringList lto_modes;
@@ -540,20 +567,44 @@ ConfWindow::ConfWindow(QWidget* parent)
                    << "Madivse";
     options_page_ui_obj->hugepage_combo_box->addItems(hugepage_modes);
 
+    QStringList compiler_caches;
+    compiler_caches << "Disabled"
+                    << "ccache"
+                    << "sccache";
+    options_page_ui_obj->compiler_cache_combo_box->addItems(compiler_caches);
+
     // Connect buttons signal
     connect(options_page_ui_obj->cancel_button, &QPushButton::clicked, this, &ConfWindow::on_cancel);
     connect(options_page_ui_obj->ok_button, &QPushButton::clicked, this, &ConfWindow::on_execute);
     connect(options_page_ui_obj->save_button, &QPushButton::clicked, this, &ConfWindow::on_save);
     connect(options_page_ui_obj->load_button, &QPushButton::clicked, this, &ConfWindow::on_load);
+    connect(options_page_ui_obj->queue_button, &QPushButton::clicked, this, &ConfWindow::on_queue_add);
     connect(options_page_ui_obj->main_combo_box, &QComboBox::currentIndexChanged, this, [this](std::int32_t) {
-        reset_patches_data_tab();
+        m_patches_timer.start();
     });
 
     // Setup patches page
-    // TODO(vnepogodin): make it lazy loading, only if the user launched the configure window.
-    // on window opening setup the page(clone git repo & reset values) run in the background -> show progress bar.
-    // prepare_build_environment();
-    // reset_patches_data_tab();
+    // NOTE: quick toggles are coalesced into the single recomputation.
+    m_patches_timer.setSingleShot(true);
+    m_patches_timer.setInterval(250);
+    connect(&m_patches_timer, &QTimer::timeout, this, &ConfWindow::reset_patches_data_tab);
+    m_build_timer.setInterval(1000);
+    connect(&m_build_timer, &QTimer::timeout, this, &ConfWindow::update_build_status);
+    refresh_build_history();
+
+    // Setup queue page
+    connect(m_ui->queue_start_button, &QPushButton::clicked, this, &ConfWindow::on_queue_start);
+    connect(m_ui->queue_remove_button, &QPushButton::clicked, this, &ConfWindow::on_queue_remove);
+    connect(m_ui->queue_install_button, &QPushButton::clicked, this, &ConfWindow::on_queue_install);
+    refresh_queue_tree();
+
+    // Resources of the running build are sampled at the configured interval.
+    m_monitor_timer.setInterval(m_ui->monitor_interval_spin_box->value());
+    connect(&m_monitor_timer, &QTimer::timeout, this, &ConfWindow::sample_resources);
+    connect(m_ui->monitor_interval_spin_box, &QSpinBox::valueChanged, this, [this](int interval_ms) { m_monitor_timer.setInterval(interval_ms); });
+    for (auto* resource_graph : {m_ui->cpu_graph, m_ui->memory_graph, m_ui->io_graph, m_ui->pressure_graph}) {
+        resource_graph->set_capacity(build::ResourceSampler::history_capacity);
+    }
     connect_all_checkboxes();
 
     // local patches
@@ -599,6 +650,9 @@ ConfWindow::ConfWindow(QWidget* parent)
     patches_page_ui_obj->move_up_button->setIcon(QApplication::style()->standardIcon(QStyle::SP_ArrowUp));
     patches_page_ui_obj->move_down_button->setIcon(QApplication::style()->standardIcon(QStyle::SP_ArrowDown));
 
+    // dry-run of the patch stack
+    connect(patches_page_ui_obj->check_patches_button, &QPushButton::clicked, this, &ConfWindow::on_check_patches);
+
     // remove entry
     connect(patches_page_ui_obj->remove_entry_button, &QPushButton::clicked, this, [patches_page_ui_obj]() {
         const auto& current_index = patches_page_ui_obj->list_widget->currentRow();
@@ -629,80 +683,449 @@ void ConfWindow::on_cancel() noexcept {
     close();
 }
 
+void ConfWindow::on_check_patches() noexcept {
+    auto* options_page_ui_obj = m_ui->conf_options_page_widget->get_ui_obj();
+    auto* patches_page_ui_obj = m_ui->conf_patches_page_widget->get_ui_obj();
+
+    const std::int32_t main_combo_index  = options_page_ui_obj->main_combo_box->currentIndex();
+    const std::string_view cpusched_path = get_kernel_name_path(get_kernel_name(static_cast<size_t>(main_combo_index)));
+
+    std::vector<std::string> patches{};
+    for (int i = 0; i < patches_page_ui_obj->list_widget->count(); ++i) {
+        patches.emplace_back(patches_page_ui_obj->list_widget->item(i)->text().toStdString());
+    }
+    /* clang-format off */
+    if (patches.empty()) { return; }
+    /* clang-format on */
+
+    // NOTE: the check hands out the sources into SRCDEST, which the build of the variant is using.
+    if (cpusched_path == m_building_variant || (m_queue_preparing && cpusched_path == m_preparing_variant)) {
+        QMessageBox::information(this, "CachyOS Kernel Manager", tr("Patches can't be checked, while %1 is building").arg(QString::fromStdString(std::string{cpusched_path})));
+        return;
+    }
+
+    patches_page_ui_obj->check_patches_button->setEnabled(false);
+    m_checking_variant = cpusched_path;
+    m_executor.run(
+        TaskExecutor::Lane::Pool, this,
+        [cpusched_path, all_set_values = get_all_set_values(), patches](std::stop_token stop_token) {
+            return check_patches(cpusched_path, all_set_values, patches, stop_token);
+        },
+        [this, patches_page_ui_obj, patches](PatchStackReport&& report) {
+            patches_page_ui_obj->check_patches_button->setEnabled(true);
+            m_checking_variant.clear();
+            // the queue entry of the variant was waiting for the check
+            run_next_queue_entry();
+            if (!report.error.empty()) {
+                QMessageBox::critical(this, "CachyOS Kernel Manager", tr("Failed to check patches!\n%1").arg(QString::fromStdString(report.error)));
+                return;
+            }
+            apply_patch_checks(patches, report.checks);
+        });
+}
+
+void ConfWindow::apply_patch_checks(const std::vector<std::string>& patches, const std::vector<build::PatchCheck>& checks) noexcept {
+    auto* list_widget = m_ui->conf_patches_page_widget->get_ui_obj()->list_widget;
+
+    for (int i = 0; i < list_widget->count(); ++i) {
+        auto* item       = list_widget->item(i);
+        const auto index = static_cast<std::size_t>(i);
+        // the list was edited during the check
+        /* clang-format off */
+        if (index >= patches.size() || item->text().toStdString() != patches[index]) { continue; }
+        /* clang-format on */
+
+        const auto& check = checks[index];
+        QString status_text{};
+        auto status_icon = QStyle::SP_MessageBoxCritical;
+        switch (check.status) {
+        case build::PatchStatus::Applies:
+            status_text = tr("Applies cleanly");
+            status_icon = QStyle::SP_DialogApplyButton;
+            break;
+        case build::PatchStatus::Fuzz:
+            status_text = tr("Applies with fuzz");
+            status_icon = QStyle::SP_MessageBoxWarning;
+            break;
+        case build::PatchStatus::Conflicts:
+            status_text = tr("Conflicts with patch %1").arg(check.conflicts_with + 1);
+            break;
+        case build::PatchStatus::Failed:
+            status_text = tr("Doesn't apply");
+            break;
+        }
+        item->setIcon(QApplication::style()->standardIcon(status_icon));
+        item->setToolTip(status_text + '\n' + QString::fromStdString(check.details).trimmed());
+    }
+}
+
 void ConfWindow::on_execute() noexcept {
     // Skip execution of the build, if already one is running
     /* clang-format off */
     if (m_running) { return; }
     /* clang-format on */
-    m_running = true;
 
-    auto* options_page_ui_obj = m_ui->conf_options_page_widget->get_ui_obj();
-    auto* patches_page_ui_obj = m_ui->conf_patches_page_widget->get_ui_obj();
-
-    const std::int32_t main_combo_index  = options_page_ui_obj->main_combo_box->currentIndex();
-    const std::string_view cpusched_path = get_kernel_name_path(get_kernel_name(static_cast<size_t>(main_combo_index)));
+    auto job = get_build_job();
+    // NOTE: the build cleans the variant and hands out into its SRCDEST, which the patch check is using.
+    if (job.variant == m_checking_variant) {
+        QMessageBox::information(this, "CachyOS Kernel Manager", tr("%1 can't be built, while its patches are checked").arg(QString::fromStdString(job.variant)));
+        return;
+    }
+    m_running = true;
     utils::prepare_build_environment();
+    run_build_job(std::move(job));
+}
 
-    // Restore clean environment.
-    const auto& all_set_values = get_all_set_values();
-    utils::restore_clean_environment(m_previously_set_options, all_set_values);
+void ConfWindow::run_build_job(build::BuildJob job) noexcept {
+    auto option_values = build::get_option_values(job.options);
+    m_building_variant = job.variant;
+
+    // NOTE: the patches are fetched and validated before PKGBUILD is touched,
+    // so the broken ones are rejected before the build starts.
+    m_executor.run(
+        TaskExecutor::Lane::Pool, this,
+        [job, option_values](std::stop_token stop_token) {
+            return build::prepare_sources(job, option_values, stop_token);
+        },
+        [this, job, option_values](build::PreparedSources&& prepared) {
+            start_build(job, option_values, std::move(prepared));
+        });
+}
 
-    // Only files which end with .patch,
-    // are considered as patches.
-    const auto& orig_src_array = get_source_array_from_pkgbuild(cpusched_path, all_set_values);
-    auto insert_status         = insert_new_source_array_into_pkgbuild(cpusched_path, patches_page_ui_obj->list_widget, orig_src_array);
-    if (!insert_status) {
-        m_running = false;
-        fmt::print(stderr, "Failed to insert new source array into pkgbuild\n");
+void ConfWindow::start_build(const build::BuildJob& job, std::string_view option_values, build::PreparedSources&& prepared) noexcept {
+    if (!prepared.patch_issues.empty()) {
+        std::string issues_text{};
+        for (auto&& patch_issue : prepared.patch_issues) {
+            issues_text += fmt::format(FMT_COMPILE("{}: {}\n"), patch_issue.patch, patch_issue.reason);
+        }
+        fail_build(tr("Failed to fetch patches!\n%1").arg(QString::fromStdString(issues_text)));
         return;
     }
-    const auto& custom_name = options_page_ui_obj->custom_name_edit->text().toUtf8();
-    insert_status           = set_custom_name_in_pkgbuild(cpusched_path, std::string_view{custom_name.constData(), static_cast<size_t>(custom_name.size())});
-    if (!insert_status) {
+
+    // The same build has finished before, its packages are taken from the cache.
+    const auto& artifact_cache = build::ArtifactCache::instance();
+    const auto& cached_dir     = prepared.fingerprint ? artifact_cache.find(*prepared.fingerprint) : std::nullopt;
+    if (cached_dir && !m_queue_entry_id) {
+        const auto answer = QMessageBox::question(this, "CachyOS Kernel Manager", tr("Packages of the same build are in the cache.\nDo you want to install them instead of building again?"));
+        if (answer == QMessageBox::Yes) {
+            run_cmd_async("sudo pacman -U ./*", *cached_dir);
+            return;
+        }
+    } else if (cached_dir && artifact_cache.hand_out(*prepared.fingerprint, build::BuildQueue::instance().get_packages_dir(*m_queue_entry_id))) {
         m_running = false;
-        fmt::print(stderr, "Failed to set custom name in pkgbuild\n");
+        m_building_variant.clear();
+        build::BuildQueue::instance().set_state(*m_queue_entry_id, build::QueueState::Done);
+        m_queue_entry_id.reset();
+        refresh_queue_tree();
+        QTimer::singleShot(0, this, &ConfWindow::run_next_queue_entry);
         return;
     }
-    const auto& saved_working_path = fs::current_path().string();
-    const auto& build_working_path = fmt::format(FMT_COMPILE("{}/{}"), saved_working_path, cpusched_path);
+
+    auto planned_build = build::plan_build(job, option_values, std::move(prepared));
+    if (!planned_build.error.empty()) {
+        fail_build(tr("Failed to start the build!\n%1").arg(QString::fromStdString(planned_build.error)));
+        return;
+    }
+
+    // Packages of the queued build are kept with its entry, so the next builds don't overwrite them.
+    if (m_queue_entry_id) {
+        const auto& packages_dir = build::BuildQueue::instance().get_packages_dir(*m_queue_entry_id);
+        planned_build.command += '\n';
+        planned_build.command += build::make_collect_packages_cmd(job, packages_dir);
+    }
+
+    // Phases of the build are measured from its log, and stored into the history.
+    m_build_tracker  = std::make_unique<build::BuildTracker>(job.variant, option_values, planned_build.log_file, planned_build.cgroup_file);
+    m_build_estimate = build::BuildHistory::instance().estimate(job.variant, m_build_tracker->get_record().options_key);
+    m_build_timer.start();
+    m_executor.cancel(m_sample_job);
+    m_resource_sampler.reset();
+    m_monitor_timer.start();
 
     // Run our build command!
-    run_cmd_async("makepkg -scf --cleanbuild --skipchecksums && touch .done-status", build_working_path);
+    run_cmd_async(std::move(planned_build.command), planned_build.working_path);
+
+    if (m_queue_entry_id && checkstate_checked(m_ui->queue_overlap_check)) {
+        prepare_next_queue_entry(job.variant);
+    }
 }
 
-void ConfWindow::on_save() noexcept {
-    auto* options_page_ui_obj = m_ui->conf_options_page_widget->get_ui_obj();
+void ConfWindow::fail_build(const QString& reason) noexcept {
+    m_running = false;
+    m_building_variant.clear();
+    if (!m_queue_entry_id) {
+        QMessageBox::critical(this, "CachyOS Kernel Manager", reason);
+        return;
+    }
 
-    ConfigOptions config_options{};
+    // the queue goes on, the reason is shown with the entry
+    build::BuildQueue::instance().set_state(*m_queue_entry_id, build::QueueState::Failed, reason.toStdString());
+    m_queue_entry_id.reset();
+    refresh_queue_tree();
+    QTimer::singleShot(0, this, &ConfWindow::run_next_queue_entry);
+}
 
-    // checkboxes values (booleans)
-    config_options.hardly_check     = checkstate_checked(options_page_ui_obj->hardly_check);
-    config_options.per_gov_check    = checkstate_checked(options_page_ui_obj->perfgovern_check);
-    config_options.tcp_bbr3_check   = checkstate_checked(options_page_ui_obj->tcpbbr_check);
-    config_options.auto_optim_check = checkstate_checked(options_page_ui_obj->autooptim_check);
+void ConfWindow::on_queue_add() noexcept {
+    build::BuildQueue::instance().enqueue(get_build_job());
+    refresh_queue_tree();
+}
 
-    config_options.cachy_config_check        = checkstate_checked(options_page_ui_obj->cachyconfig_check);
-    config_options.nconfig_check             = checkstate_checked(options_page_ui_obj->nconfig_check);
-    config_options.menuconfig_check          = checkstate_checked(options_page_ui_obj->menuconfig_check);
-    config_options.xconfig_check             = checkstate_checked(options_page_ui_obj->xconfig_check);
-    config_options.gconfig_check             = checkstate_checked(options_page_ui_obj->gconfig_check);
-    config_options.localmodcfg_check         = checkstate_checked(options_page_ui_obj->localmodcfg_check);
-    config_options.numa_check                = checkstate_checked(options_page_ui_obj->numa_check);
-    config_options.damon_check               = checkstate_checked(options_page_ui_obj->damon_check);
-    config_options.builtin_zfs_check         = checkstate_checked(options_page_ui_obj->builtin_zfs_check);
-    config_options.builtin_nvidia_check      = checkstate_checked(options_page_ui_obj->builtin_nvidia_check);
-    config_options.builtin_nvidia_open_check = checkstate_checked(options_page_ui_obj->builtin_nvidia_open_check);
-    config_options.build_debug_check         = checkstate_checked(options_page_ui_obj->build_debug_check);
+void ConfWindow::on_queue_remove() noexcept {
+    auto* current_item = m_ui->queue_tree->currentItem();
+    /* clang-format off */
+    if (current_item == nullptr) { return; }
+    /* clang-format on */
 
-    // combobox values (strings that we try to find on load)
-    config_options.hz_ticks_combo = get_hz_tick(static_cast<size_t>(options_page_ui_obj->hzticks_combo_box->currentIndex()));
-    config_options.tickrate_combo = get_tickless_mode(static_cast<size_t>(options_page_ui_obj->tickless_combo_box->currentIndex()));
-    config_options.preempt_combo  = get_preempt_mode(static_cast<size_t>(options_page_ui_obj->preempt_combo_box->currentIndex()));
-    config_options.hugepage_combo = get_hugepage_mode(static_cast<size_t>(options_page_ui_obj->hugepage_combo_box->currentIndex()));
-    config_options.lto_combo      = get_lto_mode(static_cast<size_t>(options_page_ui_obj->lto_combo_box->currentIndex()));
-    config_options.cpu_opt_combo  = get_cpu_opt_mode(static_cast<size_t>(options_page_ui_obj->processor_opt_combo_box->currentIndex()));
+    const auto entry_id = current_item->data(0, Qt::UserRole).toULongLong();
+    /* clang-format off */
+    if (m_queue_entry_id == entry_id) { return; }
+    /* clang-format on */
+    build::BuildQueue::instance().remove(entry_id);
+    refresh_queue_tree();
+}
 
-    config_options.custom_name_edit = options_page_ui_obj->custom_name_edit->text().toStdString();
+void ConfWindow::on_queue_install() noexcept {
+    auto* current_item = m_ui->queue_tree->currentItem();
+    /* clang-format off */
+    if (m_running || current_item == nullptr) { return; }
+    /* clang-format on */
+
+    const auto entry_id      = current_item->data(0, Qt::UserRole).toULongLong();
+    const auto& packages_dir = build::BuildQueue::instance().get_packages_dir(entry_id);
+    /* clang-format off */
+    if (!fs::exists(packages_dir)) { return; }
+    /* clang-format on */
+
+    m_running = true;
+    run_cmd_async("sudo pacman -U ./*", packages_dir);
+}
+
+void ConfWindow::on_queue_start() noexcept {
+    /* clang-format off */
+    if (m_queue_running) { return; }
+    /* clang-format on */
+    m_queue_running = true;
+    m_queue_prepared.reset();
+    refresh_queue_tree();
+
+    // NOTE: the repository is updated once per queue, the builds restore only their own PKGBUILD.
+    if (!m_running) {
+        utils::prepare_build_environment();
+    }
+    run_next_queue_entry();
+}
+
+void ConfWindow::run_next_queue_entry() noexcept {
+    /* clang-format off */
+    if (!m_queue_running || m_running || m_queue_preparing) { return; }
+    /* clang-format on */
+
+    auto& build_queue       = build::BuildQueue::instance();
+    const auto* queue_entry = build_queue.pick_next(m_last_queue_entry_id);
+    if (queue_entry == nullptr) {
+        m_queue_running = false;
+        m_queue_prepared.reset();
+        m_ui->build_status_label->setText(tr("Build queue is done"));
+        refresh_queue_tree();
+        return;
+    }
+    // the queue goes on, once the patch check of the variant has finished
+    if (queue_entry->job.variant == m_checking_variant) {
+        m_ui->build_status_label->setText(tr("Waiting for the patch check of %1").arg(QString::fromStdString(m_checking_variant)));
+        return;
+    }
+
+    m_running             = true;
+    m_queue_entry_id      = queue_entry->id;
+    m_last_queue_entry_id = queue_entry->id;
+    auto job              = queue_entry->job;
+    build_queue.set_state(queue_entry->id, build::QueueState::Running);
+    refresh_queue_tree();
+
+    if (!build::restore_pkgbuild(job.variant)) {
+        fail_build(tr("Failed to restore PKGBUILD of %1").arg(QString::fromStdString(job.variant)));
+        return;
+    }
+
+    // the sources were prepared while the previous entry was compiling
+    if (m_queue_prepared && m_queue_prepared->first == queue_entry->id) {
+        auto prepared = std::move(m_queue_prepared->second);
+        m_queue_prepared.reset();
+        start_build(job, build::get_option_values(job.options), std::move(prepared));
+        return;
+    }
+    m_queue_prepared.reset();
+    run_build_job(std::move(job));
+}
+
+void ConfWindow::prepare_next_queue_entry(std::string_view running_variant) noexcept {
+    const auto* next_entry = build::BuildQueue::instance().pick_next(m_last_queue_entry_id);
+    // NOTE: PKGBUILD and SRCDEST of the running variant are in use by its build, and of the checked one by the check.
+    /* clang-format off */
+    if (next_entry == nullptr || next_entry->job.variant == running_variant || next_entry->job.variant == m_checking_variant) { return; }
+    /* clang-format on */
+
+    m_queue_preparing   = true;
+    m_preparing_variant = next_entry->job.variant;
+    m_executor.run(
+        TaskExecutor::Lane::Pool, this,
+        [job = next_entry->job](std::stop_token stop_token) {
+            build::restore_pkgbuild(job.variant);
+            return build::prepare_sources(job, build::get_option_values(job.options), stop_token);
+        },
+        [this, entry_id = next_entry->id](build::PreparedSources&& prepared) {
+            m_queue_preparing = false;
+            m_queue_prepared.emplace(entry_id, std::move(prepared));
+            // the running build may have finished meanwhile
+            run_next_queue_entry();
+        });
+}
+
+void ConfWindow::refresh_queue_tree() noexcept {
+    static constexpr std::array state_names{QT_TR_NOOP("Pending"), QT_TR_NOOP("Running"), QT_TR_NOOP("Done"), QT_TR_NOOP("Failed")};
+
+    const auto& build_queue = build::BuildQueue::instance();
+    m_ui->queue_tree->clear();
+    for (auto&& queue_entry : build_queue.get_entries()) {
+        const auto& options = queue_entry.job.options;
+        const auto& summary = fmt::format(FMT_COMPILE("HZ {}, preempt {}, LTO {}, cpu {}, {} patches"), options.hz_ticks_combo, options.preempt_combo,
+            options.lto_combo, options.cpu_opt_combo, queue_entry.job.patches.size());
+
+        auto* item = new QTreeWidgetItem(m_ui->queue_tree);
+        item->setData(0, Qt::UserRole, QVariant{static_cast<qulonglong>(queue_entry.id)});
+        item->setText(0, QString::number(queue_entry.id));
+        item->setText(1, QString::fromStdString(queue_entry.job.variant));
+        item->setText(2, QString::fromStdString(summary));
+        item->setText(3, tr(state_names[static_cast<std::size_t>(queue_entry.state)]));
+        if (queue_entry.state == build::QueueState::Done) {
+            item->setToolTip(3, QString::fromStdString(build_queue.get_packages_dir(queue_entry.id)));
+        } else if (!queue_entry.reason.empty()) {
+            item->setToolTip(3, QString::fromStdString(queue_entry.reason));
+        }
+    }
+    m_ui->queue_start_button->setEnabled(!m_queue_running);
+}
+
+void ConfWindow::update_build_status() noexcept {
+    /* clang-format off */
+    if (!m_build_tracker) { return; }
+    /* clang-format on */
+    m_build_tracker->poll();
+    if (m_build_tracker->is_finished()) {
+        finish_build_tracking();
+        return;
+    }
+
+    const auto current_phase = m_build_tracker->get_current_phase();
+    const auto& phase_name   = current_phase ? QString::fromUtf8(build::build_phase_names[static_cast<std::size_t>(*current_phase)].data()) : tr("starting");
+    auto status_text         = tr("Build phase: %1, %2 elapsed").arg(phase_name, format_duration(m_build_tracker->get_elapsed_secs()));
+    if (m_build_estimate) {
+        status_text += tr(", about %1 left").arg(format_duration(m_build_tracker->get_eta_secs(*m_build_estimate)));
+    }
+    m_ui->build_status_label->setText(status_text);
+}
+
+void ConfWindow::finish_build_tracking() noexcept {
+    m_build_timer.stop();
+    m_monitor_timer.stop();
+    m_executor.cancel(m_sample_job);
+
+    const auto& record = m_build_tracker->get_record();
+    build::BuildHistory::instance().append(record);
+    const auto& status_text = record.succeeded ? tr("Build finished in %1") : tr("Build failed after %1");
+    m_ui->build_status_label->setText(status_text.arg(format_duration(record.get_total_secs())));
+
+    m_build_tracker.reset();
+    refresh_build_history();
+}
+
+void ConfWindow::sample_resources() noexcept {
+    // NOTE: without the scope of systemd-run the whole /proc is walked, which is too slow for the GUI thread,
+    // so only the reading is delivered back. The tick is skipped, while the previous reading is still taken.
+    /* clang-format off */
+    if (m_executor.is_running(m_sample_job)) { return; }
+    /* clang-format on */
+    if (m_build_tracker) {
+        m_resource_sampler.set_cgroup_dir(m_build_tracker->get_cgroup_dir());
+    }
+    m_sample_job = m_executor.run(
+        TaskExecutor::Lane::Pool, this,
+        [cgroup_dir = m_resource_sampler.get_cgroup_dir()](std::stop_token) { return build::ResourceSampler::read(cgroup_dir); },
+        [this](build::ResourceSampler::Reading&& reading) {
+            // the build without its own scope is measured by its process tree
+            if (m_build_tracker && reading.cgroup_dir.empty()) {
+                m_build_tracker->add_process_tree_sample(reading.counters);
+            }
+            m_resource_sampler.push(reading);
+            update_resource_monitor();
+        });
+}
+
+void ConfWindow::update_resource_monitor() noexcept {
+    static constexpr double bytes_per_gib = 1024.0 * 1024.0 * 1024.0;
+    static constexpr double bytes_per_mib = 1024.0 * 1024.0;
+
+    const auto& history = m_resource_sampler.get_history();
+    /* clang-format off */
+    if (history.empty()) { return; }
+    /* clang-format on */
+
+    ResourceGraph::Series cpu_series{.name = tr("CPU"), .color = QColor(Qt::darkCyan)};
+    ResourceGraph::Series memory_series{.name = tr("Memory"), .color = QColor(Qt::darkMagenta)};
+    ResourceGraph::Series read_series{.name = tr("Read"), .color = QColor(Qt::darkGreen)};
+    ResourceGraph::Series write_series{.name = tr("Write"), .color = QColor(Qt::darkRed)};
+    ResourceGraph::Series cpu_pressure_series{.name = tr("CPU stalls"), .color = QColor(Qt::darkCyan)};
+    ResourceGraph::Series memory_pressure_series{.name = tr("Memory stalls"), .color = QColor(Qt::darkMagenta)};
+    ResourceGraph::Series io_pressure_series{.name = tr("I/O stalls"), .color = QColor(Qt::darkYellow)};
+    for (std::size_t i = 0; i < history.size(); ++i) {
+        const auto& sample = history[i];
+        cpu_series.values.emplace_back(sample.cpu_cores);
+        memory_series.values.emplace_back(static_cast<double>(sample.memory_bytes) / bytes_per_gib);
+        read_series.values.emplace_back(sample.io_read_bps / bytes_per_mib);
+        write_series.values.emplace_back(sample.io_write_bps / bytes_per_mib);
+        cpu_pressure_series.values.emplace_back(sample.cpu_pressure);
+        memory_pressure_series.values.emplace_back(sample.memory_pressure);
+        io_pressure_series.values.emplace_back(sample.io_pressure);
+    }
+
+    const auto cores_count = std::max(std::thread::hardware_concurrency(), 1U);
+    m_ui->cpu_graph->set_series({std::move(cpu_series)}, cores_count, tr("cores"));
+    m_ui->memory_graph->set_series({std::move(memory_series)}, 0, tr("GiB"));
+    m_ui->io_graph->set_series({std::move(read_series), std::move(write_series)}, 0, tr("MiB/s"));
+    m_ui->pressure_graph->set_series({std::move(cpu_pressure_series), std::move(memory_pressure_series), std::move(io_pressure_series)}, 100, tr("%"));
+
+    QString summary_text{};
+    switch (build::get_bottleneck(history.back(), cores_count)) {
+    case build::BuildBottleneck::Cpu:
+        summary_text = tr("The build is CPU-bound");
+        break;
+    case build::BuildBottleneck::Io:
+        summary_text = tr("The build is I/O-bound, consider building in tmpfs");
+        break;
+    case build::BuildBottleneck::Memory:
+        summary_text = tr("The build is memory-starved, consider fewer make jobs or building on disk");
+        break;
+    case build::BuildBottleneck::None:
+        summary_text = tr("The build doesn't use all of the cores");
+        break;
+    }
+    m_ui->monitor_summary_label->setText(summary_text);
+}
+
+void ConfWindow::refresh_build_history() noexcept {
+    auto* option_costs_tree = m_ui->option_costs_tree;
+    option_costs_tree->clear();
+    for (auto&& option_cost : build::BuildHistory::instance().get_option_costs()) {
+        auto* item = new QTreeWidgetItem(option_costs_tree);
+        item->setText(0, QString::fromStdString(option_cost.option));
+        item->setText(1, QString::number(option_cost.builds_with));
+        item->setText(2, format_duration(option_cost.avg_secs_with));
+        item->setText(3, format_duration(option_cost.avg_secs_without));
+    }
+}
+
+void ConfWindow::on_save() noexcept {
+    const auto& config_options = get_config_options();
 
     auto save_file_path = QFileDialog::getSaveFileName(
         this,
@@ -768,6 +1191,16 @@ void ConfWindow::on_load() noexcept {
 
     options_page_ui_obj->custom_name_edit->setText(QString::fromStdString(config_options->custom_name_edit));
 
+    // NOTE: config files saved by older versions don't have compiler cache options.
+    if (!config_options->compiler_cache_combo.empty()) {
+        combobox_stat += set_combobox_val(options_page_ui_obj->compiler_cache_combo_box, lookup_compiler_cache(config_options->compiler_cache_combo));
+    }
+    if (config_options->compiler_cache_size > 0) {
+        options_page_ui_obj->compiler_cache_size_spin_box->setValue(config_options->compiler_cache_size);
+    }
+    set_checkstate(options_page_ui_obj->tmpfs_build_check, config_options->tmpfs_build_check);
+    set_checkstate(options_page_ui_obj->incremental_build_check, config_options->incremental_build_check);
+
     if (combobox_stat != 0) {
         QMessageBox::critical(this, "CachyOS Kernel Manager", tr("Config file(%1) is outdated").arg(QString::fromStdString(load_file_path)));
     }
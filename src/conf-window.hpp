@@ -39,13 +39,25 @@
 
 #include <ui_conf-window.h>
 
+#include "build_job.hpp"
+#include "build_monitor.hpp"
+#include "build_queue.hpp"
+#include "build_telemetry.hpp"
+#include "config-options.hpp"
+#include "patch_stack.hpp"
+#include "task-executor.hpp"
+
+#include <cstdint>
 #include <memory>
+#include <optional>
 #include <string>
+#include <string_view>
 #include <utility>
 #include <vector>
 
 #include <QMainWindow>
 #include <QProcess>
+#include <QTimer>
 
 #if defined(__clang__)
 #pragma clang diagnostic pop
@@ -57,9 +69,10 @@ class ConfWindow final : public QMainWindow {
     Q_OBJECT
     Q_DISABLE_COPY_MOVE(ConfWindow)
  public:
-    explicit ConfWindow(QWidget* parent = nullptr);
+    explicit ConfWindow(TaskExecutor& executor, QWidget* parent = nullptr);
     ~ConfWindow() = default;
 
+    /// @brief Recomputes the patches list from PKGBUILD in the background.
     void reset_patches_data_tab() noexcept;
 
  protected:
@@ -68,19 +81,58 @@ class ConfWindow final : public QMainWindow {
  private:
     void on_cancel() noexcept;
     void on_execute() noexcept;
+    void on_check_patches() noexcept;
+    void run_build_job(build::BuildJob job) noexcept;
+    void start_build(const build::BuildJob& job, std::string_view option_values, build::PreparedSources&& prepared) noexcept;
+    void fail_build(const QString& reason) noexcept;
     void on_save() noexcept;
     void on_load() noexcept;
     void finished_proc(int exit_code, QProcess::ExitStatus exit_status) noexcept;
+    void update_build_status() noexcept;
+    void finish_build_tracking() noexcept;
+    void refresh_build_history() noexcept;
+    void sample_resources() noexcept;
+    void update_resource_monitor() noexcept;
+    void on_queue_add() noexcept;
+    void on_queue_remove() noexcept;
+    void on_queue_install() noexcept;
+    void on_queue_start() noexcept;
+    void run_next_queue_entry() noexcept;
+    void prepare_next_queue_entry(std::string_view running_variant) noexcept;
+    void refresh_queue_tree() noexcept;
 
     bool m_running{};
+    TaskExecutor& m_executor;
+    QTimer m_patches_timer{};
+    std::uint64_t m_patches_generation{};
     QProcess m_cmd{};
+    QTimer m_build_timer{};
+    std::unique_ptr<build::BuildTracker> m_build_tracker{};
+    std::optional<build::PhaseDurations> m_build_estimate{};
+    QTimer m_monitor_timer{};
+    build::ResourceSampler m_resource_sampler{};
+    TaskExecutor::job_id_t m_sample_job{};
     std::string m_build_conf_path{};
-    std::vector<std::string> m_previously_set_options{};
+    /// Variants, whose SRCDEST is in use by the build or by the preparation of the next queue entry.
+    std::string m_building_variant{};
+    std::string m_preparing_variant{};
+    /// Variant, whose patches are checked, the check hands out into its SRCDEST as well.
+    std::string m_checking_variant{};
+    bool m_queue_running{};
+    bool m_queue_preparing{};
+    std::optional<std::uint64_t> m_queue_entry_id{};
+    std::uint64_t m_last_queue_entry_id{};
+    /// Sources of the next queue entry, prepared while the current one is compiling.
+    std::optional<std::pair<std::uint64_t, build::PreparedSources>> m_queue_prepared{};
     std::unique_ptr<Ui::ConfWindow> m_ui = std::make_unique<Ui::ConfWindow>();
 
     void run_cmd_async(std::string cmd, const std::string& working_path) noexcept;
     auto get_all_set_values() const noexcept -> std::string;
+    auto get_config_options() const noexcept -> ConfigOptions;
+    auto get_build_job() const noexcept -> build::BuildJob;
     void clear_patches_data_tab() noexcept;
+    void apply_patches_data_tab(const std::vector<std::string>& patches) noexcept;
+    void apply_patch_checks(const std::vector<std::string>& patches, const std::vector<build::PatchCheck>& checks) noexcept;
     void connect_all_checkboxes() noexcept;
 };
 
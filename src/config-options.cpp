@@ -77,6 +77,12 @@ auto ConfigOptions::parse_from_file(std::string_view filepath) noexcept -> std::
         .cpu_opt_combo  = std::string{rust_config_options.cpu_opt_combo},
 
         .custom_name_edit = std::string{rust_config_options.custom_name_edit},
+
+        .compiler_cache_combo = std::string{rust_config_options.compiler_cache_combo},
+        .compiler_cache_size  = rust_config_options.compiler_cache_size,
+        .tmpfs_build_check    = rust_config_options.tmpfs_build_check,
+
+        .incremental_build_check = rust_config_options.incremental_build_check,
     };
     return std::make_optional<ConfigOptions>(std::move(config_options));
 }
@@ -109,6 +115,12 @@ auto ConfigOptions::write_config_file(const ConfigOptions& config_options, std::
         .cpu_opt_combo  = rust::String(config_options.cpu_opt_combo),
 
         .custom_name_edit = rust::String(config_options.custom_name_edit),
+
+        .compiler_cache_combo = rust::String(config_options.compiler_cache_combo),
+        .compiler_cache_size  = config_options.compiler_cache_size,
+        .tmpfs_build_check    = config_options.tmpfs_build_check,
+
+        .incremental_build_check = config_options.incremental_build_check,
     };
 
     try {
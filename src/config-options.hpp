@@ -19,6 +19,7 @@
 #ifndef CONFIGOPTIONS_HPP_
 #define CONFIGOPTIONS_HPP_
 
+#include <cstdint>      // for int32_t
 #include <optional>     // for optional
 #include <string>       // for string
 #include <string_view>  // for string_view
@@ -51,6 +52,11 @@ struct ConfigOptions {
 
     std::string custom_name_edit{};
 
+    std::string compiler_cache_combo{};
+    std::int32_t compiler_cache_size{};
+    bool tmpfs_build_check{};
+    bool incremental_build_check{};
+
     static auto parse_from_file(std::string_view filepath) noexcept -> std::optional<ConfigOptions>;
     static auto write_config_file(const ConfigOptions& config_options, std::string_view filepath) noexcept -> bool;
 };
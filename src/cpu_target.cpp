@@ -0,0 +1,169 @@
+// Copyright (C) 2022-2024 Vladislav Nepogodin
+//
+// This file is part of CachyOS kernel manager.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include "cpu_target.hpp"
+#include "utils.hpp"
+
+#include <optional>  // for optional
+
+#include <fmt/compile.h>
+#include <fmt/core.h>
+
+namespace {
+
+#if defined(__x86_64__)
+
+// e.g. "AMD Ryzen 7 5800X 8-Core Processor"
+auto get_cpu_model_name() noexcept -> std::string {
+    using namespace std::string_view_literals;
+    static constexpr auto needle = "model name"sv;
+
+    const auto& cpuinfo = utils::read_whole_file("/proc/cpuinfo");
+    for (auto&& line : utils::make_split_view(cpuinfo, '\n')) {
+        /* clang-format off */
+        if (!line.starts_with(needle)) { continue; }
+        /* clang-format on */
+        if (auto pos = line.find_first_not_of(" \t", line.find(':') + 1); pos != std::string_view::npos) {
+            return std::string{line.substr(pos)};
+        }
+    }
+    return {};
+}
+
+struct Microarch {
+    std::string_view cpu_opt;
+    std::string_view display_name;
+};
+
+// NOTE: only the microarchitectures, which PKGBUILD offers, the newer ones are built with native.
+auto detect_microarch() noexcept -> std::optional<Microarch> {
+    using namespace std::string_view_literals;
+    __builtin_cpu_init();
+    if (__builtin_cpu_is("znver1")) {
+        return Microarch{"zen"sv, "Zen"sv};
+    } else if (__builtin_cpu_is("znver2")) {
+        return Microarch{"zen2"sv, "Zen 2"sv};
+    } else if (__builtin_cpu_is("znver3")) {
+        return Microarch{"zen3"sv, "Zen 3"sv};
+    } else if (__builtin_cpu_is("sandybridge")) {
+        return Microarch{"sandybridge"sv, "Sandy Bridge"sv};
+    } else if (__builtin_cpu_is("ivybridge")) {
+        return Microarch{"ivybridge"sv, "Ivy Bridge"sv};
+    } else if (__builtin_cpu_is("haswell")) {
+        return Microarch{"haswell"sv, "Haswell"sv};
+    } else if (__builtin_cpu_is("icelake-client") || __builtin_cpu_is("icelake-server")) {
+        return Microarch{"icelake"sv, "Ice Lake"sv};
+    } else if (__builtin_cpu_is("tigerlake")) {
+        return Microarch{"tigerlake"sv, "Tiger Lake"sv};
+    } else if (__builtin_cpu_is("alderlake")) {
+        return Microarch{"alderlake"sv, "Alder Lake"sv};
+    }
+    return std::nullopt;
+}
+
+#endif
+
+struct HostIsa {
+    std::uint8_t isa_level{};
+    bool is_zen4{};
+};
+
+// NOTE: AMD has AVX-512 since Zen 4, which __builtin_cpu_is of the older compilers doesn't know about.
+auto get_host_isa() noexcept -> const HostIsa& {
+    static const auto host_isa = [] {
+        HostIsa result{.isa_level = build::detect_isa_level()};
+#if defined(__x86_64__)
+        result.is_zen4 = result.isa_level >= 4 && __builtin_cpu_is("amd");
+#endif
+        return result;
+    }();
+    return host_isa;
+}
+
+}  // namespace
+
+namespace build {
+
+auto detect_isa_level() noexcept -> std::uint8_t {
+#if defined(__x86_64__)
+    // NOTE: the levels are checked as the compiler defines them, with every feature of the level
+    // (e.g. cx16, lahf_lm, movbe, f16c) and with the OS support of the AVX state.
+    __builtin_cpu_init();
+    /* clang-format off */
+    if (__builtin_cpu_supports("x86-64-v4")) { return 4; }
+    if (__builtin_cpu_supports("x86-64-v3")) { return 3; }
+    if (__builtin_cpu_supports("x86-64-v2")) { return 2; }
+    /* clang-format on */
+    return 1;
+#else
+    return 0;
+#endif
+}
+
+auto detect_cpu_target() noexcept -> CpuTarget {
+    using namespace std::string_view_literals;
+
+    CpuTarget result{.isa_level = detect_isa_level()};
+    /* clang-format off */
+    if (result.isa_level == 0) { return result; }
+    /* clang-format on */
+
+#if defined(__x86_64__)
+    std::string_view microarch_name{};
+    if (const auto& microarch = detect_microarch()) {
+        result.cpu_opt = microarch->cpu_opt;
+        microarch_name = microarch->display_name;
+    } else if (__builtin_cpu_is("amd")) {
+        result.cpu_opt = "native_amd"sv;
+        microarch_name = "newer or unlisted AMD, built for this CPU"sv;
+    } else if (__builtin_cpu_is("intel")) {
+        result.cpu_opt = "native_intel"sv;
+        microarch_name = "newer or unlisted Intel, built for this CPU"sv;
+    } else {
+        result.cpu_opt = "generic"sv;
+        microarch_name = "unknown vendor"sv;
+    }
+
+    auto model_name = get_cpu_model_name();
+    if (model_name.empty()) {
+        model_name = "Unknown CPU";
+    }
+    result.reason = fmt::format(FMT_COMPILE("{}: {}, x86-64-v{}"), model_name, microarch_name, result.isa_level);
+#endif
+    return result;
+}
+
+auto rank_repo(std::string_view repo) noexcept -> std::uint8_t {
+    const auto& host_isa = get_host_isa();
+    /* clang-format off */
+    if (host_isa.isa_level == 0) { return 1; }
+    /* clang-format on */
+
+    if (repo.contains("znver4")) {
+        return host_isa.is_zen4 ? 5 : 0;
+    }
+    std::uint8_t required_level = 1;
+    if (repo.ends_with("-v4")) {
+        required_level = 4;
+    } else if (repo.ends_with("-v3")) {
+        required_level = 3;
+    }
+    return (host_isa.isa_level >= required_level) ? required_level : 0;
+}
+
+}  // namespace build
@@ -0,0 +1,52 @@
+// Copyright (C) 2022-2024 Vladislav Nepogodin
+//
+// This file is part of CachyOS kernel manager.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#ifndef CPU_TARGET_HPP
+#define CPU_TARGET_HPP
+
+#include <cstdint>      // for uint8_t
+#include <string>       // for string
+#include <string_view>  // for string_view
+
+namespace build {
+
+/// @brief Processor optimization of the kernel, which suits the host.
+struct CpuTarget {
+    /// Value of _processor_opt, e.g. "zen3", empty if the host isn't x86-64.
+    std::string_view cpu_opt{};
+    /// Highest x86-64 microarchitecture level (1-4), 0 if the host isn't x86-64.
+    std::uint8_t isa_level{};
+    /// Why the value was chosen, e.g. "AMD Ryzen 7 5800X: Zen 3, x86-64-v3".
+    std::string reason{};
+};
+
+/// @brief Highest x86-64 microarchitecture level, which the host supports, 0 if the host isn't x86-64.
+auto detect_isa_level() noexcept -> std::uint8_t;
+
+/// @brief Probes the host CPU with CPUID, and picks the best matching _processor_opt:
+/// the microarchitecture, if PKGBUILD has it, native otherwise.
+auto detect_cpu_target() noexcept -> CpuTarget;
+
+/// @brief Ranks the repository by the ISA level its packages are built for,
+/// e.g. cachyos < cachyos-v3 < cachyos-v4 < cachyos-znver4.
+/// @return 0 if the host can't run the packages of the repository, 1 for generic x86-64 builds.
+auto rank_repo(std::string_view repo) noexcept -> std::uint8_t;
+
+}  // namespace build
+
+#endif  // CPU_TARGET_HPP
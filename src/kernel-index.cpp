@@ -0,0 +1,226 @@
+// Copyright (C) 2022-2024 Vladislav Nepogodin
+//
+// This file is part of CachyOS kernel manager.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include "kernel-index.hpp"
+#include "string_utils.hpp"
+
+#include <algorithm>  // for find_if, transform
+#include <array>      // for array
+#include <bit>        // for popcount
+#include <utility>    // for pair
+
+namespace {
+
+// Short names of the categories, reported by Kernel::category().
+constexpr std::array<std::pair<std::string_view, std::string_view>, 9> category_aliases{{
+    {"lto optimized", "lto"},
+    {"longterm", "lts"},
+    {"zen-kernel", "zen"},
+    {"hardened-kernel", "hardened"},
+    {"next release", "next"},
+    {"mainline branch", "mainline"},
+    {"master branch", "git"},
+    {"release candidate", "rc"},
+    {"stable", "stable"},
+}};
+
+constexpr auto to_lower_ascii(char ch) noexcept -> char {
+    return (ch >= 'A' && ch <= 'Z') ? static_cast<char>(ch - 'A' + 'a') : ch;
+}
+
+auto to_lower(std::string_view str) noexcept -> std::string {
+    std::string result(str.size(), '\0');
+    std::ranges::transform(str, result.begin(), to_lower_ascii);
+    return result;
+}
+
+constexpr auto make_trigram(std::string_view str, std::size_t pos) noexcept -> std::uint32_t {
+    return (static_cast<std::uint32_t>(static_cast<unsigned char>(str[pos])) << 16U)
+        | (static_cast<std::uint32_t>(static_cast<unsigned char>(str[pos + 1])) << 8U)
+        | static_cast<std::uint32_t>(static_cast<unsigned char>(str[pos + 2]));
+}
+
+}  // namespace
+
+namespace search {
+
+RowSet::RowSet(std::size_t size, bool value) noexcept
+  : m_size(size), m_words((size + 63) / 64, value ? ~std::uint64_t{0} : std::uint64_t{0}) {
+    if (value && (size % 64) != 0) {
+        m_words.back() &= (std::uint64_t{1} << (size % 64)) - 1;
+    }
+}
+
+auto RowSet::operator&=(const RowSet& other) noexcept -> RowSet& {
+    for (std::size_t i = 0; i < m_words.size(); ++i) {
+        m_words[i] &= other.m_words[i];
+    }
+    return *this;
+}
+
+auto RowSet::operator|=(const RowSet& other) noexcept -> RowSet& {
+    for (std::size_t i = 0; i < m_words.size(); ++i) {
+        m_words[i] |= other.m_words[i];
+    }
+    return *this;
+}
+
+void RowSet::flip() noexcept {
+    for (auto& word : m_words) {
+        word = ~word;
+    }
+    if (!m_words.empty() && (m_size % 64) != 0) {
+        m_words.back() &= (std::uint64_t{1} << (m_size % 64)) - 1;
+    }
+}
+
+auto RowSet::count() const noexcept -> std::size_t {
+    std::size_t result{};
+    for (auto word : m_words) {
+        result += static_cast<std::size_t>(std::popcount(word));
+    }
+    return result;
+}
+
+void KernelIndex::build(const std::vector<IndexRecord>& records) noexcept {
+    m_size = records.size();
+    m_names.clear();
+    m_names.reserve(m_size);
+    m_trigrams.clear();
+    m_repos.clear();
+    m_categories.clear();
+    m_installed = RowSet(m_size);
+    m_updates   = RowSet(m_size);
+
+    for (std::size_t row = 0; row < m_size; ++row) {
+        const auto& record = records[row];
+        auto& name         = m_names.emplace_back(to_lower(record.name));
+
+        // posting lists are sorted, because rows are visited in order
+        for (std::size_t pos = 0; pos + 3 <= name.size(); ++pos) {
+            auto& posting = m_trigrams[make_trigram(name, pos)];
+            if (posting.empty() || posting.back() != row) {
+                posting.push_back(static_cast<std::uint32_t>(row));
+            }
+        }
+
+        m_repos.try_emplace(to_lower(record.repo), m_size).first->second.set(row);
+        m_categories.try_emplace(to_lower(record.category), m_size).first->second.set(row);
+
+        /* clang-format off */
+        if (record.installed) { m_installed.set(row); }
+        if (record.update_available) { m_updates.set(row); }
+        /* clang-format on */
+    }
+}
+
+auto KernelIndex::query(std::string_view query) const noexcept -> std::optional<RowSet> {
+    const auto& terms = utils::make_multiline_view(query, ' ');
+    if (terms.empty()) {
+        return std::nullopt;
+    }
+
+    RowSet result(m_size, true);
+    for (auto&& term : terms) {
+        result &= match_term(term);
+    }
+    return std::make_optional<RowSet>(std::move(result));
+}
+
+auto KernelIndex::match_term(std::string_view term) const noexcept -> RowSet {
+    using namespace std::string_view_literals;
+
+    const bool is_negated = term.size() > 1 && (term.front() == '-' || term.front() == '!');
+    if (is_negated) {
+        term.remove_prefix(1);
+    }
+    const auto& lowered = to_lower(term);
+
+    RowSet matched{};
+    if (lowered == "installed"sv) {
+        matched = m_installed;
+    } else if (lowered == "update"sv || lowered == "updates"sv) {
+        matched = m_updates;
+    } else if (lowered.starts_with("repo:"sv)) {
+        matched = match_facet(m_repos, std::string_view{lowered}.substr(5), false);
+    } else if (lowered.starts_with("category:"sv)) {
+        matched = match_facet(m_categories, std::string_view{lowered}.substr(9), true);
+    } else {
+        matched = match_text(lowered);
+    }
+
+    if (is_negated) {
+        matched.flip();
+    }
+    return matched;
+}
+
+auto KernelIndex::match_text(std::string_view text) const noexcept -> RowSet {
+    RowSet result(m_size);
+
+    // short terms have no trigrams, linear scan over the names is cheap enough
+    if (text.size() < 3) {
+        for (std::size_t row = 0; row < m_size; ++row) {
+            if (m_names[row].contains(text)) {
+                result.set(row);
+            }
+        }
+        return result;
+    }
+
+    // pick the rarest trigram of the term as candidate list,
+    // and verify the candidates with plain substring search.
+    const std::vector<std::uint32_t>* candidates{nullptr};
+    for (std::size_t pos = 0; pos + 3 <= text.size(); ++pos) {
+        const auto& it = m_trigrams.find(make_trigram(text, pos));
+        if (it == m_trigrams.end()) {
+            return result;
+        }
+        if (candidates == nullptr || it->second.size() < candidates->size()) {
+            candidates = &it->second;
+        }
+    }
+
+    for (auto row : *candidates) {
+        if (m_names[row].contains(text)) {
+            result.set(row);
+        }
+    }
+    return result;
+}
+
+auto KernelIndex::match_facet(const std::unordered_map<std::string, RowSet>& facet, std::string_view value, bool allow_prefix) const noexcept -> RowSet {
+    RowSet result(m_size);
+    if (value.empty()) {
+        return result;
+    }
+
+    for (auto&& [facet_value, rows] : facet) {
+        bool is_matched = (facet_value == value) || (allow_prefix && facet_value.starts_with(value));
+        if (!is_matched && allow_prefix) {
+            const auto& alias_it = std::ranges::find_if(category_aliases, [&](auto&& alias) { return alias.first == facet_value; });
+            is_matched           = (alias_it != category_aliases.end()) && (alias_it->second == value);
+        }
+        if (is_matched) {
+            result |= rows;
+        }
+    }
+    return result;
+}
+
+}  // namespace search
@@ -0,0 +1,97 @@
+// Copyright (C) 2022-2024 Vladislav Nepogodin
+//
+// This file is part of CachyOS kernel manager.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#ifndef KERNEL_INDEX_HPP
+#define KERNEL_INDEX_HPP
+
+#include <cstdint>        // for uint32_t, uint64_t
+#include <optional>       // for optional
+#include <string>         // for string
+#include <string_view>    // for string_view
+#include <unordered_map>  // for unordered_map
+#include <vector>         // for vector
+
+namespace search {
+
+/// @brief Fixed size set of catalog rows.
+class RowSet {
+ public:
+    RowSet() = default;
+    explicit RowSet(std::size_t size, bool value = false) noexcept;
+
+    /* clang-format off */
+    constexpr auto size() const noexcept -> std::size_t
+    { return m_size; }
+
+    inline auto test(std::size_t pos) const noexcept -> bool
+    { return (m_words[pos / 64] >> (pos % 64)) & 1U; }
+
+    inline void set(std::size_t pos) noexcept
+    { m_words[pos / 64] |= (std::uint64_t{1} << (pos % 64)); }
+    /* clang-format on */
+
+    auto operator&=(const RowSet& other) noexcept -> RowSet&;
+    auto operator|=(const RowSet& other) noexcept -> RowSet&;
+    void flip() noexcept;
+    auto count() const noexcept -> std::size_t;
+
+ private:
+    std::size_t m_size{};
+    std::vector<std::uint64_t> m_words{};
+};
+
+/// @brief Values of one catalog row, which are indexed.
+struct IndexRecord {
+    std::string_view name;
+    std::string_view repo;
+    std::string_view category;
+    bool installed{};
+    bool update_available{};
+};
+
+/// @brief Prebuilt search index over the kernel catalog.
+///
+/// Plain words are matched as case-insensitive substrings of the package name
+/// through a trigram index, and structured terms use precomputed facets:
+///   installed, update, repo:<name>, category:<name>
+/// Any term can be negated with a leading '-' or '!'.
+class KernelIndex {
+ public:
+    void build(const std::vector<IndexRecord>& records) noexcept;
+
+    /// @brief Returns the rows which match all terms of the query,
+    /// or std::nullopt if the query doesn't filter anything.
+    auto query(std::string_view query) const noexcept -> std::optional<RowSet>;
+
+ private:
+    auto match_term(std::string_view term) const noexcept -> RowSet;
+    auto match_text(std::string_view text) const noexcept -> RowSet;
+    auto match_facet(const std::unordered_map<std::string, RowSet>& facet, std::string_view value, bool allow_prefix) const noexcept -> RowSet;
+
+    std::size_t m_size{};
+    std::vector<std::string> m_names{};
+    std::unordered_map<std::uint32_t, std::vector<std::uint32_t>> m_trigrams{};
+    std::unordered_map<std::string, RowSet> m_repos{};
+    std::unordered_map<std::string, RowSet> m_categories{};
+    RowSet m_installed{};
+    RowSet m_updates{};
+};
+
+}  // namespace search
+
+#endif  // KERNEL_INDEX_HPP
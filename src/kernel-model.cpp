@@ -0,0 +1,321 @@
+// Copyright (C) 2022-2024 Vladislav Nepogodin
+//
+// This file is part of CachyOS kernel manager.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include "kernel-model.hpp"
+#include "cpu_target.hpp"
+
+#include <algorithm>      // for min, max
+#include <iterator>       // for make_move_iterator
+#include <string>         // for string
+#include <string_view>    // for string_view
+#include <unordered_map>  // for unordered_map
+#include <utility>        // for move
+
+auto KernelModel::make_entry(Kernel& kernel) noexcept -> Entry {
+    Entry entry{
+        .name      = QString::fromUtf8(kernel.get_raw()),
+        .version   = QString::fromStdString(kernel.version()),
+        .category  = QString::fromStdString(std::string{kernel.category()}),
+        .repo      = QString::fromStdString(std::string{kernel.get_repo()}),
+        .repo_rank = build::rank_repo(kernel.get_repo()),
+    };
+
+    // NOTE: version() must be called first, it fills the update flag.
+    entry.update_available = kernel.is_update_available();
+    entry.installed        = kernel.is_installed();
+    if (entry.installed) {
+        // kernel with the same name installed from the different repo,
+        // is not the one we list in this row.
+        const std::string_view kernel_installed_db = kernel.get_installed_db();
+        if (kernel_installed_db.empty() || kernel_installed_db == kernel.get_repo()) {
+            entry.immutable   = true;
+            entry.check_state = Qt::Checked;
+        }
+    }
+    return entry;
+}
+
+auto KernelModel::make_action(const Entry& entry) noexcept -> KernelAction {
+    // installed kernel of this row, which the user unchecked
+    if (entry.immutable) {
+        return (entry.check_state == Qt::Unchecked) ? KernelAction::Remove : KernelAction::None;
+    }
+    /* clang-format off */
+    if (entry.check_state != Qt::Checked) { return KernelAction::None; }
+    /* clang-format on */
+
+    // NOTE: same package name can be already installed from the different repo,
+    // then only newer version is pulled.
+    if (!entry.installed) {
+        return KernelAction::Install;
+    }
+    return entry.update_available ? KernelAction::Upgrade : KernelAction::None;
+}
+
+void KernelModel::set_kernels(std::vector<Kernel>&& kernels) noexcept {
+    beginResetModel();
+    m_kernels       = std::move(kernels);
+    m_pending_count = 0;
+    m_entries.clear();
+    m_entries.reserve(m_kernels.size());
+    for (auto& kernel : m_kernels) {
+        m_entries.emplace_back(make_entry(kernel));
+    }
+    endResetModel();
+    update_best_builds();
+}
+
+void KernelModel::append_kernels(std::vector<Kernel>&& kernels, std::vector<Entry>&& entries) noexcept {
+    /* clang-format off */
+    if (kernels.empty() || kernels.size() != entries.size()) { return; }
+    /* clang-format on */
+    const auto first_row = rowCount();
+    beginInsertRows({}, first_row, first_row + static_cast<int>(kernels.size()) - 1);
+    m_kernels.insert(m_kernels.end(), std::make_move_iterator(kernels.begin()), std::make_move_iterator(kernels.end()));
+    m_entries.insert(m_entries.end(), std::make_move_iterator(entries.begin()), std::make_move_iterator(entries.end()));
+    endInsertRows();
+
+    // NOTE: the better build of the listed kernel can come with the later repository.
+    update_best_builds();
+}
+
+auto KernelModel::get_best_rank(std::size_t row) const noexcept -> std::uint8_t {
+    const auto& name = m_kernels[row].get_name();
+    std::uint8_t best_rank{};
+    for (std::size_t i = 0; i < m_kernels.size(); ++i) {
+        if (m_kernels[i].get_name() == name) {
+            best_rank = std::max(best_rank, m_entries[i].repo_rank);
+        }
+    }
+    return best_rank;
+}
+
+void KernelModel::update_best_builds() noexcept {
+    struct RankRange {
+        std::uint8_t lowest{};
+        std::uint8_t highest{};
+    };
+    std::unordered_map<std::string_view, RankRange> ranks_by_name{};
+    ranks_by_name.reserve(m_kernels.size());
+    for (std::size_t row = 0; row < m_kernels.size(); ++row) {
+        const auto rank        = m_entries[row].repo_rank;
+        auto [it, is_inserted] = ranks_by_name.try_emplace(m_kernels[row].get_name(), RankRange{rank, rank});
+        it->second.lowest      = std::min(it->second.lowest, rank);
+        it->second.highest     = std::max(it->second.highest, rank);
+    }
+
+    for (std::size_t row = 0; row < m_kernels.size(); ++row) {
+        auto& entry        = m_entries[row];
+        const auto& range  = ranks_by_name[m_kernels[row].get_name()];
+        const bool is_best = range.lowest != range.highest && entry.repo_rank == range.highest;
+        if (entry.best_build != is_best) {
+            entry.best_build  = is_best;
+            const auto& index = createIndex(static_cast<int>(row), TreeCol::PkgName);
+            emit dataChanged(index, index, {Qt::FontRole, Qt::ToolTipRole});
+        }
+    }
+}
+
+auto KernelModel::make_transaction_plan() const noexcept -> TransactionPlan {
+    TransactionPlan plan{};
+    for (std::size_t row = 0; row < m_entries.size(); ++row) {
+        switch (m_entries[row].action) {
+        case KernelAction::Install:
+        case KernelAction::Upgrade:
+            plan.install_rows.push_back(row);
+            break;
+        case KernelAction::Remove:
+            plan.remove_rows.push_back(row);
+            break;
+        case KernelAction::None:
+            break;
+        }
+    }
+    return plan;
+}
+
+auto KernelModel::make_index_records() const noexcept -> std::vector<search::IndexRecord> {
+    std::vector<search::IndexRecord> records{};
+    records.reserve(m_kernels.size());
+    for (std::size_t row = 0; row < m_kernels.size(); ++row) {
+        const auto& kernel = m_kernels[row];
+        records.push_back({
+            .name             = kernel.get_raw(),
+            .repo             = kernel.get_repo(),
+            .category         = kernel.category(),
+            .installed        = m_entries[row].installed,
+            .update_available = m_entries[row].update_available,
+        });
+    }
+    return records;
+}
+
+auto KernelModel::index(int row, int column, const QModelIndex& parent) const -> QModelIndex {
+    if (parent.isValid() || row < 0 || column < 0 || row >= rowCount() || column >= TreeCol::Count) {
+        return {};
+    }
+    return createIndex(row, column);
+}
+
+auto KernelModel::parent(const QModelIndex& /*child*/) const -> QModelIndex {
+    // flat list
+    return {};
+}
+
+auto KernelModel::rowCount(const QModelIndex& parent) const -> int {
+    /* clang-format off */
+    if (parent.isValid()) { return 0; }
+    /* clang-format on */
+    return static_cast<int>(m_entries.size());
+}
+
+auto KernelModel::columnCount(const QModelIndex& parent) const -> int {
+    /* clang-format off */
+    if (parent.isValid()) { return 0; }
+    /* clang-format on */
+    return TreeCol::Count;
+}
+
+auto KernelModel::data(const QModelIndex& index, int role) const -> QVariant {
+    if (!index.isValid()) {
+        return {};
+    }
+    const auto& entry = m_entries[static_cast<std::size_t>(index.row())];
+
+    if (role == Qt::DisplayRole) {
+        switch (index.column()) {
+        case TreeCol::PkgName:
+            return entry.name;
+        case TreeCol::Version:
+            return entry.version;
+        case TreeCol::Category:
+            return entry.category;
+        default:
+            return {};
+        }
+    }
+
+    switch (role) {
+    case Qt::CheckStateRole:
+        /* clang-format off */
+        if (index.column() != TreeCol::Check) { return {}; }
+        /* clang-format on */
+        return static_cast<int>(entry.check_state);
+    case KernelRole::Installed:
+        return entry.installed;
+    case KernelRole::Immutable:
+        return entry.immutable;
+    case KernelRole::UpdateAvailable:
+        return entry.update_available;
+    case KernelRole::Repo:
+        return entry.repo;
+    case KernelRole::CatalogIndex:
+        return index.row();
+    case KernelRole::RepoRank:
+        return static_cast<int>(entry.repo_rank);
+    case KernelRole::BestBuild:
+        return entry.best_build;
+    case Qt::FontRole: {
+        /* clang-format off */
+        if (index.column() != TreeCol::PkgName || !entry.best_build) { return {}; }
+        /* clang-format on */
+        QFont font{};
+        font.setBold(true);
+        return font;
+    }
+    case Qt::ToolTipRole:
+        /* clang-format off */
+        if (index.column() != TreeCol::PkgName) { return {}; }
+        /* clang-format on */
+        if (entry.best_build) {
+            return tr("Best build of this kernel for your CPU");
+        } else if (entry.repo_rank == 0) {
+            return tr("This build requires CPU features, which your CPU doesn't support");
+        }
+        return {};
+    default:
+        return {};
+    }
+}
+
+auto KernelModel::setData(const QModelIndex& index, const QVariant& value, int role) -> bool {
+    if (!index.isValid() || index.column() != TreeCol::Check || role != Qt::CheckStateRole) {
+        return false;
+    }
+    auto& entry          = m_entries[static_cast<std::size_t>(index.row())];
+    const auto new_state = static_cast<Qt::CheckState>(value.toInt());
+    if (entry.check_state == new_state) {
+        return false;
+    }
+    entry.check_state = new_state;
+
+    // keep the amount of pending rows up to date, instead of rescanning the catalog
+    const auto new_action = make_action(entry);
+    if ((entry.action == KernelAction::None) != (new_action == KernelAction::None)) {
+        /* clang-format off */
+        if (new_action == KernelAction::None) { --m_pending_count; } else { ++m_pending_count; }
+        /* clang-format on */
+    }
+    entry.action = new_action;
+
+    emit dataChanged(index, index, {Qt::CheckStateRole});
+    emit check_state_changed(index.row(), new_state);
+    return true;
+}
+
+auto KernelModel::flags(const QModelIndex& index) const -> Qt::ItemFlags {
+    if (!index.isValid()) {
+        return Qt::NoItemFlags;
+    }
+    auto item_flags = Qt::ItemIsEnabled | Qt::ItemIsSelectable | Qt::ItemNeverHasChildren;
+    if (index.column() == TreeCol::Check) {
+        item_flags |= Qt::ItemIsUserCheckable;
+    }
+    return item_flags;
+}
+
+auto KernelModel::headerData(int section, Qt::Orientation orientation, int role) const -> QVariant {
+    if (orientation != Qt::Horizontal || role != Qt::DisplayRole) {
+        return {};
+    }
+    switch (section) {
+    case TreeCol::Check:
+        return tr("Choose");
+    case TreeCol::PkgName:
+        return tr("PkgName");
+    case TreeCol::Version:
+        return tr("Version");
+    case TreeCol::Category:
+        return tr("Category");
+    default:
+        return {};
+    }
+}
+
+void KernelFilterProxyModel::set_matches(std::optional<search::RowSet>&& matches) noexcept {
+    m_matches = std::move(matches);
+    invalidateFilter();
+}
+
+auto KernelFilterProxyModel::filterAcceptsRow(int source_row, const QModelIndex& /*source_parent*/) const -> bool {
+    /* clang-format off */
+    if (!m_matches) { return true; }
+    /* clang-format on */
+    const auto row = static_cast<std::size_t>(source_row);
+    return row < m_matches->size() && m_matches->test(row);
+}
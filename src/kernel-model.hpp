@@ -0,0 +1,203 @@
+// Copyright (C) 2022-2024 Vladislav Nepogodin
+//
+// This file is part of CachyOS kernel manager.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#ifndef KERNEL_MODEL_HPP_
+#define KERNEL_MODEL_HPP_
+
+#include "kernel-index.hpp"
+#include "kernel.hpp"
+
+#include <cstddef>   // for size_t
+#include <cstdint>   // for int32_t, uint8_t
+#include <optional>  // for optional
+#include <vector>    // for vector
+
+#if defined(__clang__)
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wsign-conversion"
+#pragma clang diagnostic ignored "-Wfloat-conversion"
+#pragma clang diagnostic ignored "-Wdouble-promotion"
+#pragma clang diagnostic ignored "-Wimplicit-int-float-conversion"
+#pragma clang diagnostic ignored "-Wdeprecated-enum-enum-conversion"
+#pragma clang diagnostic ignored "-Wshorten-64-to-32"
+#elif defined(__GNUC__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuseless-cast"
+#pragma GCC diagnostic ignored "-Wsign-conversion"
+#pragma GCC diagnostic ignored "-Wconversion"
+#pragma GCC diagnostic ignored "-Wdeprecated-enum-enum-conversion"
+#pragma GCC diagnostic ignored "-Wsuggest-attribute=pure"
+#pragma GCC diagnostic ignored "-Wsuggest-final-types"
+#pragma GCC diagnostic ignored "-Wsuggest-final-methods"
+#endif
+
+#include <QAbstractItemModel>
+#include <QFont>
+#include <QSortFilterProxyModel>
+#include <QString>
+
+#if defined(__clang__)
+#pragma clang diagnostic pop
+#elif defined(__GNUC__)
+#pragma GCC diagnostic pop
+#endif
+
+namespace TreeCol {
+enum { Check,
+    PkgName,
+    Version,
+    Category,
+    Count };
+}
+
+namespace KernelRole {
+/// Typed roles exposed by KernelModel, instead of string-encoded hidden columns.
+enum : std::int32_t {
+    Installed = Qt::UserRole + 1,
+    Immutable,
+    UpdateAvailable,
+    Repo,
+    CatalogIndex,
+    RepoRank,
+    BestBuild,
+};
+}  // namespace KernelRole
+
+/// Intended change of the catalog row, derived from its check state.
+enum class KernelAction : std::uint8_t {
+    None,
+    Install,
+    Upgrade,
+    Remove,
+};
+
+/// @brief Catalog rows to be passed into the transaction.
+struct TransactionPlan {
+    std::vector<std::size_t> install_rows{};
+    std::vector<std::size_t> remove_rows{};
+
+    /* clang-format off */
+    auto empty() const noexcept -> bool
+    { return install_rows.empty() && remove_rows.empty(); }
+    /* clang-format on */
+};
+
+/// @brief Flat item model over the kernel catalog.
+///
+/// Owns the discovered kernels and a compact per-row cache of the values
+/// shown in the view, so the view never calls into libalpm while painting.
+class KernelModel final : public QAbstractItemModel {
+    Q_OBJECT
+    Q_DISABLE_COPY_MOVE(KernelModel)
+ public:
+    struct Entry {
+        QString name{};
+        QString version{};
+        QString category{};
+        QString repo{};
+        bool installed{};
+        bool immutable{};
+        bool update_available{};
+        /// Rank of the repository build for the host CPU, see build::rank_repo.
+        std::uint8_t repo_rank{};
+        /// Highest ranked of the several builds of the same kernel.
+        bool best_build{};
+        Qt::CheckState check_state{Qt::Unchecked};
+        KernelAction action{KernelAction::None};
+    };
+
+    explicit KernelModel(QObject* parent = nullptr)
+      : QAbstractItemModel(parent) { }
+    ~KernelModel() = default;
+
+    auto index(int row, int column, const QModelIndex& parent = {}) const -> QModelIndex override;
+    auto parent(const QModelIndex& child) const -> QModelIndex override;
+    auto rowCount(const QModelIndex& parent = {}) const -> int override;
+    auto columnCount(const QModelIndex& parent = {}) const -> int override;
+    auto data(const QModelIndex& index, int role = Qt::DisplayRole) const -> QVariant override;
+    auto setData(const QModelIndex& index, const QVariant& value, int role = Qt::EditRole) -> bool override;
+    auto flags(const QModelIndex& index) const -> Qt::ItemFlags override;
+    auto headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const -> QVariant override;
+
+    /// @brief Replaces the whole catalog.
+    void set_kernels(std::vector<Kernel>&& kernels) noexcept;
+
+    /// @brief Appends kernels with the row values prepared by make_entry,
+    /// e.g. off the GUI thread, while the catalog is being discovered.
+    void append_kernels(std::vector<Kernel>&& kernels, std::vector<Entry>&& entries) noexcept;
+
+    /* clang-format off */
+    auto kernels() noexcept -> std::vector<Kernel>&
+    { return m_kernels; }
+
+    auto entry(std::size_t row) const noexcept -> const Entry&
+    { return m_entries[row]; }
+
+    /// @brief Amount of rows with an action pending.
+    constexpr auto pending_count() const noexcept -> std::size_t
+    { return m_pending_count; }
+    /* clang-format on */
+
+    /// @brief Collects rows with an action pending, in catalog order.
+    auto make_transaction_plan() const noexcept -> TransactionPlan;
+
+    /// @brief Returns the values of each row to build search index from.
+    /// NOTE: records are referencing the catalog, and valid until the next reset.
+    auto make_index_records() const noexcept -> std::vector<search::IndexRecord>;
+
+    /// @brief Builds the cached row values for the kernel.
+    static auto make_entry(Kernel& kernel) noexcept -> Entry;
+
+    /// @brief Action implied by the check state of the row.
+    static auto make_action(const Entry& entry) noexcept -> KernelAction;
+
+    /// @brief Highest rank among the builds of the kernel of the row.
+    auto get_best_rank(std::size_t row) const noexcept -> std::uint8_t;
+
+ signals:
+    void check_state_changed(int row, Qt::CheckState state);
+
+ private:
+    /// @brief Marks the best build of each kernel, which is listed from several repositories.
+    void update_best_builds() noexcept;
+
+    std::vector<Kernel> m_kernels{};
+    std::vector<Entry> m_entries{};
+    std::size_t m_pending_count{};
+};
+
+/// @brief Sort/filter proxy, which filters rows by the search index result.
+class KernelFilterProxyModel final : public QSortFilterProxyModel {
+    Q_OBJECT
+    Q_DISABLE_COPY_MOVE(KernelFilterProxyModel)
+ public:
+    explicit KernelFilterProxyModel(QObject* parent = nullptr)
+      : QSortFilterProxyModel(parent) { }
+    ~KernelFilterProxyModel() = default;
+
+    /// @brief Sets rows to be shown, std::nullopt shows all rows.
+    void set_matches(std::optional<search::RowSet>&& matches) noexcept;
+
+ protected:
+    auto filterAcceptsRow(int source_row, const QModelIndex& source_parent) const -> bool override;
+
+ private:
+    std::optional<search::RowSet> m_matches{};
+};
+
+#endif  // KERNEL_MODEL_HPP_
@@ -22,8 +22,9 @@
 
 #include <cstdio>
 
-#include <algorithm>   // for any_of, find_if
+#include <algorithm>   // for any_of, find, find_if
 #include <filesystem>  // for exists
+#include <iterator>    // for make_move_iterator
 #include <ranges>      // for ranges::*
 #include <utility>     // for move
 
@@ -36,20 +37,30 @@ namespace {
 static std::vector<std::string_view> g_aur_kernel_install_list{};  // NOLINT
 #endif
 
-static std::vector<std::string_view> g_kernel_install_list{};                        // NOLINT
-static std::vector<std::string_view> g_kernel_removal_list{};                        // NOLINT
-static const bool is_root_on_zfs = utils::exec("findmnt -ln -o FSTYPE /") == "zfs";  // NOLINT
-
-// NOLINTNEXTLINE
-static const bool is_nvidia_card_prebuild_module = [] {
-    const auto& profile_names = utils::exec("chwd --list-installed -d 2>/dev/null | grep Name | awk '{print $4}'");
-    return std::ranges::any_of(utils::make_split_view(profile_names, '\n'), [](auto&& profile_name) { return profile_name.starts_with("nvidia-dkms"); });
-}();
-// NOLINTNEXTLINE
-static const bool is_nvidia_card_prebuild_open_module = [] {
-    const auto& profile_names = utils::exec("chwd --list-installed -d 2>/dev/null | grep Name | awk '{print $4}'");
-    return std::ranges::any_of(utils::make_split_view(profile_names, '\n'), [](auto&& profile_name) { return profile_name.starts_with("nvidia-open-dkms"); });
-}();
+static std::vector<std::string_view> g_kernel_install_list{};  // NOLINT
+static std::vector<std::string_view> g_kernel_removal_list{};  // NOLINT
+
+// NOTE: these probes spawn processes, evaluate them on first use,
+// instead of during static initialization before the window is shown.
+bool is_root_on_zfs() noexcept {
+    static const bool result = utils::exec("findmnt -ln -o FSTYPE /") == "zfs";
+    return result;
+}
+
+auto get_chwd_installed_profiles() noexcept -> const std::string& {
+    static const std::string profile_names = utils::exec("chwd --list-installed -d 2>/dev/null | grep Name | awk '{print $4}'");
+    return profile_names;
+}
+
+bool is_nvidia_card_prebuild_module() noexcept {
+    static const bool result = std::ranges::any_of(utils::make_split_view(get_chwd_installed_profiles(), '\n'), [](auto&& profile_name) { return profile_name.starts_with("nvidia-dkms"); });
+    return result;
+}
+
+bool is_nvidia_card_prebuild_open_module() noexcept {
+    static const bool result = std::ranges::any_of(utils::make_split_view(get_chwd_installed_profiles(), '\n'), [](auto&& profile_name) { return profile_name.starts_with("nvidia-open-dkms"); });
+    return result;
+}
 
 }  // namespace
 
@@ -95,7 +106,7 @@ bool Kernel::install() const noexcept {
 #endif
     const char* pkg_name    = alpm_pkg_get_name(m_pkg);
     const char* pkg_headers = alpm_pkg_get_name(m_headers);
-    if (is_root_on_zfs && m_zfs_module != nullptr) {
+    if (is_root_on_zfs() && m_zfs_module != nullptr) {
         g_kernel_install_list.emplace_back(alpm_pkg_get_name(m_zfs_module));
     }
 
@@ -114,8 +125,8 @@ bool Kernel::install() const noexcept {
     const bool is_nvidia_modules_installed      = utils::exec("pacman -Qqs '^linux-cachyos' 2>/dev/null | grep -q '\\-nvidia$'; echo $?") == "0";
     const bool is_nvidia_open_modules_installed = utils::exec("pacman -Qqs '^linux-cachyos' 2>/dev/null | grep -q '\\-nvidia-open$'; echo $?") == "0";
 
-    bool should_install_nvidia      = (is_nvidia_card_prebuild_module && m_nvidia_module != nullptr);
-    bool should_install_nvidia_open = (is_nvidia_card_prebuild_open_module && m_nvidia_open_module != nullptr);
+    bool should_install_nvidia      = (is_nvidia_card_prebuild_module() && m_nvidia_module != nullptr);
+    bool should_install_nvidia_open = (is_nvidia_card_prebuild_open_module() && m_nvidia_open_module != nullptr);
 
     if (is_nvidia_open_modules_installed) {
         should_install_nvidia_open = true;
@@ -177,102 +188,126 @@ bool Kernel::remove() const noexcept {
 //    reponame/linux-yyy reponame/linux-yyy-headers
 //    ...
 std::vector<Kernel> Kernel::get_kernels(alpm_handle_t* handle) noexcept {
+    std::vector<Kernel> kernels{};
+
+    auto* dbs = alpm_get_syncdbs(handle);
+    for (alpm_list_t* i = dbs; i != nullptr; i = i->next) {
+        auto&& db_kernels = get_kernels_from_db(handle, reinterpret_cast<alpm_db_t*>(i->data));
+        kernels.insert(kernels.end(), std::make_move_iterator(db_kernels.begin()), std::make_move_iterator(db_kernels.end()));
+    }
+
+#ifdef ENABLE_AUR_KERNELS
+    if (!kernels.empty()) {
+        std::vector<std::string> known_names{};
+        known_names.reserve(kernels.size());
+        for (auto&& kernel : kernels) {
+            known_names.emplace_back(kernel.m_name);
+        }
+        auto&& aur_kernels = get_aur_kernels(handle, known_names);
+        kernels.insert(kernels.end(), std::make_move_iterator(aur_kernels.begin()), std::make_move_iterator(aur_kernels.end()));
+    }
+#endif
+
+    return kernels;
+}
+
+// Kernels of the single sync database, in the same format as Kernel::get_kernels.
+std::vector<Kernel> Kernel::get_kernels_from_db(alpm_handle_t* handle, alpm_db_t* db) noexcept {
     static constexpr std::string_view ignored_pkg  = "linux-api-headers";
     static constexpr std::string_view replace_part = "-headers";
     std::vector<Kernel> kernels{};
 
-    auto* dbs                       = alpm_get_syncdbs(handle);
     [[maybe_unused]] auto* local_db = alpm_get_localdb(handle);
-    for (alpm_list_t* i = dbs; i != nullptr; i = i->next) {
-        static constexpr auto needle = "linux[^ ]*-headers";
-        alpm_list_t* needles         = nullptr;
-        alpm_list_t* ret_list        = nullptr;
-
-        // NOLINTNEXTLINE
-        needles = alpm_list_add(needles, const_cast<void*>(reinterpret_cast<const void*>(needle)));
-
-        auto* db            = reinterpret_cast<alpm_db_t*>(i->data);
-        const char* db_name = alpm_db_get_name(db);
-        alpm_db_search(db, needles, &ret_list);
-
-        for (alpm_list_t* j = ret_list; j != nullptr; j = j->next) {
-            auto* pkg            = reinterpret_cast<alpm_pkg_t*>(j->data);
-            std::string pkg_name = alpm_pkg_get_name(pkg);
-            const auto& found    = std::ranges::search(pkg_name, ignored_pkg);
-            if (!found.empty()) {
-                continue;
-            }
-            alpm_pkg_t* headers = alpm_db_get_pkg(db, pkg_name.c_str());
 
-            utils::remove_all(pkg_name, replace_part);
-            pkg = alpm_db_get_pkg(db, pkg_name.c_str());
+    static constexpr auto needle = "linux[^ ]*-headers";
+    alpm_list_t* needles         = nullptr;
+    alpm_list_t* ret_list        = nullptr;
+
+    // NOLINTNEXTLINE
+    needles = alpm_list_add(needles, const_cast<void*>(reinterpret_cast<const void*>(needle)));
+
+    const char* db_name = alpm_db_get_name(db);
+    alpm_db_search(db, needles, &ret_list);
+
+    for (alpm_list_t* j = ret_list; j != nullptr; j = j->next) {
+        auto* pkg            = reinterpret_cast<alpm_pkg_t*>(j->data);
+        std::string pkg_name = alpm_pkg_get_name(pkg);
+        const auto& found    = std::ranges::search(pkg_name, ignored_pkg);
+        if (!found.empty()) {
+            continue;
+        }
+        alpm_pkg_t* headers = alpm_db_get_pkg(db, pkg_name.c_str());
 
-            // Skip if the actual kernel package is not found
-            /* clang-format off */
-            if (!pkg) { continue; }
-            /* clang-format on */
+        utils::remove_all(pkg_name, replace_part);
+        pkg = alpm_db_get_pkg(db, pkg_name.c_str());
 
-            auto kernel_obj = Kernel{handle, pkg, headers, db_name, fmt::format(FMT_COMPILE("{}/{}"), db_name, pkg_name)};
+        // Skip if the actual kernel package is not found
+        /* clang-format off */
+        if (!pkg) { continue; }
+        /* clang-format on */
+
+        auto kernel_obj = Kernel{handle, pkg, headers, db_name, fmt::format(FMT_COMPILE("{}/{}"), db_name, pkg_name)};
 
 #ifdef HAVE_ALPM_INSTALLED_DB
-            auto* local_pkg = alpm_db_get_pkg(local_db, pkg_name.c_str());
-            if (local_pkg) {
-                const char* pkg_installed_db = alpm_pkg_get_installed_db(local_pkg);
-                if (pkg_installed_db != nullptr) {
-                    kernel_obj.m_installed_db = pkg_installed_db;
-                }
+        auto* local_pkg = alpm_db_get_pkg(local_db, pkg_name.c_str());
+        if (local_pkg) {
+            const char* pkg_installed_db = alpm_pkg_get_installed_db(local_pkg);
+            if (pkg_installed_db != nullptr) {
+                kernel_obj.m_installed_db = pkg_installed_db;
             }
+        }
 #endif
-            if (pkg_name.starts_with("linux-cachyos")) {
-                const auto& zfs_pkgname = fmt::format(FMT_COMPILE("{}-zfs"), pkg_name);
-                kernel_obj.m_zfs_module = alpm_db_get_pkg(db, zfs_pkgname.c_str());
+        if (pkg_name.starts_with("linux-cachyos")) {
+            const auto& zfs_pkgname = fmt::format(FMT_COMPILE("{}-zfs"), pkg_name);
+            kernel_obj.m_zfs_module = alpm_db_get_pkg(db, zfs_pkgname.c_str());
 
-                const auto& nvidia_pkgname = fmt::format(FMT_COMPILE("{}-nvidia"), pkg_name);
-                kernel_obj.m_nvidia_module = alpm_db_get_pkg(db, nvidia_pkgname.c_str());
+            const auto& nvidia_pkgname = fmt::format(FMT_COMPILE("{}-nvidia"), pkg_name);
+            kernel_obj.m_nvidia_module = alpm_db_get_pkg(db, nvidia_pkgname.c_str());
 
-                const auto& nvidia_open_pkgname = fmt::format(FMT_COMPILE("{}-nvidia-open"), pkg_name);
-                kernel_obj.m_nvidia_open_module = alpm_db_get_pkg(db, nvidia_open_pkgname.c_str());
-            }
-
-            kernels.emplace_back(std::move(kernel_obj));
+            const auto& nvidia_open_pkgname = fmt::format(FMT_COMPILE("{}-nvidia-open"), pkg_name);
+            kernel_obj.m_nvidia_open_module = alpm_db_get_pkg(db, nvidia_open_pkgname.c_str());
         }
 
-        alpm_list_free(needles);
-        alpm_list_free(ret_list);
+        kernels.emplace_back(std::move(kernel_obj));
     }
 
+    alpm_list_free(needles);
+    alpm_list_free(ret_list);
+
+    return kernels;
+}
+
+// Kernels available in AUR, skipping the ones already provided by sync databases.
+std::vector<Kernel> Kernel::get_aur_kernels([[maybe_unused]] alpm_handle_t* handle, [[maybe_unused]] std::span<const std::string> known_names) noexcept {
+    std::vector<Kernel> kernels{};
 #ifdef ENABLE_AUR_KERNELS
     namespace fs = std::filesystem;
 
-    bool is_paru_installed{true};
     if (!fs::exists("/sbin/paru") && !fs::exists("/sbin/awk")) {
         fmt::print(stderr, "Paru & AWK are not installed! Disabling AUR kernels support\n");
-        is_paru_installed = false;
+        return kernels;
     }
 
-    if (!kernels.empty() && is_paru_installed) {
-        auto&& aur_kernels_headers = utils::make_multiline(utils::exec("paru --aur -Sl | grep ' linux[^ ]*-headers' | awk '{print $2}'"));
+    auto&& aur_kernels_headers = utils::make_multiline(utils::exec("paru --aur -Sl | grep ' linux[^ ]*-headers' | awk '{print $2}'"));
 
-        for (auto&& aur_kernel_header : aur_kernels_headers) {
-            auto&& aur_kernel = std::string{aur_kernel_header};
-            utils::replace_all(aur_kernel, "-headers", "");
-            if (std::ranges::find_if(kernels, [&](auto& kernel) { return kernel.m_name == aur_kernel; }) != kernels.end()) {
-                continue;
-            }
-            Kernel kernel_obj{};
+    for (auto&& aur_kernel_header : aur_kernels_headers) {
+        auto&& aur_kernel = std::string{aur_kernel_header};
+        utils::replace_all(aur_kernel, "-headers", "");
+        if (std::ranges::find(known_names, aur_kernel) != known_names.end()) {
+            continue;
+        }
+        Kernel kernel_obj{};
 
-            kernel_obj.m_handle       = handle;
-            kernel_obj.m_repo         = "aur";
-            kernel_obj.m_name         = aur_kernel;
-            kernel_obj.m_name_headers = aur_kernel_header;
-            kernel_obj.m_version      = "unknown-version";
-            kernel_obj.m_raw          = fmt::format("aur/{}", aur_kernel);
+        kernel_obj.m_handle       = handle;
+        kernel_obj.m_repo         = "aur";
+        kernel_obj.m_name         = aur_kernel;
+        kernel_obj.m_name_headers = aur_kernel_header;
+        kernel_obj.m_version      = "unknown-version";
+        kernel_obj.m_raw          = fmt::format("aur/{}", aur_kernel);
 
-            kernels.emplace_back(std::move(kernel_obj));
-        }
+        kernels.emplace_back(std::move(kernel_obj));
     }
 #endif
-
     return kernels;
 }
 
@@ -294,6 +329,12 @@ void Kernel::commit_transaction() noexcept {
     }
 }
 
+void Kernel::probe_hardware() noexcept {
+    [[maybe_unused]] const bool root_on_zfs = is_root_on_zfs();
+    [[maybe_unused]] const bool nvidia      = is_nvidia_card_prebuild_module();
+    [[maybe_unused]] const bool nvidia_open = is_nvidia_card_prebuild_open_module();
+}
+
 /** @brief Get global kernel install list
  *  @return Global kernel install list
  */
@@ -21,6 +21,7 @@
 
 #include <algorithm>    // for search
 #include <ranges>       // for ranges::*
+#include <span>         // for span
 #include <string>       // for string
 #include <string_view>  // for string_view
 #include <vector>       // for vector
@@ -92,6 +93,9 @@ class Kernel {
     inline const char* get_raw() const noexcept
     { return m_raw.c_str(); }
 
+    inline std::string_view get_name() const noexcept
+    { return m_name; }
+
     inline std::string_view get_repo() const noexcept
     { return m_repo.c_str(); }
 
@@ -101,7 +105,13 @@ class Kernel {
 
     static void commit_transaction() noexcept;
 
+    /// @brief Evaluates hardware probes used by install(),
+    /// so they can be run ahead of time in the background.
+    static void probe_hardware() noexcept;
+
     static std::vector<Kernel> get_kernels(alpm_handle_t* handle) noexcept;
+    static std::vector<Kernel> get_kernels_from_db(alpm_handle_t* handle, alpm_db_t* db) noexcept;
+    static std::vector<Kernel> get_aur_kernels(alpm_handle_t* handle, std::span<const std::string> known_names) noexcept;
 
     static std::vector<std::string_view>& get_install_list() noexcept;
     static std::vector<std::string_view>& get_removal_list() noexcept;
@@ -20,49 +20,43 @@
 
 #include "km-window.hpp"
 #include "conf-window.hpp"
+#include "cpu_target.hpp"
 #include "kernel.hpp"
+#include "module_profile.hpp"
 #include "utils.hpp"
 
-#include <algorithm>   // for any_of, find_if
+#include <algorithm>   // for any_of
 #include <filesystem>  // for exists
-#include <future>
-#include <ranges>  // for ranges::*
-#include <span>    // for span
-#include <thread>  // for this_thread
+#include <ranges>      // for ranges::*
+#include <span>        // for span
+#include <utility>     // for exchange, move, pair
 
 #include <fmt/core.h>
 
 #include <QCoreApplication>
-#include <QFutureWatcher>
+#include <QHeaderView>
 #include <QMessageBox>
 #include <QScreen>
 #include <QShortcut>
+#include <QStatusBar>
 #include <QTimer>
-#include <QTreeWidgetItem>
-#include <QtConcurrent/QtConcurrent>
 
 namespace fs = std::filesystem;
 
 namespace {
-bool install_packages(alpm_handle_t* handle, const std::span<Kernel>& kernels, const std::span<std::string>& selected_list) {
-    for (const auto& selected : selected_list) {
-        const auto& kernel = std::ranges::find_if(kernels, [selected](auto&& el) { return el.get_raw() == selected; });
-        if ((kernel != kernels.end()) && (!kernel->is_installed() || kernel->is_update_available())) {
-            if (!kernel->install()) {
-                fmt::print(stderr, "failed to add package to be installed ({})\n", alpm_strerror(alpm_errno(handle)));
-            }
+bool install_packages(alpm_handle_t* handle, const std::span<Kernel>& kernels, const std::span<const std::size_t>& rows) {
+    for (auto row : rows) {
+        if (!kernels[row].install()) {
+            fmt::print(stderr, "failed to add package to be installed ({})\n", alpm_strerror(alpm_errno(handle)));
         }
     }
     return true;
 }
 
-bool remove_packages(alpm_handle_t* handle, const std::span<Kernel>& kernels, const std::span<std::string>& selected_list) {
-    for (const auto& selected : selected_list) {
-        const auto& kernel = std::ranges::find_if(kernels, [selected](auto&& el) { return el.get_raw() == selected; });
-        if ((kernel != kernels.end()) && (kernel->is_installed())) {
-            if (!kernel->remove()) {
-                fmt::print(stderr, "failed to add package to be removed ({})\n", alpm_strerror(alpm_errno(handle)));
-            }
+bool remove_packages(alpm_handle_t* handle, const std::span<Kernel>& kernels, const std::span<const std::size_t>& rows) {
+    for (auto row : rows) {
+        if (!kernels[row].remove()) {
+            fmt::print(stderr, "failed to add package to be removed ({})\n", alpm_strerror(alpm_errno(handle)));
         }
     }
 
@@ -85,24 +79,6 @@ bool is_kernels_change_state(alpm_handle_t* handle, std::span<std::string_view>
     return false;
 }
 
-void init_kernels_tree_widget(QTreeWidget* tree_kernels, std::span<Kernel> kernels) noexcept {
-    for (auto& kernel : kernels) {
-        auto* widget_item = new QTreeWidgetItem(tree_kernels);
-        widget_item->setCheckState(TreeCol::Check, Qt::Unchecked);
-        widget_item->setText(TreeCol::PkgName, kernel.get_raw());
-        widget_item->setText(TreeCol::Version, QString::fromStdString(kernel.version()));
-        widget_item->setText(TreeCol::Category, QString::fromStdString(std::string{kernel.category()}));
-        widget_item->setText(TreeCol::Displayed, QStringLiteral("true"));
-        if (kernel.is_installed()) {
-            const std::string_view kernel_installed_db = kernel.get_installed_db();
-            if (!kernel_installed_db.empty() && kernel_installed_db != kernel.get_repo()) {
-                continue;
-            }
-            widget_item->setText(TreeCol::Immutable, QStringLiteral("true"));
-            widget_item->setCheckState(TreeCol::Check, Qt::Checked);
-        }
-    }
-}
 }  // namespace
 
 MainWindow::MainWindow(QWidget* parent)
@@ -112,72 +88,6 @@ MainWindow::MainWindow(QWidget* parent)
     setAttribute(Qt::WA_NativeWindow);
     setWindowFlags(Qt::Window);  // for the close, min and max buttons
 
-    // Create worker thread
-    m_worker = new Work([&]() {
-        while (m_thread_running.load(std::memory_order_consume)) {
-            std::unique_lock<std::mutex> lock(m_mutex);
-            fmt::print(stderr, "Waiting... \n");
-
-            m_cv.wait(lock, [&] { return m_running.load(std::memory_order_consume); });
-
-            if (m_running.load(std::memory_order_consume) && m_thread_running.load(std::memory_order_consume)) {
-                m_ui->ok->setEnabled(false);
-
-                std::vector<std::string> change_list(static_cast<std::size_t>(m_change_list.size()));
-                for (int i = 0; i < m_change_list.size(); ++i) {
-                    change_list[static_cast<std::size_t>(i)] = m_change_list[i].toStdString();
-                }
-
-                install_packages(m_handle, m_kernels, change_list);
-                remove_packages(m_handle, m_kernels, change_list);
-                Kernel::commit_transaction();
-
-                // check if we need to re-init kernels
-                // [1.1]
-                auto& kernel_install_list = Kernel::get_install_list();
-                auto& kernel_removal_list = Kernel::get_removal_list();
-
-                // NOTE: we don't want to override handle, because we would need to invalidate kernels then.
-                auto* temp_handle = utils::parse_alpm("/", "/var/lib/pacman/", &m_err);
-                if (temp_handle == nullptr) {
-                    QMessageBox::critical(this, "CachyOS Kernel Manager", tr("Failed to initialize alpm handle (%1)").arg(alpm_strerror(m_err)));
-                }
-
-                // [1.2]
-                // iterate over install and removal lists and check if any of the packages
-                // in the lists were either installed or removed
-                const bool is_kernel_status_changed = is_kernels_change_state(temp_handle, std::span{kernel_install_list}, std::span{kernel_removal_list});
-
-                // [1.3]
-                // if kernel status has changed, then re-init alpm handler,
-                // fetch kernels and repopulate tree widget again
-                if (is_kernel_status_changed) {
-                    if (m_handle != nullptr && utils::release_alpm(m_handle, &m_err) != 0) {
-                        QMessageBox::critical(this, "CachyOS Kernel Manager", tr("Failed to release alpm handle (%1)").arg(alpm_strerror(m_err)));
-                    }
-
-                    m_handle = temp_handle;
-                    m_kernels.clear();
-                    m_kernels = Kernel::get_kernels(m_handle);
-
-                    // schedule init_kernels to be executed in the main thread
-                    QMetaObject::invokeMethod(this, "init_kernels", Qt::QueuedConnection);
-                }
-
-                // clear install and removal lists
-                kernel_install_list.clear();
-                kernel_removal_list.clear();
-
-                m_running.store(false, std::memory_order_relaxed);
-                m_ui->ok->setEnabled(!is_kernel_status_changed);
-            }
-        }
-    });
-
-    m_worker->moveToThread(m_worker_th);
-    // name to appear in ps, task manager, etc.
-    m_worker_th->setObjectName("WorkerThread");
-
     m_ui->ok->setEnabled(false);
 
     // Hide sched-ext button in case we are not on kernel with sched-ext
@@ -189,43 +99,42 @@ MainWindow::MainWindow(QWidget* parent)
     set_progress_dialog();
 
     // Setup configure window
-    connect(&m_future_watcher, &QFutureWatcher<void>::finished, this, [&]() {
-        m_conf_progress_dialog->hide();
-        if (m_future_watcher.future().isCanceled()) {
-            return;
-        }
-        if (m_future_watcher.future().isFinished()) {
-            m_conf_window->show();
-            return;
-        }
-        QMessageBox::critical(this, "CachyOS Kernel Manager", tr("Failed to clone repository!\nPlease check your internet connection and try again"));
-    });
-    connect(m_conf_progress_dialog, &QProgressDialog::canceled, this, [&]() {
+    connect(m_conf_progress_dialog, &QProgressDialog::canceled, this, [this]() {
         fmt::print("the operation was canceled!\n");
-        // that doesn't really stop execution, it just hides the progress dialog
-        m_future_watcher.cancel();
+        // NOTE: cloning itself can't be interrupted, but its result is dropped
+        m_executor.cancel(m_configure_job);
     });
+    // NOTE: the canceled job still winds down, the button is enabled again only once it has finished.
+    connect(&m_executor, &TaskExecutor::job_finished, this, [this](TaskExecutor::job_id_t job_id, bool) {
+        if (job_id == m_configure_job) {
+            m_ui->configure->setEnabled(true);
+        }
+    });
+
+    // Probe hardware, used to pick kernel modules, while the user is browsing
+    m_executor.run(TaskExecutor::Lane::Pool, [](std::stop_token) { Kernel::probe_hardware(); });
+
+    // Sample the loaded modules for localmodconfig, also without the collector service
+    m_executor.run(TaskExecutor::Lane::Pool, [](std::stop_token) { build::collect_loaded_modules(build::get_module_profile_path()); });
 
-    // Setup tree widget
+    // Setup tree view
     auto* tree_kernels = m_ui->treeKernels;
-    tree_kernels->hideColumn(TreeCol::Displayed);  // Displayed status true/false
-    tree_kernels->hideColumn(TreeCol::Immutable);  // Immutable status true/false
-    tree_kernels->header()->setSectionResizeMode(QHeaderView::ResizeToContents);
+    m_proxy_model->setSourceModel(m_kernel_model);
+    tree_kernels->setModel(m_proxy_model);
+    tree_kernels->setSortingEnabled(true);
+    tree_kernels->header()->setSortIndicator(-1, Qt::AscendingOrder);  // keep catalog order until the user sorts
+
+    // NOTE: ResizeToContents measures every row on each layout pass,
+    // instead size columns once and only sample a limited amount of rows.
+    tree_kernels->header()->setSectionResizeMode(QHeaderView::Interactive);
+    tree_kernels->header()->setResizeContentsPrecision(100);
+    tree_kernels->header()->setStretchLastSection(true);
 
     // Set context menu policy
     tree_kernels->setContextMenuPolicy(Qt::CustomContextMenu);
 
-    tree_kernels->blockSignals(true);
-
-    // TODO(vnepogodin): parallelize it
-    auto a2 = std::async(std::launch::deferred, [&] {
-        const std::lock_guard<std::mutex> guard(m_mutex);
-        init_kernels_tree_widget(tree_kernels, std::span{m_kernels});
-    });
-
-    if (m_kernels.empty()) {
-        QMessageBox::critical(this, "CachyOS Kernel Manager", tr("No kernels found!\nPlease run `pacman -Sy` to update DB!\nThis is needed for the app to work properly"));
-    }
+    // Discover kernels in the background, window is shown right away
+    load_kernels();
 
     // Connect buttons signal
     connect(m_ui->cancel, &QPushButton::clicked, this, &MainWindow::on_cancel);
@@ -233,29 +142,20 @@ MainWindow::MainWindow(QWidget* parent)
     connect(m_ui->configure, &QPushButton::clicked, this, &MainWindow::on_configure);
     connect(m_ui->schedext, &QPushButton::clicked, this, &MainWindow::on_schedext_config);
 
-    // Connect worker thread signals
-    connect(m_worker_th, &QThread::finished, m_worker, &QObject::deleteLater);
-    connect(m_worker_th, &QThread::started, m_worker, &Work::doHeavyCalculations, Qt::QueuedConnection);
-
     // check/uncheck tree items space-bar press or double-click
     auto* shortcutToggle = new QShortcut(Qt::Key_Space, this);
     connect(shortcutToggle, &QShortcut::activated, this, &MainWindow::check_uncheck_item);
 
-    // Connect tree widget
-    connect(tree_kernels, &QTreeWidget::itemChanged, this, &MainWindow::item_changed);
-    connect(tree_kernels, &QTreeWidget::itemDoubleClicked, [tree_kernels](QTreeWidgetItem* item) { tree_kernels->setCurrentItem(item); });
-    connect(tree_kernels, &QTreeWidget::itemDoubleClicked, this, &MainWindow::check_uncheck_item);
-
-    // Wait for async function to finish
-    a2.wait();
-    tree_kernels->blockSignals(false);
+    // Connect tree view
+    connect(m_kernel_model, &KernelModel::check_state_changed, this, &MainWindow::item_changed);
+    connect(m_ui->searchEdit, &QLineEdit::textChanged, this, &MainWindow::on_search_changed);
+    connect(tree_kernels, &QTreeView::doubleClicked, [tree_kernels](const QModelIndex& index) { tree_kernels->setCurrentIndex(index); });
+    connect(tree_kernels, &QTreeView::doubleClicked, this, &MainWindow::check_uncheck_item);
 }
 
 MainWindow::~MainWindow() {
-    std::this_thread::sleep_for(std::chrono::milliseconds(1));
-    if (m_worker_th != nullptr) {
-        m_worker_th->exit();
-    }
+    m_executor.cancel_all();
+    m_executor.wait_for_done();
 }
 
 // Setup progress dialog
@@ -281,108 +181,279 @@ void MainWindow::set_progress_dialog() noexcept {
 }
 
 void MainWindow::check_uncheck_item() noexcept {
-    if (auto* t_widget = qobject_cast<QTreeWidget*>(focusWidget())) {
-        if (t_widget->currentItem() == nullptr || t_widget->currentItem()->childCount() > 0) {
+    if (auto* t_view = qobject_cast<QTreeView*>(focusWidget())) {
+        const auto& current_index = t_view->currentIndex();
+        if (!current_index.isValid()) {
             return;
         }
-        auto new_state = (t_widget->currentItem()->checkState(TreeCol::Check) == Qt::Checked) ? Qt::Unchecked : Qt::Checked;
-        t_widget->currentItem()->setCheckState(TreeCol::Check, new_state);
+        const auto& check_index = current_index.siblingAtColumn(TreeCol::Check);
+        auto new_state          = (check_index.data(Qt::CheckStateRole).toInt() == Qt::Checked) ? Qt::Unchecked : Qt::Checked;
+        t_view->model()->setData(check_index, new_state, Qt::CheckStateRole);
     }
 }
 
 // When selecting on item in the list
-void MainWindow::item_changed(QTreeWidgetItem* item, int /*unused*/) noexcept {
-    if (item->checkState(TreeCol::Check) == Qt::Checked) {
-        m_ui->treeKernels->setCurrentItem(item);
+void MainWindow::item_changed(int row, Qt::CheckState state) noexcept {
+    if (state == Qt::Checked) {
+        const auto& source_index = m_kernel_model->index(row, TreeCol::PkgName);
+        m_ui->treeKernels->setCurrentIndex(m_proxy_model->mapFromSource(source_index));
     }
-    build_change_list(item);
+    m_ui->ok->setEnabled(m_kernel_model->pending_count() > 0);
 }
 
-// Build the change_list when selecting on item in the tree
-void MainWindow::build_change_list(QTreeWidgetItem* item) noexcept {
-    auto item_text = item->text(TreeCol::PkgName);
-    auto immutable = item->text(TreeCol::Immutable);
-    if (immutable == "true" && item->checkState(0) == Qt::Unchecked) {
-        m_ui->ok->setEnabled(true);
-        m_change_list.append(item_text);
-        return;
-    }
-
-    if (immutable == "true" && item->checkState(0) == Qt::Checked) {
-        m_change_list.removeOne(item_text);
-    } else if (item->checkState(0) == Qt::Checked) {
-        m_ui->ok->setEnabled(true);
-        m_change_list.append(item_text);
-    } else {
-        m_change_list.removeOne(item_text);
-    }
-
-    if (m_change_list.isEmpty()) {
-        m_ui->ok->setEnabled(false);
-    }
+void MainWindow::on_search_changed(const QString& text) noexcept {
+    m_proxy_model->set_matches(m_kernel_index.query(text.trimmed().toStdString()));
 }
 
 void MainWindow::closeEvent(QCloseEvent* event) {
-    // Exit worker thread
-    m_running.store(true, std::memory_order_relaxed);
-    m_thread_running.store(false, std::memory_order_relaxed);
-    m_cv.notify_all();
+    // NOTE: background jobs are using the handle
+    m_executor.cancel_all();
+    m_executor.wait_for_done();
 
     // Release libalpm handle
-    alpm_release(m_handle);
+    if (m_handle != nullptr) {
+        alpm_release(m_handle);
+        m_handle = nullptr;
+    }
 
     // Execute parent function
     QWidget::closeEvent(event);
 }
 
 void MainWindow::on_configure() noexcept {
+    if (!m_conf_window) {
+        m_conf_window = std::make_unique<ConfWindow>(m_executor);
+    }
+    /* clang-format off */
+    if (m_executor.is_running(m_configure_job)) { return; }
+    /* clang-format on */
+
     // show progress dialog to indicate user something is happening
     m_conf_progress_dialog->setLabelText(tr("Please wait...\nWe are preparing configuration window for you\ncloning PKGBUILDs.."));
     m_conf_progress_dialog->show();
+    m_ui->configure->setEnabled(false);
 
-    // NOTE: the future created by QtConcurrent::run is not cancelable.
     // prepare in the background, without blocking the UI
-    m_future_watcher.setFuture(QtConcurrent::run([this] {
-        utils::prepare_build_environment();
-        m_conf_window->reset_patches_data_tab();
-    }));
+    m_configure_job = m_executor.run(
+        TaskExecutor::Lane::Pool, this,
+        [](std::stop_token) {
+            utils::prepare_build_environment();
+            return fs::exists(utils::fix_path("~/.cache/cachyos-km/pkgbuilds/.git"));
+        },
+        [this](bool is_prepared) { on_configure_finished(is_prepared); });
+}
+
+void MainWindow::on_configure_finished(bool is_prepared) noexcept {
+    m_conf_progress_dialog->hide();
+    if (!is_prepared) {
+        QMessageBox::critical(this, "CachyOS Kernel Manager", tr("Failed to clone repository!\nPlease check your internet connection and try again"));
+        return;
+    }
+
+    // NOTE: the patches tab is filled in the background, once PKGBUILD is evaluated.
+    m_conf_window->reset_patches_data_tab();
+    m_conf_window->show();
 }
 
 void MainWindow::on_cancel() noexcept {
     close();
 }
 
-void Work::doHeavyCalculations() {
-    m_func();
+void MainWindow::load_kernels() noexcept {
+    statusBar()->showMessage(tr("Loading kernels.."));
+    m_loading = true;
+
+    // NOTE: m_handle and m_err are only written by the loader,
+    // the GUI thread uses them after loading has finished.
+    const auto& load_job = [this](std::stop_token stop_token) {
+        m_handle = utils::parse_alpm("/", "/var/lib/pacman/", &m_err);
+        if (m_handle == nullptr) {
+            return;
+        }
+
+        // row values are prepared here, so the GUI thread only inserts them
+        const auto& post_kernels = [this](std::vector<Kernel>&& kernels) {
+            /* clang-format off */
+            if (kernels.empty()) { return; }
+            /* clang-format on */
+            std::vector<KernelModel::Entry> entries{};
+            entries.reserve(kernels.size());
+            for (auto& kernel : kernels) {
+                entries.emplace_back(KernelModel::make_entry(kernel));
+            }
+            auto batch = std::make_shared<std::pair<std::vector<Kernel>, std::vector<KernelModel::Entry>>>(std::move(kernels), std::move(entries));
+            QMetaObject::invokeMethod(this, [this, batch] { append_kernels(std::move(batch->first), std::move(batch->second)); }, Qt::QueuedConnection);
+        };
+
+        // stream the catalog into the view by repository, as each one is searched
+        std::vector<std::string> known_names{};
+        auto* dbs = alpm_get_syncdbs(m_handle);
+        for (alpm_list_t* i = dbs; i != nullptr && !stop_token.stop_requested(); i = i->next) {
+            auto&& kernels = Kernel::get_kernels_from_db(m_handle, reinterpret_cast<alpm_db_t*>(i->data));
+            for (auto&& kernel : kernels) {
+                known_names.emplace_back(kernel.get_name());
+            }
+            post_kernels(std::move(kernels));
+        }
+        if (!known_names.empty() && !stop_token.stop_requested()) {
+            post_kernels(Kernel::get_aur_kernels(m_handle, known_names));
+        }
+    };
+    m_executor.run(TaskExecutor::Lane::Pool, this, load_job, [this] { on_kernels_loaded(); });
 }
 
-void MainWindow::init_kernels() noexcept {
+void MainWindow::on_kernels_loaded() noexcept {
+    statusBar()->clearMessage();
+    m_loading = false;
+
+    if (m_handle == nullptr) {
+        QMessageBox::critical(this, "CachyOS Kernel Manager", tr("Failed to initialize alpm handle (%1)").arg(alpm_strerror(m_err)));
+        return;
+    }
+    if (m_kernel_model->rowCount() == 0) {
+        QMessageBox::critical(this, "CachyOS Kernel Manager", tr("No kernels found!\nPlease run `pacman -Sy` to update DB!\nThis is needed for the app to work properly"));
+    }
+}
+
+void MainWindow::append_kernels(std::vector<Kernel>&& kernels, std::vector<KernelModel::Entry>&& entries) noexcept {
+    m_kernel_model->append_kernels(std::move(kernels), std::move(entries));
+    refresh_kernels_view();
+}
+
+void MainWindow::init_kernels(std::vector<Kernel>&& kernels) noexcept {
     // show progress dialog to indicate user something is happening
     m_conf_progress_dialog->setLabelText(tr("Please wait...\nInitializing kernels.."));
     m_conf_progress_dialog->show();
 
-    auto* tree_kernels = m_ui->treeKernels;
-    tree_kernels->blockSignals(true);
-    tree_kernels->clear();
+    init_kernels_view(std::move(kernels));
 
-    // NOTE: I don't think this should be parallelized, because it's already not running on the main thread
-    init_kernels_tree_widget(tree_kernels, std::span{m_kernels});
-
-    tree_kernels->blockSignals(false);
     m_conf_progress_dialog->hide();
 }
 
+void MainWindow::init_kernels_view(std::vector<Kernel>&& kernels) noexcept {
+    m_kernel_model->set_kernels(std::move(kernels));
+    refresh_kernels_view();
+}
+
+void MainWindow::refresh_kernels_view() noexcept {
+    // rebuild search index over the new catalog and re-apply current filter
+    m_kernel_index.build(m_kernel_model->make_index_records());
+    on_search_changed(m_ui->searchEdit->text());
+
+    auto* tree_kernels = m_ui->treeKernels;
+    for (int column = TreeCol::Check; column < TreeCol::Category; ++column) {
+        tree_kernels->resizeColumnToContents(column);
+    }
+}
+
 void MainWindow::on_execute() noexcept {
-    if (m_running.load(std::memory_order_consume)) {
+    if (m_transaction_running || m_loading) {
         return;
     }
-    m_running.store(true, std::memory_order_relaxed);
-    m_thread_running.store(true, std::memory_order_relaxed);
-    m_cv.notify_all();
-    m_worker_th->start();
+    // snapshot of the pending rows, the job must not read the model state
+    auto plan = m_kernel_model->make_transaction_plan();
+    /* clang-format off */
+    if (plan.empty()) { return; }
+    if (!confirm_generic_builds(plan)) { return; }
+    /* clang-format on */
+
+    m_transaction_running = true;
+    m_ui->ok->setEnabled(false);
+
+    // NOTE: the catalog isn't modified while the transaction is running,
+    // the job reads the kernels and the handle.
+    m_executor.run(
+        TaskExecutor::Lane::Serial, this,
+        [this, plan = std::move(plan)](std::stop_token) { return run_transaction(plan); },
+        [this](TransactionResult&& result) { on_transaction_finished(std::move(result)); });
+}
+
+auto MainWindow::confirm_generic_builds(const TransactionPlan& plan) noexcept -> bool {
+    const auto isa_level = build::detect_isa_level();
+    /* clang-format off */
+    if (isa_level < 3) { return true; }
+    /* clang-format on */
+
+    // generic x86-64 builds, while the optimized build of the same kernel is listed
+    QStringList generic_builds{};
+    for (auto&& row : plan.install_rows) {
+        const auto& entry = m_kernel_model->entry(row);
+        if (entry.repo_rank == 1 && m_kernel_model->get_best_rank(row) > 1) {
+            generic_builds << entry.name;
+        }
+    }
+    /* clang-format off */
+    if (generic_builds.isEmpty()) { return true; }
+    /* clang-format on */
+
+    const auto answer = QMessageBox::warning(this, "CachyOS Kernel Manager",
+        tr("Your CPU supports x86-64-v%1, but generic x86-64 builds are selected:\n%2\n\nThe builds marked in bold are optimized for your CPU.\nDo you want to continue anyway?")
+            .arg(isa_level)
+            .arg(generic_builds.join('\n')),
+        QMessageBox::Yes | QMessageBox::No, QMessageBox::No);
+    return answer == QMessageBox::Yes;
+}
+
+auto MainWindow::run_transaction(const TransactionPlan& plan) noexcept -> TransactionResult {
+    install_packages(m_handle, m_kernel_model->kernels(), plan.install_rows);
+    remove_packages(m_handle, m_kernel_model->kernels(), plan.remove_rows);
+    Kernel::commit_transaction();
+
+    // check if we need to re-init kernels
+    // [1.1]
+    auto& kernel_install_list = Kernel::get_install_list();
+    auto& kernel_removal_list = Kernel::get_removal_list();
+
+    // NOTE: we don't want to override handle, because we would need to invalidate kernels then.
+    TransactionResult result{};
+    result.handle           = utils::parse_alpm("/", "/var/lib/pacman/", &result.err);
+    result.is_handle_failed = (result.handle == nullptr);
+
+    // [1.2]
+    // iterate over install and removal lists and check if any of the packages
+    // in the lists were either installed or removed
+    result.is_kernel_status_changed = is_kernels_change_state(result.handle, std::span{kernel_install_list}, std::span{kernel_removal_list});
+
+    // [1.3]
+    // if kernel status has changed, then fetch kernels with the new handle,
+    // the GUI thread swaps the handles and repopulates the tree.
+    if (result.is_kernel_status_changed) {
+        result.kernels = Kernel::get_kernels(result.handle);
+    } else if (result.handle != nullptr) {
+        utils::release_alpm(result.handle, &result.err);
+        result.handle = nullptr;
+    }
+
+    // clear install and removal lists
+    kernel_install_list.clear();
+    kernel_removal_list.clear();
+
+    return result;
+}
+
+void MainWindow::on_transaction_finished(TransactionResult&& result) noexcept {
+    m_transaction_running = false;
+
+    if (result.is_handle_failed) {
+        QMessageBox::critical(this, "CachyOS Kernel Manager", tr("Failed to initialize alpm handle (%1)").arg(alpm_strerror(result.err)));
+    }
+
+    if (result.is_kernel_status_changed) {
+        auto* old_handle = std::exchange(m_handle, result.handle);
+        init_kernels(std::move(result.kernels));
+
+        // NOTE: release after the old kernels were replaced, they reference the old handle.
+        if (old_handle != nullptr && utils::release_alpm(old_handle, &m_err) != 0) {
+            QMessageBox::critical(this, "CachyOS Kernel Manager", tr("Failed to release alpm handle (%1)").arg(alpm_strerror(m_err)));
+        }
+    }
+    m_ui->ok->setEnabled(m_kernel_model->pending_count() > 0);
 }
 
 void MainWindow::on_schedext_config() noexcept {
+    if (!m_sched_window) {
+        m_sched_window = std::make_unique<SchedExtWindow>();
+    }
     m_sched_window->show();
 }
 
@@ -41,24 +41,23 @@
 #include <ui_km-window.h>
 
 #include "conf-window.hpp"
+#include "kernel-index.hpp"
+#include "kernel-model.hpp"
 #include "kernel.hpp"
 #include "schedext-window.hpp"
+#include "task-executor.hpp"
 #include "utils.hpp"
 
 #include <array>
-#include <condition_variable>
 #include <memory>
-#include <thread>
 #include <utility>
 #include <vector>
 
 #include <alpm.h>
 
-#include <QFutureWatcher>
 #include <QMainWindow>
 #include <QProgressBar>
 #include <QProgressDialog>
-#include <QThread>
 #include <QTimer>
 
 #if defined(__clang__)
@@ -67,31 +66,6 @@
 #pragma GCC diagnostic pop
 #endif
 
-class Work final : public QObject {
-    Q_OBJECT
-
- public:
-    using function_t = std::function<void()>;
-    explicit Work(function_t&& func)
-      : m_func(std::move(func)) { }
-    ~Work() = default;
-
- public:
-    void doHeavyCalculations();
-
- private:
-    function_t m_func;
-};
-
-namespace TreeCol {
-enum { Check,
-    PkgName,
-    Version,
-    Category,
-    Displayed,
-    Immutable };
-}
-
 class MainWindow final : public QMainWindow {
     Q_OBJECT
     Q_DISABLE_COPY_MOVE(MainWindow)
@@ -107,35 +81,54 @@ class MainWindow final : public QMainWindow {
     void on_execute() noexcept;
     void on_schedext_config() noexcept;
     void on_configure() noexcept;
+    void on_configure_finished(bool is_prepared) noexcept;
 
     void check_uncheck_item() noexcept;
 
-    void item_changed(QTreeWidgetItem* item, int column) noexcept;
-
-    void init_kernels() noexcept;
-
-    std::atomic_bool m_running{};
-    std::atomic_bool m_thread_running{true};
-    std::mutex m_mutex{};
-    std::condition_variable m_cv{};
-
-    QStringList m_change_list{};
+    void item_changed(int row, Qt::CheckState state) noexcept;
+    void on_search_changed(const QString& text) noexcept;
+
+    void load_kernels() noexcept;
+    void on_kernels_loaded() noexcept;
+    void append_kernels(std::vector<Kernel>&& kernels, std::vector<KernelModel::Entry>&& entries) noexcept;
+    void init_kernels(std::vector<Kernel>&& kernels) noexcept;
+    void init_kernels_view(std::vector<Kernel>&& kernels) noexcept;
+    void refresh_kernels_view() noexcept;
+
+    /// Outcome of the pacman transaction, produced on the serial lane.
+    struct TransactionResult {
+        alpm_handle_t* handle{nullptr};
+        alpm_errno_t err{};
+        bool is_handle_failed{};
+        bool is_kernel_status_changed{};
+        std::vector<Kernel> kernels{};
+    };
+    /// Asks before installing generic builds, if the builds optimized for the CPU are listed.
+    auto confirm_generic_builds(const TransactionPlan& plan) noexcept -> bool;
+    auto run_transaction(const TransactionPlan& plan) noexcept -> TransactionResult;
+    void on_transaction_finished(TransactionResult&& result) noexcept;
+
+    bool m_loading{};
+    bool m_transaction_running{};
+    TaskExecutor::job_id_t m_configure_job{};
 
     QProgressDialog* m_conf_progress_dialog{nullptr};
     QProgressBar* m_conf_progress_bar{nullptr};
-    QFutureWatcher<void> m_future_watcher{};
-
-    QThread* m_worker_th = new QThread(this);
-    Work* m_worker{nullptr};
 
     alpm_errno_t m_err{};
-    alpm_handle_t* m_handle                        = utils::parse_alpm("/", "/var/lib/pacman/", &m_err);
-    std::vector<Kernel> m_kernels                  = Kernel::get_kernels(m_handle);
-    std::unique_ptr<Ui::MainWindow> m_ui           = std::make_unique<Ui::MainWindow>();
-    std::unique_ptr<ConfWindow> m_conf_window      = std::make_unique<ConfWindow>();
-    std::unique_ptr<SchedExtWindow> m_sched_window = std::make_unique<SchedExtWindow>();
+    alpm_handle_t* m_handle{nullptr};
+    KernelModel* m_kernel_model           = new KernelModel(this);
+    KernelFilterProxyModel* m_proxy_model = new KernelFilterProxyModel(this);
+    search::KernelIndex m_kernel_index{};
+    std::unique_ptr<Ui::MainWindow> m_ui = std::make_unique<Ui::MainWindow>();
+
+    // NOTE: secondary windows are created on first open.
+    std::unique_ptr<ConfWindow> m_conf_window{};
+    std::unique_ptr<SchedExtWindow> m_sched_window{};
+
+    // NOTE: declared last, so it's destroyed (waiting for the jobs) before the state jobs are using.
+    TaskExecutor m_executor{};
 
-    void build_change_list(QTreeWidgetItem* item) noexcept;
     void set_progress_dialog() noexcept;
 };
 
@@ -16,9 +16,18 @@
 // with this program; if not, write to the Free Software Foundation, Inc.,
 // 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
 
+#include "batch_build.hpp"
 #include "km-window.hpp"
+#include "module_profile.hpp"
+
+#include <algorithm>    // for any_of
+#include <chrono>       // for seconds
+#include <cstdio>       // for fflush
+#include <string_view>  // for string_view
+#include <thread>       // for sleep_for
 
 #include <QApplication>
+#include <QCommandLineParser>
 #include <QSharedMemory>
 #include <QTranslator>
 
@@ -40,6 +49,8 @@
 #pragma GCC diagnostic pop
 #endif
 
+#include <fmt/core.h>
+
 namespace {
 
 bool IsInstanceAlreadyRunning(QSharedMemory& memoryLock) noexcept {
@@ -105,9 +116,93 @@ void initTranslations(QTranslator& qtTranslatorBase, QTranslator& qtTranslator,
     }
 }
 
+auto has_option(int argc, char** argv, std::string_view option_name) noexcept -> bool {
+    return std::any_of(argv + 1, argv + argc, [option_name](std::string_view arg) { return arg.starts_with(option_name); });
+}
+
+// e.g. cachyos-kernel-manager --batch-build linux-cachyos --config lto.toml --config gcc.toml
+auto run_batch_build(const QCoreApplication& app) noexcept -> std::int32_t {
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Builds the kernel once per each saved configuration, without the interface.");
+    parser.addHelpOption();
+
+    const QCommandLineOption variant_option("batch-build", "Kernel variant, e.g. linux-cachyos-bore.", "variant");
+    const QCommandLineOption config_option("config", "Saved configuration, can be repeated.", "file");
+    const QCommandLineOption patch_option("patch", "Patch to apply, can be repeated.", "patch");
+    const QCommandLineOption output_option("output", "Directory for the built packages.", "dir", "packages");
+    const QCommandLineOption compression_option("compression", "Compression of the packages: default (as in makepkg.conf), fast or none.", "mode", "default");
+    parser.addOptions({variant_option, config_option, patch_option, output_option, compression_option});
+    parser.process(app);
+
+    const auto& config_files = parser.values(config_option);
+    if (config_files.isEmpty()) {
+        fmt::print(stderr, "At least one --config is required\n");
+        return 2;
+    }
+
+    build::BatchBuildArgs args{.variant = parser.value(variant_option).toStdString(), .output_dir = parser.value(output_option).toStdString()};
+    const auto& compression = parser.value(compression_option);
+    if (compression == "fast") {
+        args.compression = build::PackageCompression::Fast;
+    } else if (compression == "none") {
+        args.compression = build::PackageCompression::None;
+    } else if (compression != "default") {
+        fmt::print(stderr, "Unknown compression: {}\n", compression.toStdString());
+        return 2;
+    }
+    for (const auto& config_file : config_files) {
+        args.config_files.emplace_back(config_file.toStdString());
+    }
+    for (const auto& patch : parser.values(patch_option)) {
+        args.patches.emplace_back(patch.toStdString());
+    }
+    return build::run_batch_build(args);
+}
+
+// e.g. cachyos-kernel-manager --collect-modules, run by cachyos-km-modules.service
+auto run_module_collector(const QCoreApplication& app) noexcept -> std::int32_t {
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Collects the loaded kernel modules for the builds with localmodconfig.");
+    parser.addHelpOption();
+
+    const QCommandLineOption collect_option("collect-modules", "Samples the loaded modules periodically.");
+    const QCommandLineOption interval_option("interval", "Seconds between the samples.", "seconds", "300");
+    const QCommandLineOption once_option("once", "Takes a single sample and prints the report.");
+    parser.addOptions({collect_option, interval_option, once_option});
+    parser.process(app);
+
+    bool is_valid_interval{};
+    const auto interval = parser.value(interval_option).toUInt(&is_valid_interval);
+    if (!is_valid_interval || interval == 0) {
+        fmt::print(stderr, "Invalid interval: {}\n", parser.value(interval_option).toStdString());
+        return 2;
+    }
+
+    // NOTE: reading /proc/modules is cheap, the profile is only written when new modules appear.
+    const auto& profile_path = build::get_module_profile_path();
+    const auto& modules_dir  = build::get_running_modules_dir();
+    while (true) {
+        if (build::collect_loaded_modules(profile_path) > 0 || parser.isSet(once_option)) {
+            const auto& profile = build::load_module_profile(profile_path);
+            fmt::print("{}\n", build::make_module_report(profile, build::estimate_module_reduction(profile, modules_dir)));
+            std::fflush(stdout);
+        }
+        /* clang-format off */
+        if (parser.isSet(once_option)) { return 0; }
+        /* clang-format on */
+        std::this_thread::sleep_for(std::chrono::seconds{interval});
+    }
+}
+
 }  // namespace
 
 auto main(int argc, char** argv) -> std::int32_t {
+    // The collector runs in the background along with the manager.
+    if (has_option(argc, argv, "--collect-modules")) {
+        const QCoreApplication app(argc, argv);
+        return run_module_collector(app);
+    }
+
     QSharedMemory sharedMemoryLock("CachyOS-KM-lock");
     if (IsInstanceAlreadyRunning(sharedMemoryLock)) {
         return -1;
@@ -125,6 +220,12 @@ auto main(int argc, char** argv) -> std::int32_t {
     QApplication::setOrganizationDomain("cachyos.org");
     QApplication::setApplicationName("CachyOS-KM");
 
+    // Headless build doesn't need the display.
+    if (has_option(argc, argv, "--batch-build")) {
+        const QCoreApplication app(argc, argv);
+        return run_batch_build(app);
+    }
+
     // Set application attributes
     const QApplication app(argc, argv);
 
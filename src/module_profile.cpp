@@ -0,0 +1,218 @@
+// Copyright (C) 2022-2024 Vladislav Nepogodin
+//
+// This file is part of CachyOS kernel manager.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include "module_profile.hpp"
+#include "utils.hpp"
+
+#include <algorithm>     // for replace
+#include <array>         // for array
+#include <charconv>      // for from_chars
+#include <ctime>         // for time
+#include <filesystem>    // for path, directory_iterator, file_size, rename
+#include <system_error>  // for error_code
+
+#include <fmt/compile.h>
+#include <fmt/core.h>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+constexpr std::string_view since_prefix = "since=";
+
+// NOTE: the collector and the manager can write the profile at the same time,
+// the last one wins, but the file is never half written.
+auto write_file_atomically(std::string_view filepath, std::string_view data) noexcept -> bool {
+    const auto& temp_path = fmt::format(FMT_COMPILE("{}.tmp"), filepath);
+    std::error_code err_code{};
+    fs::create_directories(fs::path{filepath}.parent_path(), err_code);
+    /* clang-format off */
+    if (!utils::write_to_file(temp_path, data)) { return false; }
+    /* clang-format on */
+    fs::rename(temp_path, filepath, err_code);
+    if (err_code) {
+        fmt::print(stderr, "Failed to write {}: {}\n", filepath, err_code.message());
+        return false;
+    }
+    return true;
+}
+
+// modules.order has the paths, e.g. "kernel/drivers/net/wireless/intel/iwlwifi/iwlwifi.ko",
+// while lsmod shows "iwlwifi", with underscores instead of dashes.
+auto get_module_name(std::string_view module_path) noexcept -> std::string {
+    module_path = module_path.substr(module_path.rfind('/') + 1);
+    module_path = module_path.substr(0, module_path.find(".ko"));
+    std::string module_name{module_path};
+    std::ranges::replace(module_name, '-', '_');
+    return module_name;
+}
+
+// installed modules are compressed, e.g. iwlwifi.ko.zst
+auto get_module_file_size(std::string_view modules_dir, std::string_view module_path) noexcept -> std::uintmax_t {
+    static constexpr std::array compression_exts{"", ".zst", ".xz", ".gz"};
+    std::error_code err_code{};
+    for (auto&& compression_ext : compression_exts) {
+        const auto file_size = fs::file_size(fmt::format(FMT_COMPILE("{}/{}{}"), modules_dir, module_path, compression_ext), err_code);
+        if (!err_code) {
+            return file_size;
+        }
+    }
+    return 0;
+}
+
+}  // namespace
+
+namespace build {
+
+auto get_module_profile_path() noexcept -> std::string {
+    return utils::fix_path("~/.local/share/cachyos-km/modules");
+}
+
+auto get_running_modules_dir() noexcept -> std::string {
+    auto os_release = utils::read_whole_file("/proc/sys/kernel/osrelease");
+    if (!os_release.empty() && os_release.back() == '\n') {
+        os_release.pop_back();
+    }
+    return fmt::format(FMT_COMPILE("/lib/modules/{}"), os_release);
+}
+
+auto sample_loaded_modules() noexcept -> std::vector<std::string> {
+    std::vector<std::string> modules{};
+
+    // e.g. "iwlwifi 598016 1 iwlmvm, Live 0x0000000000000000"
+    const auto& proc_modules = utils::read_whole_file("/proc/modules");
+    for (auto&& line : utils::make_split_view(proc_modules, '\n')) {
+        /* clang-format off */
+        if (line.empty()) { continue; }
+        /* clang-format on */
+        modules.emplace_back(line.substr(0, line.find(' ')));
+    }
+
+    // NOTE: only the loadable modules have the initstate, the builtin ones are in /sys/module too.
+    std::error_code err_code{};
+    for (auto&& dir_entry : fs::directory_iterator{"/sys/module", err_code}) {
+        if (fs::exists(dir_entry.path() / "initstate", err_code)) {
+            modules.emplace_back(dir_entry.path().filename().string());
+        }
+    }
+    return modules;
+}
+
+auto load_module_profile(std::string_view profile_path) noexcept -> ModuleProfile {
+    ModuleProfile profile{};
+    const auto& content = utils::read_whole_file(profile_path);
+    for (auto&& line : utils::make_split_view(content, '\n')) {
+        if (line.starts_with(since_prefix)) {
+            const auto since_value = line.substr(since_prefix.size());
+            std::from_chars(since_value.data(), since_value.data() + since_value.size(), profile.since);
+        } else if (!line.empty()) {
+            profile.modules.emplace(line);
+        }
+    }
+    return profile;
+}
+
+auto collect_loaded_modules(std::string_view profile_path) noexcept -> std::size_t {
+    auto profile = load_module_profile(profile_path);
+    if (profile.since == 0) {
+        profile.since = std::time(nullptr);
+    }
+
+    std::size_t new_count{};
+    for (auto&& module_name : sample_loaded_modules()) {
+        new_count += profile.modules.emplace(std::move(module_name)).second ? 1U : 0U;
+    }
+    /* clang-format off */
+    if (new_count == 0) { return 0; }
+    /* clang-format on */
+
+    auto content = fmt::format(FMT_COMPILE("{}{}\n"), since_prefix, profile.since);
+    for (auto&& module_name : profile.modules) {
+        content += fmt::format(FMT_COMPILE("{}\n"), module_name);
+    }
+    write_file_atomically(profile_path, content);
+    return new_count;
+}
+
+auto write_modprobed_db(const ModuleProfile& profile, std::string_view db_path) noexcept -> bool {
+    /* clang-format off */
+    if (profile.modules.empty()) { return false; }
+    /* clang-format on */
+
+    // the modules collected by modprobed-db itself, if it is used
+    auto modules                = profile.modules;
+    const auto& current_content = utils::read_whole_file(db_path);
+    for (auto&& line : utils::make_split_view(current_content, '\n')) {
+        if (!line.empty()) {
+            modules.emplace(line);
+        }
+    }
+
+    std::string content{};
+    for (auto&& module_name : modules) {
+        content += fmt::format(FMT_COMPILE("{}\n"), module_name);
+    }
+    /* clang-format off */
+    if (content == current_content) { return true; }
+    /* clang-format on */
+    return write_file_atomically(db_path, content);
+}
+
+auto estimate_module_reduction(const ModuleProfile& profile, std::string_view modules_dir) noexcept -> ModuleReduction {
+    // NOTE: the module size is a rough measure of the compile units in it.
+    ModuleReduction reduction{};
+    std::uintmax_t total_size{};
+    std::uintmax_t kept_size{};
+    const auto& modules_order = utils::read_whole_file(fmt::format(FMT_COMPILE("{}/modules.order"), modules_dir));
+    for (auto&& module_path : utils::make_split_view(modules_order, '\n')) {
+        /* clang-format off */
+        if (module_path.empty()) { continue; }
+        /* clang-format on */
+        const auto module_size = get_module_file_size(modules_dir, module_path);
+        const bool is_kept     = profile.modules.contains(get_module_name(module_path));
+        ++reduction.total_modules;
+        total_size += module_size;
+        if (is_kept) {
+            ++reduction.kept_modules;
+            kept_size += module_size;
+        }
+    }
+
+    if (total_size > 0) {
+        reduction.reduction_percent = static_cast<std::uint32_t>((total_size - kept_size) * 100 / total_size);
+    } else if (reduction.total_modules > 0) {
+        reduction.reduction_percent = static_cast<std::uint32_t>((reduction.total_modules - reduction.kept_modules) * 100 / reduction.total_modules);
+    }
+    return reduction;
+}
+
+auto make_module_report(const ModuleProfile& profile, const ModuleReduction& reduction) noexcept -> std::string {
+    /* clang-format off */
+    if (profile.modules.empty()) { return "No modules collected yet"; }
+    /* clang-format on */
+
+    const auto days = (profile.since > 0) ? (std::time(nullptr) - profile.since) / (24 * 60 * 60) : 0;
+    auto report     = fmt::format(FMT_COMPILE("{} modules collected over {} days"), profile.modules.size(), days);
+    if (reduction.total_modules > 0) {
+        report += fmt::format(FMT_COMPILE(", {} of {} modules are built, about {}% less module code to compile"), reduction.kept_modules, reduction.total_modules,
+            reduction.reduction_percent);
+    }
+    return report;
+}
+
+}  // namespace build
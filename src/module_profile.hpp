@@ -0,0 +1,79 @@
+// Copyright (C) 2022-2024 Vladislav Nepogodin
+//
+// This file is part of CachyOS kernel manager.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#ifndef MODULE_PROFILE_HPP
+#define MODULE_PROFILE_HPP
+
+#include <cstddef>      // for size_t
+#include <cstdint>      // for int64_t, uint32_t
+#include <set>          // for set
+#include <string>       // for string
+#include <string_view>  // for string_view
+#include <vector>       // for vector
+
+namespace build {
+
+/// @brief Kernel modules, which were loaded while the profile was sampled, as modprobed-db collects them.
+/// localmodconfig disables the modules, which aren't in the list.
+struct ModuleProfile {
+    std::set<std::string> modules{};
+    /// When the first sample was taken, seconds since the epoch, 0 if none was.
+    std::int64_t since{};
+};
+
+/// @brief Estimate of how much less is built with localmodconfig, against the running kernel.
+struct ModuleReduction {
+    /// Modules, which the running kernel has built.
+    std::size_t total_modules{};
+    /// Of them, the ones in the profile.
+    std::size_t kept_modules{};
+    /// Share of the module code, which isn't compiled, weighted by the size of the modules.
+    std::uint32_t reduction_percent{};
+};
+
+/// @brief Profile persisted at ~/.local/share/cachyos-km/modules,
+/// the time of the first sample and then one module per line.
+auto get_module_profile_path() noexcept -> std::string;
+
+/// @brief Directory with the modules of the running kernel, e.g. /lib/modules/6.9.1-2-cachyos.
+auto get_running_modules_dir() noexcept -> std::string;
+
+/// @brief Names of the currently loaded modules from /proc/modules and /sys/module.
+auto sample_loaded_modules() noexcept -> std::vector<std::string>;
+
+auto load_module_profile(std::string_view profile_path) noexcept -> ModuleProfile;
+
+/// @brief Samples the loaded modules and merges them into the profile.
+/// The profile is only written if new modules appeared, so sampling is cheap.
+/// @return Count of the new modules.
+auto collect_loaded_modules(std::string_view profile_path) noexcept -> std::size_t;
+
+/// @brief Writes the list of modules, which _localmodcfg of PKGBUILD expects, e.g. ~/.config/modprobed.db.
+/// Modules, which are already listed there, are kept. Nothing is written for the empty profile,
+/// as localmodconfig would disable all modules then.
+auto write_modprobed_db(const ModuleProfile& profile, std::string_view db_path) noexcept -> bool;
+
+/// @brief Compares the profile with the modules built by the kernel in modules_dir.
+auto estimate_module_reduction(const ModuleProfile& profile, std::string_view modules_dir) noexcept -> ModuleReduction;
+
+/// @brief Summary to show to the user, e.g. "312 modules collected over 5 days, ...".
+auto make_module_report(const ModuleProfile& profile, const ModuleReduction& reduction) noexcept -> std::string;
+
+}  // namespace build
+
+#endif  // MODULE_PROFILE_HPP
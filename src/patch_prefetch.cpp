@@ -0,0 +1,285 @@
+// Copyright (C) 2022-2024 Vladislav Nepogodin
+//
+// This file is part of CachyOS kernel manager.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include "patch_prefetch.hpp"
+#include "source_store.hpp"
+#include "utils.hpp"
+
+#include <algorithm>      // for min, all_of
+#include <cctype>         // for isxdigit
+#include <atomic>         // for atomic
+#include <charconv>       // for from_chars
+#include <cstdlib>        // for system
+#include <filesystem>     // for exists, rename, remove, create_directories
+#include <optional>       // for optional
+#include <system_error>   // for error_code
+#include <thread>         // for jthread
+#include <unordered_set>  // for unordered_set
+
+#include <sys/wait.h>  // for WIFEXITED, WEXITSTATUS
+
+#include <fmt/compile.h>
+#include <fmt/core.h>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// NOTE: the patches are small, so the downloads are bound by latency rather than bandwidth.
+constexpr std::size_t max_parallel_downloads = 8;
+
+struct HunkHeader {
+    std::size_t old_count{};
+    std::size_t new_count{};
+};
+
+// Parses count of the range, e.g. "-12,7" or "+12" (count is 1, when omitted).
+auto parse_hunk_range(std::string_view range, char sign) noexcept -> std::optional<std::size_t> {
+    /* clang-format off */
+    if (range.empty() || range[0] != sign) { return std::nullopt; }
+    /* clang-format on */
+    range.remove_prefix(1);
+
+    std::size_t count{1};
+    std::size_t start{};
+    const auto comma_pos = range.find(',');
+    const auto start_str = range.substr(0, comma_pos);
+    if (std::from_chars(start_str.data(), start_str.data() + start_str.size(), start).ptr != start_str.data() + start_str.size()) {
+        return std::nullopt;
+    }
+    if (comma_pos != std::string_view::npos) {
+        const auto count_str = range.substr(comma_pos + 1);
+        if (std::from_chars(count_str.data(), count_str.data() + count_str.size(), count).ptr != count_str.data() + count_str.size()) {
+            return std::nullopt;
+        }
+    }
+    return count;
+}
+
+// "@@ -old[,count] +new[,count] @@ optional section"
+auto parse_hunk_header(std::string_view line) noexcept -> std::optional<HunkHeader> {
+    line.remove_prefix(3);
+    const auto end_pos = line.find(" @@");
+    /* clang-format off */
+    if (end_pos == std::string_view::npos) { return std::nullopt; }
+    /* clang-format on */
+    line = line.substr(0, end_pos);
+
+    const auto space_pos = line.find(' ');
+    /* clang-format off */
+    if (space_pos == std::string_view::npos) { return std::nullopt; }
+    /* clang-format on */
+    const auto old_count = parse_hunk_range(line.substr(0, space_pos), '-');
+    const auto new_count = parse_hunk_range(line.substr(space_pos + 1), '+');
+    if (!old_count || !new_count) {
+        return std::nullopt;
+    }
+    return HunkHeader{.old_count = *old_count, .new_count = *new_count};
+}
+
+// Keeps empty lines, unlike utils::make_split_view, they are context lines of the hunk.
+auto next_line(std::string_view& content) noexcept -> std::string_view {
+    const auto newline_pos = content.find('\n');
+    const auto line        = content.substr(0, newline_pos);
+    content.remove_prefix((newline_pos == std::string_view::npos) ? content.size() : newline_pos + 1);
+    return line;
+}
+
+constexpr auto get_patch_url(std::string_view patch) noexcept -> std::string_view {
+    if (auto pos = patch.find("::"); pos != std::string_view::npos) {
+        patch.remove_prefix(pos + 2);
+    }
+    return patch;
+}
+
+// The content behind the URL with the full commit hash or digest in its path never changes,
+// e.g. https://github.com/torvalds/linux/commit/<sha1>.patch, the branch links do.
+auto is_content_pinned_url(std::string_view url) noexcept -> bool {
+    for (auto&& segment : utils::make_split_view(url, '/')) {
+        const auto hash = segment.substr(0, segment.find('.'));
+        if ((hash.size() == 40 || hash.size() == 64) && std::ranges::all_of(hash, [](char hash_char) { return std::isxdigit(static_cast<unsigned char>(hash_char)) != 0; })) {
+            return true;
+        }
+    }
+    return false;
+}
+
+auto fetch_patch(std::string_view srcdest, std::string_view startdir, std::string_view patch) noexcept -> std::optional<std::string> {
+    const auto url = get_patch_url(patch);
+
+    // local patches are used from the PKGBUILD directory as is
+    if (url.find("://") == std::string_view::npos) {
+        const auto& patch_path = build::get_fetched_patch_path(srcdest, startdir, patch);
+        if (!fs::exists(patch_path)) {
+            return fmt::format(FMT_COMPILE("'{}' doesn't exist"), patch_path);
+        }
+        if (!build::is_unified_diff(utils::read_whole_file(patch_path))) {
+            return std::string{"not a unified diff"};
+        }
+        return std::nullopt;
+    }
+    if (!url.starts_with("http://") && !url.starts_with("https://") && !url.starts_with("ftp://") && !url.starts_with("file://")) {
+        return std::nullopt;
+    }
+
+    // the patch fetched before is handed out from the store. Only the pinned one is taken as is,
+    // the others are revalidated, the local file:// ones may be edited meanwhile.
+    const auto& source_store = build::SourceStore::instance();
+    const auto& dest_path    = build::get_fetched_patch_path(srcdest, startdir, patch);
+    const auto& object_path  = url.starts_with("file://") ? std::string{} : source_store.find_fetched(url);
+    if (!object_path.empty() && is_content_pinned_url(url) && build::SourceStore::hand_out_object(object_path, dest_path)) {
+        return std::nullopt;
+    }
+
+    // NOTE: the patch is downloaded next to the final path, so makepkg never sees the partial file.
+    const auto& partial_path = fmt::format(FMT_COMPILE("{}.km-part"), dest_path);
+    auto curl_cmd            = fmt::format(FMT_COMPILE("curl -qgfsSL --retry 3 --connect-timeout 30 -o {}"), utils::shell_quote(partial_path));
+    std::error_code err_code{};
+    if (!object_path.empty()) {
+        // the server answers 304 without the body, if neither the date nor the etag has changed
+        const auto& etag_path = source_store.get_fetched_etag_path(url);
+        curl_cmd += fmt::format(FMT_COMPILE(" -z {} --etag-save {}"), utils::shell_quote(object_path), utils::shell_quote(etag_path));
+        if (fs::exists(etag_path, err_code)) {
+            curl_cmd += fmt::format(FMT_COMPILE(" --etag-compare {}"), utils::shell_quote(etag_path));
+        }
+    }
+    curl_cmd += fmt::format(FMT_COMPILE(" -- {}"), utils::shell_quote(url));
+
+    fs::remove(partial_path, err_code);
+    const int curl_status = std::system(curl_cmd.c_str());
+    if (!WIFEXITED(curl_status) || WEXITSTATUS(curl_status) != 0) {
+        fs::remove(partial_path, err_code);
+        if (!object_path.empty() && build::SourceStore::hand_out_object(object_path, dest_path)) {
+            fmt::print(stderr, "Failed to revalidate {}, using the stored copy\n", url);
+            return std::nullopt;
+        }
+        return fmt::format(FMT_COMPILE("download failed (curl exited with {})"), WIFEXITED(curl_status) ? WEXITSTATUS(curl_status) : -1);
+    }
+    // not modified, curl doesn't create the file then
+    if (!object_path.empty() && !fs::exists(partial_path, err_code)) {
+        return build::SourceStore::hand_out_object(object_path, dest_path) ? std::nullopt : std::optional<std::string>{"failed to hand out the stored copy"};
+    }
+    if (!build::is_unified_diff(utils::read_whole_file(partial_path))) {
+        fs::remove(partial_path, err_code);
+        return std::string{"not a unified diff"};
+    }
+
+    // deduplicated by content in the store, and linked into srcdest like the other sources
+    if (const auto& object_path = source_store.ingest_fetched(url, partial_path); !object_path.empty() && build::SourceStore::hand_out_object(object_path, dest_path)) {
+        fs::remove(partial_path, err_code);
+        return std::nullopt;
+    }
+    fs::rename(partial_path, dest_path, err_code);
+    if (err_code) {
+        return fmt::format(FMT_COMPILE("failed to store: {}"), err_code.message());
+    }
+    return std::nullopt;
+}
+
+}  // namespace
+
+namespace build {
+
+auto get_fetched_patch_path(std::string_view srcdest, std::string_view startdir, std::string_view patch) noexcept -> std::string {
+    const auto url = get_patch_url(patch);
+    if (url.find("://") != std::string_view::npos) {
+        return fmt::format(FMT_COMPILE("{}/{}"), srcdest, get_source_name(patch));
+    }
+    return url.starts_with('/') ? std::string{url} : fmt::format(FMT_COMPILE("{}/{}"), startdir, url);
+}
+
+auto is_unified_diff(std::string_view content) noexcept -> bool {
+    bool has_file_header{};
+    bool has_hunks{};
+    while (!content.empty()) {
+        const auto line = next_line(content);
+        if (line.starts_with("--- ") && content.starts_with("+++ ")) {
+            next_line(content);
+            has_file_header = true;
+            continue;
+        }
+        /* clang-format off */
+        if (!line.starts_with("@@ ")) { continue; }
+        if (!has_file_header) { return false; }
+        /* clang-format on */
+
+        auto hunk_header = parse_hunk_header(line);
+        /* clang-format off */
+        if (!hunk_header) { return false; }
+        /* clang-format on */
+        auto& [old_count, new_count] = *hunk_header;
+        while (old_count > 0 || new_count > 0) {
+            // the hunk is truncated
+            /* clang-format off */
+            if (content.empty()) { return false; }
+            /* clang-format on */
+
+            const auto hunk_line = next_line(content);
+            const char line_kind = hunk_line.empty() ? ' ' : hunk_line[0];
+            if (line_kind == ' ' && old_count > 0 && new_count > 0) {
+                --old_count, --new_count;
+            } else if (line_kind == '-' && old_count > 0) {
+                --old_count;
+            } else if (line_kind == '+' && new_count > 0) {
+                --new_count;
+            } else if (line_kind != '\\') {
+                return false;
+            }
+        }
+        has_hunks = true;
+    }
+    return has_hunks;
+}
+
+auto prefetch_patches(std::string_view srcdest, std::string_view startdir, std::span<const std::string> patches, std::stop_token stop_token) noexcept -> std::vector<PatchIssue> {
+    std::error_code err_code{};
+    fs::create_directories(srcdest, err_code);
+
+    // the same file is fetched once, even if it's listed twice
+    std::vector<std::string_view> unique_patches{};
+    std::unordered_set<std::string_view> seen_names{};
+    for (auto&& patch : patches) {
+        if (seen_names.insert(get_source_name(patch)).second) {
+            unique_patches.emplace_back(patch);
+        }
+    }
+
+    std::vector<std::optional<std::string>> fetch_errors(unique_patches.size());
+    std::atomic<std::size_t> next_index{};
+    {
+        const auto& worker = [&] {
+            for (auto index = next_index++; index < unique_patches.size() && !stop_token.stop_requested(); index = next_index++) {
+                fetch_errors[index] = fetch_patch(srcdest, startdir, unique_patches[index]);
+            }
+        };
+        std::vector<std::jthread> workers{};
+        for (std::size_t i = 0; i < std::min(unique_patches.size(), max_parallel_downloads); ++i) {
+            workers.emplace_back(worker);
+        }
+    }
+
+    std::vector<PatchIssue> issues{};
+    for (std::size_t i = 0; i < unique_patches.size(); ++i) {
+        if (fetch_errors[i]) {
+            issues.emplace_back(PatchIssue{.patch = std::string{unique_patches[i]}, .reason = std::move(*fetch_errors[i])});
+        }
+    }
+    return issues;
+}
+
+}  // namespace build
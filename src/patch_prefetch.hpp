@@ -0,0 +1,56 @@
+// Copyright (C) 2022-2024 Vladislav Nepogodin
+//
+// This file is part of CachyOS kernel manager.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#ifndef PATCH_PREFETCH_HPP
+#define PATCH_PREFETCH_HPP
+
+#include <span>         // for span
+#include <stop_token>   // for stop_token
+#include <string>       // for string
+#include <string_view>  // for string_view
+#include <vector>       // for vector
+
+namespace build {
+
+/// @brief Patch, which can't be used for the build.
+struct PatchIssue {
+    /// Entry of the patches list, as written into the source array.
+    std::string patch{};
+    std::string reason{};
+};
+
+/// @brief Checks that content is a unified diff: at least one file header ('---'/'+++')
+/// followed by hunks, which line counts match their '@@' headers.
+/// Text around the diffs (e.g. commit message of git format-patch) is ignored.
+auto is_unified_diff(std::string_view content) noexcept -> bool;
+
+/// @brief Path of the patch, where it's taken from by makepkg: srcdest for the remote patches,
+/// PKGBUILD directory (startdir) for the local ones.
+auto get_fetched_patch_path(std::string_view srcdest, std::string_view startdir, std::string_view patch) noexcept -> std::string;
+
+/// @brief Fetches the remote patches concurrently into the source store, and hands them out into srcdest,
+/// where makepkg picks them up without downloading. Both remote and local ones are validated.
+/// The patches fetched before are taken from the store.
+/// Remote patches are fetched with curl, so file:// and plain http:// URLs work as well.
+/// @param startdir Directory of PKGBUILD, the local patches are resolved against it.
+/// @return Patches, which failed to fetch or are not a unified diff.
+auto prefetch_patches(std::string_view srcdest, std::string_view startdir, std::span<const std::string> patches, std::stop_token stop_token) noexcept -> std::vector<PatchIssue>;
+
+}  // namespace build
+
+#endif  // PATCH_PREFETCH_HPP
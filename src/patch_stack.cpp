@@ -0,0 +1,208 @@
+// Copyright (C) 2022-2024 Vladislav Nepogodin
+//
+// This file is part of CachyOS kernel manager.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include "patch_stack.hpp"
+#include "utils.hpp"
+
+#include <algorithm>      // for max, min, ranges::find
+#include <atomic>         // for atomic
+#include <charconv>       // for from_chars
+#include <filesystem>     // for copy_file, create_directories, remove_all, temp_directory_path
+#include <numeric>        // for iota
+#include <system_error>   // for error_code
+#include <thread>         // for jthread, hardware_concurrency
+#include <unordered_map>  // for unordered_map
+#include <utility>        // for pair
+
+#include <unistd.h>  // for getpid
+
+#include <fmt/compile.h>
+#include <fmt/core.h>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// Path of the '---'/'+++' header, without the timestamp and the first component.
+auto get_header_path(std::string_view line) noexcept -> std::string_view {
+    line.remove_prefix(4);
+    if (auto tab_pos = line.find('\t'); tab_pos != std::string_view::npos) {
+        line = line.substr(0, tab_pos);
+    }
+    /* clang-format off */
+    if (line == "/dev/null") { return {}; }
+    /* clang-format on */
+    if (auto slash_pos = line.find('/'); slash_pos != std::string_view::npos) {
+        line.remove_prefix(slash_pos + 1);
+    }
+    return line;
+}
+
+// Runs patch, and returns its exit status with the output.
+auto run_patch(std::string_view args) noexcept -> std::pair<int, std::string> {
+    auto output = utils::exec(fmt::format(FMT_COMPILE("patch -p1 -t --no-backup-if-mismatch -r - {} 2>&1; echo \"km-status=$?\""), args));
+
+    int status{2};
+    if (auto status_pos = output.rfind("km-status="); status_pos != std::string::npos) {
+        const auto status_str = std::string_view{output}.substr(status_pos + 10);
+        std::from_chars(status_str.data(), status_str.data() + status_str.size(), status);
+        output.resize(status_pos);
+    }
+    return {status, std::move(output)};
+}
+
+// NOTE: union-find over the patches, which touch common files.
+auto find_root(std::vector<std::size_t>& parents, std::size_t index) noexcept -> std::size_t {
+    while (parents[index] != index) {
+        parents[index] = parents[parents[index]];
+        index          = parents[index];
+    }
+    return index;
+}
+
+struct PatchGroup {
+    std::vector<std::size_t> patch_indices{};
+    std::vector<std::string> files{};
+};
+
+void check_patch_group(std::string_view tree_dir, const PatchGroup& group, std::size_t group_index, std::span<const std::string> patch_paths,
+    std::span<const std::vector<std::string>> touched_files, std::span<build::PatchCheck> results) noexcept {
+    // the files are copied into the scratch tree, the rest of the tree isn't needed to apply the patches
+    const auto& scratch_dir = fs::temp_directory_path() / fmt::format(FMT_COMPILE("cachyos-km-patch-check-{}-{}"), ::getpid(), group_index);
+    std::error_code err_code{};
+    fs::remove_all(scratch_dir, err_code);
+    for (auto&& file : group.files) {
+        const auto& tree_file = fs::path{tree_dir} / file;
+        /* clang-format off */
+        if (!fs::is_regular_file(tree_file, err_code)) { continue; }
+        /* clang-format on */
+        fs::create_directories((scratch_dir / file).parent_path(), err_code);
+        fs::copy_file(tree_file, scratch_dir / file, err_code);
+    }
+    fs::create_directories(scratch_dir, err_code);
+
+    const auto& quoted_scratch_dir = utils::shell_quote(scratch_dir.string());
+    for (std::size_t i = 0; i < group.patch_indices.size(); ++i) {
+        const auto patch_index   = group.patch_indices[i];
+        const auto& quoted_patch = utils::shell_quote(patch_paths[patch_index]);
+        // NOTE: the failed patch still writes the hunks, which applied, so it is tried first,
+        // and the later patches are checked against the tree without them.
+        auto [status, output] = run_patch(fmt::format(FMT_COMPILE("--dry-run -N -d {} -i {}"), quoted_scratch_dir, quoted_patch));
+        auto& result          = results[patch_index];
+        result.details        = std::move(output);
+        if (status == 0) {
+            run_patch(fmt::format(FMT_COMPILE("-N -d {} -i {}"), quoted_scratch_dir, quoted_patch));
+            result.status = (result.details.find("with fuzz") != std::string::npos) ? build::PatchStatus::Fuzz : build::PatchStatus::Applies;
+            continue;
+        }
+
+        // the patch is blamed on the latest earlier patch touching the same files,
+        // if it applies to the tree alone
+        result.status = build::PatchStatus::Failed;
+        for (std::size_t j = i; j > 0; --j) {
+            const auto earlier_index  = group.patch_indices[j - 1];
+            const bool is_overlapping = std::ranges::any_of(touched_files[patch_index], [&](auto&& file) { return std::ranges::find(touched_files[earlier_index], file) != touched_files[earlier_index].end(); });
+            /* clang-format off */
+            if (!is_overlapping) { continue; }
+            /* clang-format on */
+
+            if (run_patch(fmt::format(FMT_COMPILE("--dry-run -N -d {} -i {}"), utils::shell_quote(tree_dir), quoted_patch)).first == 0) {
+                result.status         = build::PatchStatus::Conflicts;
+                result.conflicts_with = earlier_index;
+            }
+            break;
+        }
+    }
+    fs::remove_all(scratch_dir, err_code);
+}
+
+}  // namespace
+
+namespace build {
+
+auto get_touched_files(std::string_view content) noexcept -> std::vector<std::string> {
+    std::vector<std::string> files{};
+    std::string_view old_path{};
+    for (auto&& line : utils::make_split_view(content, '\n')) {
+        if (line.starts_with("--- ")) {
+            old_path = get_header_path(line);
+        } else if (line.starts_with("+++ ")) {
+            // the deleted file has only the old path
+            auto new_path = get_header_path(line);
+            if (new_path.empty()) {
+                new_path = old_path;
+            }
+            if (!new_path.empty() && std::ranges::find(files, new_path) == files.end()) {
+                files.emplace_back(new_path);
+            }
+        }
+    }
+    return files;
+}
+
+auto check_patch_stack(std::string_view tree_dir, std::span<const std::string> patch_paths, std::stop_token stop_token) noexcept -> std::vector<PatchCheck> {
+    std::vector<std::vector<std::string>> touched_files{};
+    for (auto&& patch_path : patch_paths) {
+        touched_files.emplace_back(get_touched_files(utils::read_whole_file(patch_path)));
+    }
+
+    // patches touching common files are grouped, and applied one after another in the group
+    std::vector<std::size_t> parents(patch_paths.size());
+    std::iota(parents.begin(), parents.end(), std::size_t{});
+    std::unordered_map<std::string_view, std::size_t> file_owners{};
+    for (std::size_t i = 0; i < touched_files.size(); ++i) {
+        for (auto&& file : touched_files[i]) {
+            if (auto [owner_it, is_inserted] = file_owners.try_emplace(file, i); !is_inserted) {
+                parents[find_root(parents, i)] = find_root(parents, owner_it->second);
+            }
+        }
+    }
+    std::vector<PatchGroup> groups{};
+    std::unordered_map<std::size_t, std::size_t> group_indices{};
+    for (std::size_t i = 0; i < patch_paths.size(); ++i) {
+        const auto [group_it, is_inserted] = group_indices.try_emplace(find_root(parents, i), groups.size());
+        if (is_inserted) {
+            groups.emplace_back();
+        }
+        auto& group = groups[group_it->second];
+        group.patch_indices.emplace_back(i);
+        for (auto&& file : touched_files[i]) {
+            if (std::ranges::find(group.files, file) == group.files.end()) {
+                group.files.emplace_back(file);
+            }
+        }
+    }
+
+    std::vector<PatchCheck> results(patch_paths.size());
+    std::atomic<std::size_t> next_group{};
+    {
+        const auto& worker = [&] {
+            for (auto index = next_group++; index < groups.size() && !stop_token.stop_requested(); index = next_group++) {
+                check_patch_group(tree_dir, groups[index], index, patch_paths, touched_files, results);
+            }
+        };
+        const auto workers_count = std::min<std::size_t>(groups.size(), std::max(std::thread::hardware_concurrency(), 1U));
+        std::vector<std::jthread> workers{};
+        for (std::size_t i = 0; i < workers_count; ++i) {
+            workers.emplace_back(worker);
+        }
+    }
+    return results;
+}
+
+}  // namespace build
@@ -0,0 +1,59 @@
+// Copyright (C) 2022-2024 Vladislav Nepogodin
+//
+// This file is part of CachyOS kernel manager.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#ifndef PATCH_STACK_HPP
+#define PATCH_STACK_HPP
+
+#include <cstddef>      // for size_t
+#include <cstdint>      // for uint8_t
+#include <span>         // for span
+#include <stop_token>   // for stop_token
+#include <string>       // for string
+#include <string_view>  // for string_view
+#include <vector>       // for vector
+
+namespace build {
+
+enum class PatchStatus : std::uint8_t {
+    Applies,
+    /// Applies, but some hunks needed fuzz.
+    Fuzz,
+    /// Applies to the tree alone, but not on top of the earlier patch.
+    Conflicts,
+    /// Doesn't apply to the tree at all.
+    Failed,
+};
+
+struct PatchCheck {
+    PatchStatus status{};
+    /// Index of the earlier patch, which the patch conflicts with.
+    std::size_t conflicts_with{};
+    /// Output of patch, e.g. failed hunks.
+    std::string details{};
+};
+
+/// @brief Files touched by the unified diff, with the first path component stripped (-p1).
+auto get_touched_files(std::string_view content) noexcept -> std::vector<std::string>;
+
+/// @brief Applies the ordered patch stack to the copy of the touched files from tree_dir.
+/// Patches, which don't touch common files, are checked in parallel, the tree itself is left as is.
+auto check_patch_stack(std::string_view tree_dir, std::span<const std::string> patch_paths, std::stop_token stop_token) noexcept -> std::vector<PatchCheck>;
+
+}  // namespace build
+
+#endif  // PATCH_STACK_HPP
@@ -0,0 +1,95 @@
+// Copyright (C) 2022-2024 Vladislav Nepogodin
+//
+// This file is part of CachyOS kernel manager.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include "pkgbuild_cache.hpp"
+#include "utils.hpp"
+
+#include <algorithm>     // for all_of
+#include <filesystem>    // for exists, create_directories, rename
+#include <ranges>        // for ranges::*
+#include <system_error>  // for error_code
+
+#include <fmt/compile.h>
+#include <fmt/core.h>
+
+namespace fs = std::filesystem;
+
+namespace pkgbuild {
+
+auto EvalCache::instance() noexcept -> EvalCache& {
+    static EvalCache cache{utils::fix_path("~/.cache/cachyos-km/pkgbuild-cache")};
+    return cache;
+}
+
+auto EvalCache::make_key(std::string_view pkgbuild_content, std::string_view variant, std::string_view options_env) noexcept -> std::uint64_t {
+    auto hash = utils::fnv1a_append(utils::fnv1a_offset_basis, pkgbuild_content);
+    hash      = utils::fnv1a_append(hash, variant);
+    return utils::fnv1a_append(hash, options_env);
+}
+
+auto EvalCache::get_entry_path(std::uint64_t key) const noexcept -> std::string {
+    return fmt::format(FMT_COMPILE("{}/{:016x}"), m_cache_dir, key);
+}
+
+auto EvalCache::lookup(std::uint64_t key) noexcept -> std::optional<value_t> {
+    const std::lock_guard<std::mutex> lock(m_mutex);
+    if (auto it = m_entries.find(key); it != m_entries.end()) {
+        return it->second;
+    }
+
+    // fallback to the entry persisted by previous runs
+    const auto& entry_path = get_entry_path(key);
+    std::error_code err_code{};
+    if (!fs::exists(entry_path, err_code)) {
+        return std::nullopt;
+    }
+    auto value = utils::make_multiline(utils::read_whole_file(entry_path), '\n');
+    m_entries.insert_or_assign(key, value);
+    return value;
+}
+
+void EvalCache::store(std::uint64_t key, const value_t& value) noexcept {
+    // don't memoize failed evaluation, e.g. bash couldn't source the PKGBUILD
+    if (std::ranges::all_of(value, [](auto&& entry) { return entry.empty(); })) {
+        return;
+    }
+
+    const std::lock_guard<std::mutex> lock(m_mutex);
+    m_entries.insert_or_assign(key, value);
+
+    std::error_code err_code{};
+    fs::create_directories(m_cache_dir, err_code);
+    if (err_code) {
+        fmt::print(stderr, "Failed to create pkgbuild cache directory: {}\n", err_code.message());
+        return;
+    }
+
+    // write to temporary file first, so that partially written entry is never read
+    const auto& entry_path = get_entry_path(key);
+    const auto& temp_path  = fmt::format(FMT_COMPILE("{}.tmp"), entry_path);
+    const auto& entry_data = value | std::ranges::views::join_with('\n') | std::ranges::to<std::string>();
+    if (!utils::write_to_file(temp_path, entry_data)) {
+        return;
+    }
+    fs::rename(temp_path, entry_path, err_code);
+    if (err_code) {
+        fmt::print(stderr, "Failed to store pkgbuild cache entry: {}\n", err_code.message());
+    }
+}
+
+}  // namespace pkgbuild
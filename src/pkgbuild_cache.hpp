@@ -0,0 +1,75 @@
+// Copyright (C) 2022-2024 Vladislav Nepogodin
+//
+// This file is part of CachyOS kernel manager.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#ifndef PKGBUILD_CACHE_HPP
+#define PKGBUILD_CACHE_HPP
+
+#include <cstdint>        // for uint64_t
+#include <mutex>          // for mutex
+#include <optional>       // for optional
+#include <string>         // for string
+#include <string_view>    // for string_view
+#include <unordered_map>  // for unordered_map
+#include <utility>        // for move
+#include <vector>         // for vector
+
+namespace pkgbuild {
+
+/// @brief Memoized results of PKGBUILD evaluation.
+///
+/// Entries are keyed by the hash of PKGBUILD content, kernel variant and
+/// the option environment, so an updated PKGBUILD never hits a stale entry.
+/// Kept in memory and persisted on disk, one file per key.
+class EvalCache {
+ public:
+    using value_t = std::vector<std::string>;
+
+    explicit EvalCache(std::string cache_dir) noexcept
+      : m_cache_dir(std::move(cache_dir)) { }
+
+    /// @brief Process-wide cache at ~/.cache/cachyos-km/pkgbuild-cache.
+    static auto instance() noexcept -> EvalCache&;
+
+    static auto make_key(std::string_view pkgbuild_content, std::string_view variant, std::string_view options_env) noexcept -> std::uint64_t;
+
+    auto lookup(std::uint64_t key) noexcept -> std::optional<value_t>;
+    void store(std::uint64_t key, const value_t& value) noexcept;
+
+    /// @brief Returns cached value, or evaluates it with func and stores the result.
+    /// NOTE: evaluation runs without the lock held, it forks bash.
+    template <typename Func>
+    auto get_or_eval(std::uint64_t key, Func&& func) noexcept -> value_t {
+        if (auto cached = lookup(key)) {
+            return std::move(*cached);
+        }
+        auto value = func();
+        store(key, value);
+        return value;
+    }
+
+ private:
+    auto get_entry_path(std::uint64_t key) const noexcept -> std::string;
+
+    std::mutex m_mutex{};
+    std::string m_cache_dir{};
+    std::unordered_map<std::uint64_t, value_t> m_entries{};
+};
+
+}  // namespace pkgbuild
+
+#endif  // PKGBUILD_CACHE_HPP
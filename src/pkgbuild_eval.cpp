@@ -0,0 +1,268 @@
+// Copyright (C) 2022-2024 Vladislav Nepogodin
+//
+// This file is part of CachyOS kernel manager.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include "pkgbuild_eval.hpp"
+#include "utils.hpp"
+
+#include <cerrno>   // for errno, EINTR
+#include <csignal>  // for kill, SIGKILL
+#include <cstdlib>  // for getenv
+#include <cstring>  // for strerror
+
+#include <algorithm>   // for all_of
+#include <array>       // for array
+#include <filesystem>  // for current_path, exists
+#include <utility>     // for move
+#include <vector>      // for vector
+
+#include <fcntl.h>       // for O_WRONLY
+#include <poll.h>        // for poll, pollfd
+#include <spawn.h>       // for posix_spawn
+#include <sys/socket.h>  // for socketpair, send, recv
+#include <sys/wait.h>    // for waitpid
+#include <unistd.h>      // for close
+
+#include <fmt/compile.h>
+#include <fmt/core.h>
+
+namespace {
+
+// NOTE: sourcing PKGBUILD must never take that long, bash is restarted then.
+constexpr int response_timeout_ms = 30'000;
+
+constexpr auto is_valid_identifier(std::string_view name) noexcept -> bool {
+    if (name.empty() || (name[0] >= '0' && name[0] <= '9')) {
+        return false;
+    }
+    return std::ranges::all_of(name, [](char ch) {
+        return ch == '_' || (ch >= 'a' && ch <= 'z') || (ch >= 'A' && ch <= 'Z') || (ch >= '0' && ch <= '9');
+    });
+}
+
+// NOTE: bwrap fails, if the unprivileged user namespaces are disabled, so it's tried once.
+auto is_sandbox_available() noexcept -> bool {
+    static const bool is_available = [] {
+        const int status = std::filesystem::exists("/usr/bin/bwrap")
+            ? std::system("/usr/bin/bwrap --ro-bind / / --unshare-net --die-with-parent -- /usr/bin/true >/dev/null 2>&1")
+            : -1;
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            fmt::print(stderr, "bwrap isn't usable, PKGBUILD is evaluated without the sandbox\n");
+            return false;
+        }
+        return true;
+    }();
+    return is_available;
+}
+
+// e.g. bwrap --ro-bind / / --dev /dev --proc /proc --tmpfs /tmp --bind <cwd> <cwd> --unshare-net ... -- /usr/bin/bash
+auto make_bash_command() noexcept -> std::vector<std::string> {
+    std::vector<std::string> command{};
+    if (is_sandbox_available()) {
+        command = {"/usr/bin/bwrap", "--ro-bind", "/", "/", "--dev", "/dev", "--proc", "/proc", "--tmpfs", "/tmp"};
+        std::error_code err_code{};
+        const auto& working_dir = std::filesystem::current_path(err_code).string();
+        if (!err_code && working_dir != "/") {
+            command.insert(command.end(), {"--bind", working_dir, working_dir});
+        }
+        // NOTE: no new session, bash must stay in the process group, which is killed on stop.
+        command.insert(command.end(), {"--unshare-net", "--unshare-ipc", "--unshare-uts", "--die-with-parent", "--"});
+    }
+    command.insert(command.end(), {"/usr/bin/bash", "--noprofile", "--norc"});
+    return command;
+}
+
+}  // namespace
+
+namespace pkgbuild {
+
+EvalServer::~EvalServer() {
+    stop();
+}
+
+auto EvalServer::instance() noexcept -> EvalServer& {
+    static EvalServer server{};
+    return server;
+}
+
+auto EvalServer::start() noexcept -> bool {
+    std::array<int, 2> sock_fds{};
+    if (::socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sock_fds.data()) != 0) {
+        fmt::print(stderr, "Failed to create socket pair for bash: {}\n", std::strerror(errno));
+        return false;
+    }
+
+    // bash reads requests from stdin and writes responses to stdout, both are the same socket
+    posix_spawn_file_actions_t file_actions{};
+    posix_spawn_file_actions_init(&file_actions);
+    posix_spawn_file_actions_adddup2(&file_actions, sock_fds[1], STDIN_FILENO);
+    posix_spawn_file_actions_adddup2(&file_actions, sock_fds[1], STDOUT_FILENO);
+    posix_spawn_file_actions_addopen(&file_actions, STDERR_FILENO, "/dev/null", O_WRONLY, 0);
+
+    // own process group, so hanging subshells are killed together with bash
+    posix_spawnattr_t spawn_attr{};
+    posix_spawnattr_init(&spawn_attr);
+    posix_spawnattr_setflags(&spawn_attr, POSIX_SPAWN_SETPGROUP);
+    posix_spawnattr_setpgroup(&spawn_attr, 0);
+
+    // NOTE: minimal environment, the user's shell setup must not affect evaluation.
+    const char* home_dir = std::getenv("HOME");
+    std::string path_env{"PATH=/usr/local/bin:/usr/bin:/bin"};
+    std::string locale_env{"LC_ALL=C"};
+    std::string home_env = fmt::format(FMT_COMPILE("HOME={}"), (home_dir != nullptr) ? home_dir : "/");
+    std::array<char*, 4> envp{path_env.data(), locale_env.data(), home_env.data(), nullptr};
+
+    auto bash_command = make_bash_command();
+    std::vector<char*> argv{};
+    for (auto&& arg : bash_command) {
+        argv.emplace_back(arg.data());
+    }
+    argv.emplace_back(nullptr);
+
+    const int spawn_status = ::posix_spawn(&m_pid, argv[0], &file_actions, &spawn_attr, argv.data(), envp.data());
+    posix_spawn_file_actions_destroy(&file_actions);
+    posix_spawnattr_destroy(&spawn_attr);
+    ::close(sock_fds[1]);
+
+    if (spawn_status != 0) {
+        fmt::print(stderr, "Failed to start bash: {}\n", std::strerror(spawn_status));
+        ::close(sock_fds[0]);
+        m_pid = -1;
+        return false;
+    }
+    m_socket = sock_fds[0];
+    m_buffer.clear();
+    return true;
+}
+
+void EvalServer::stop() noexcept {
+    if (m_socket >= 0) {
+        ::close(m_socket);
+        m_socket = -1;
+    }
+    if (m_pid > 0) {
+        ::kill(-m_pid, SIGKILL);
+        ::waitpid(m_pid, nullptr, 0);
+        m_pid = -1;
+    }
+    m_buffer.clear();
+}
+
+auto EvalServer::send_all(std::string_view data) noexcept -> bool {
+    while (!data.empty()) {
+        const auto sent = ::send(m_socket, data.data(), data.size(), MSG_NOSIGNAL);
+        if (sent < 0 && errno == EINTR) {
+            continue;
+        }
+        if (sent <= 0) {
+            return false;
+        }
+        data.remove_prefix(static_cast<std::size_t>(sent));
+    }
+    return true;
+}
+
+auto EvalServer::receive_until(std::string_view sentinel) noexcept -> std::optional<std::vector<std::string>> {
+    std::vector<std::string> fields{};
+    std::size_t pos{};
+    while (true) {
+        // consume complete fields, which are NUL terminated
+        for (auto end = m_buffer.find('\0', pos); end != std::string::npos; end = m_buffer.find('\0', pos)) {
+            auto field = m_buffer.substr(pos, end - pos);
+            pos        = end + 1;
+            if (field == sentinel) {
+                m_buffer.erase(0, pos);
+                return std::make_optional(std::move(fields));
+            }
+            fields.emplace_back(std::move(field));
+        }
+
+        pollfd poll_fd{.fd = m_socket, .events = POLLIN, .revents = 0};
+        const int ready = ::poll(&poll_fd, 1, response_timeout_ms);
+        if (ready < 0 && errno == EINTR) {
+            continue;
+        }
+        if (ready <= 0) {
+            fmt::print(stderr, "bash did not respond in time\n");
+            return std::nullopt;
+        }
+
+        std::array<char, 4096> chunk{};
+        const auto received = ::recv(m_socket, chunk.data(), chunk.size(), 0);
+        if (received <= 0) {
+            return std::nullopt;
+        }
+        m_buffer.append(chunk.data(), static_cast<std::size_t>(received));
+    }
+}
+
+auto EvalServer::evaluate(const EvalRequest& request) noexcept -> std::optional<EvalResult> {
+    if (!std::ranges::all_of(request.variables, is_valid_identifier)) {
+        fmt::print(stderr, "Invalid variable name requested from '{}'\n", request.file_path);
+        return std::nullopt;
+    }
+
+    const std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_pid < 0 && !start()) {
+        return std::nullopt;
+    }
+    const auto& sentinel = fmt::format(FMT_COMPILE("__km_end_of_response_{}__"), ++m_request_count);
+
+    // each request runs in the subshell, so variables and functions don't leak into the next one.
+    // NOTE: output of the sourced file is discarded, only printf below writes the response.
+    std::string script{"(\n"};
+    script += fmt::format(FMT_COMPILE("cd -- {} || exit 1\n"), utils::shell_quote(request.working_dir));
+    script += request.prelude;
+    script += '\n';
+    script += fmt::format(FMT_COMPILE("source -- {} >/dev/null 2>&1\n"), utils::shell_quote(request.file_path));
+    for (auto&& variable : request.variables) {
+        script += fmt::format(FMT_COMPILE("printf '%s\\0' \"${{{}[*]}}\"\n"), variable);
+    }
+    if (request.list_functions) {
+        script += "printf '%s\\0' \"$(compgen -A function)\"\n";
+    }
+    script += ") </dev/null\n";
+    script += fmt::format(FMT_COMPILE("printf '%s\\0' '{}'\n"), sentinel);
+
+    if (!send_all(script)) {
+        fmt::print(stderr, "Failed to send request to bash: {}\n", std::strerror(errno));
+        stop();
+        return std::nullopt;
+    }
+    auto fields = receive_until(sentinel);
+    if (!fields) {
+        stop();
+        return std::nullopt;
+    }
+
+    // subshell exited early, e.g. the file doesn't exist
+    const auto expected_count = request.variables.size() + (request.list_functions ? 1 : 0);
+    if (fields->size() != expected_count) {
+        fmt::print(stderr, "Failed to evaluate '{}'\n", request.file_path);
+        return std::nullopt;
+    }
+
+    EvalResult result{};
+    if (request.list_functions) {
+        result.functions = utils::make_multiline(fields->back(), '\n');
+        fields->pop_back();
+    }
+    result.values = std::move(*fields);
+    return std::make_optional(std::move(result));
+}
+
+}  // namespace pkgbuild
@@ -0,0 +1,91 @@
+// Copyright (C) 2022-2024 Vladislav Nepogodin
+//
+// This file is part of CachyOS kernel manager.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#ifndef PKGBUILD_EVAL_HPP
+#define PKGBUILD_EVAL_HPP
+
+#include <cstdint>      // for uint64_t
+#include <mutex>        // for mutex
+#include <optional>     // for optional
+#include <span>         // for span
+#include <string>       // for string
+#include <string_view>  // for string_view
+#include <vector>       // for vector
+
+#include <sys/types.h>  // for pid_t
+
+namespace pkgbuild {
+
+/// @brief Query to evaluate a shell file, e.g. PKGBUILD or makepkg.conf.
+struct EvalRequest {
+    /// File to be sourced.
+    std::string_view file_path;
+    /// Directory to source the file from.
+    std::string_view working_dir;
+    /// Shell code evaluated before sourcing, e.g. option assignments.
+    std::string_view prelude{};
+    /// Variables to return, arrays are joined with spaces.
+    std::span<const std::string_view> variables{};
+    /// Return the names of the functions defined by the file.
+    bool list_functions{};
+};
+
+struct EvalResult {
+    /// Values in the order of the requested variables.
+    std::vector<std::string> values{};
+    std::vector<std::string> functions{};
+};
+
+/// @brief Long-lived bash coprocess, which evaluates shell files.
+///
+/// Every request is evaluated in a subshell, so nothing leaks between requests,
+/// and the results are returned as NUL separated fields over a socket.
+/// Bash is started with a minimal environment on first use,
+/// and restarted if it dies or doesn't answer in time.
+/// NOTE: the top-level code of PKGBUILD runs on every evaluation, so bash is sandboxed with bwrap:
+/// no network, read-only root except the working directory and the private /tmp.
+/// Without bwrap, or without the user namespaces, it runs unsandboxed.
+class EvalServer {
+ public:
+    EvalServer() = default;
+    ~EvalServer();
+
+    EvalServer(const EvalServer&)            = delete;
+    EvalServer& operator=(const EvalServer&) = delete;
+
+    /// @brief Process-wide server.
+    static auto instance() noexcept -> EvalServer&;
+
+    auto evaluate(const EvalRequest& request) noexcept -> std::optional<EvalResult>;
+
+ private:
+    auto start() noexcept -> bool;
+    void stop() noexcept;
+    auto send_all(std::string_view data) noexcept -> bool;
+    auto receive_until(std::string_view sentinel) noexcept -> std::optional<std::vector<std::string>>;
+
+    std::mutex m_mutex{};
+    pid_t m_pid{-1};
+    int m_socket{-1};
+    std::uint64_t m_request_count{};
+    std::string m_buffer{};
+};
+
+}  // namespace pkgbuild
+
+#endif  // PKGBUILD_EVAL_HPP
@@ -0,0 +1,116 @@
+// Copyright (C) 2022-2024 Vladislav Nepogodin
+//
+// This file is part of CachyOS kernel manager.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include "resource-graph.hpp"
+
+#include <algorithm>  // for max, ranges::max
+#include <utility>    // for move
+
+#if defined(__clang__)
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wold-style-cast"
+#elif defined(__GNUC__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wnull-dereference"
+#pragma GCC diagnostic ignored "-Wuseless-cast"
+#pragma GCC diagnostic ignored "-Wold-style-cast"
+#pragma GCC diagnostic ignored "-Wsuggest-final-types"
+#pragma GCC diagnostic ignored "-Wsuggest-attribute=pure"
+#pragma GCC diagnostic ignored "-Wconversion"
+#endif
+
+#include <QPainter>
+#include <QPainterPath>
+
+#if defined(__clang__)
+#pragma clang diagnostic pop
+#elif defined(__GNUC__)
+#pragma GCC diagnostic pop
+#endif
+
+ResourceGraph::ResourceGraph(QWidget* parent)
+  : QWidget(parent) {
+    setMinimumHeight(80);
+}
+
+void ResourceGraph::set_series(std::vector<Series> series, double max_value, QString unit) noexcept {
+    m_series    = std::move(series);
+    m_max_value = max_value;
+    m_unit      = std::move(unit);
+    update();
+}
+
+void ResourceGraph::set_capacity(std::size_t capacity) noexcept {
+    m_capacity = std::max<std::size_t>(capacity, 2);
+    update();
+}
+
+void ResourceGraph::paintEvent(QPaintEvent*) {
+    QPainter painter(this);
+    painter.setRenderHint(QPainter::Antialiasing);
+
+    const auto& graph_palette = palette();
+    painter.fillRect(rect(), graph_palette.base());
+    painter.setPen(graph_palette.mid().color());
+    painter.drawRect(rect().adjusted(0, 0, -1, -1));
+
+    // NOTE: graph scales to the maximum of the values, so the growing series stays visible.
+    double max_value = m_max_value;
+    if (max_value <= 0) {
+        for (auto&& series : m_series) {
+            if (!series.values.empty()) {
+                max_value = std::max(max_value, std::ranges::max(series.values));
+            }
+        }
+    }
+    max_value = std::max(max_value, 1e-9);
+
+    const auto graph_width  = static_cast<double>(width() - 1);
+    const auto graph_height = static_cast<double>(height() - 1);
+    const auto step         = graph_width / static_cast<double>(m_capacity - 1);
+    for (auto&& series : m_series) {
+        /* clang-format off */
+        if (series.values.empty()) { continue; }
+        /* clang-format on */
+
+        QPainterPath series_path{};
+        const auto first_x = graph_width - step * static_cast<double>(series.values.size() - 1);
+        for (std::size_t i = 0; i < series.values.size(); ++i) {
+            const QPointF point{first_x + step * static_cast<double>(i), graph_height * (1.0 - std::min(series.values[i] / max_value, 1.0))};
+            if (i == 0) {
+                series_path.moveTo(point);
+            } else {
+                series_path.lineTo(point);
+            }
+        }
+        painter.setPen(QPen(series.color, 1.5));
+        painter.drawPath(series_path);
+    }
+
+    // legend with the last values
+    const auto line_height = painter.fontMetrics().height();
+    auto text_y            = line_height;
+    painter.setPen(graph_palette.text().color());
+    painter.drawText(4, text_y, QStringLiteral("%1 %2").arg(max_value, 0, 'f', 1).arg(m_unit));
+    for (auto&& series : m_series) {
+        text_y += line_height;
+        painter.setPen(series.color);
+        const auto last_value = series.values.empty() ? 0.0 : series.values.back();
+        painter.drawText(4, text_y, QStringLiteral("%1: %2").arg(series.name).arg(last_value, 0, 'f', 1));
+    }
+}
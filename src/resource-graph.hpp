@@ -0,0 +1,84 @@
+// Copyright (C) 2022-2024 Vladislav Nepogodin
+//
+// This file is part of CachyOS kernel manager.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#ifndef RESOURCE_GRAPH_HPP_
+#define RESOURCE_GRAPH_HPP_
+
+#include <vector>  // for vector
+
+#if defined(__clang__)
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wsign-conversion"
+#pragma clang diagnostic ignored "-Wfloat-conversion"
+#pragma clang diagnostic ignored "-Wdouble-promotion"
+#pragma clang diagnostic ignored "-Wimplicit-int-float-conversion"
+#pragma clang diagnostic ignored "-Wdeprecated-enum-enum-conversion"
+#pragma clang diagnostic ignored "-Wshorten-64-to-32"
+#elif defined(__GNUC__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuseless-cast"
+#pragma GCC diagnostic ignored "-Wsign-conversion"
+#pragma GCC diagnostic ignored "-Wconversion"
+#pragma GCC diagnostic ignored "-Wdeprecated-enum-enum-conversion"
+#pragma GCC diagnostic ignored "-Wsuggest-attribute=pure"
+#pragma GCC diagnostic ignored "-Wsuggest-final-types"
+#pragma GCC diagnostic ignored "-Wsuggest-final-methods"
+#endif
+
+#include <QColor>
+#include <QString>
+#include <QWidget>
+
+#if defined(__clang__)
+#pragma clang diagnostic pop
+#elif defined(__GNUC__)
+#pragma GCC diagnostic pop
+#endif
+
+/// @brief Line graph of the sampled series, the newest sample is at the right edge.
+class ResourceGraph final : public QWidget {
+    Q_OBJECT
+    Q_DISABLE_COPY_MOVE(ResourceGraph)
+ public:
+    struct Series {
+        QString name{};
+        QColor color{};
+        std::vector<double> values{};
+    };
+
+    explicit ResourceGraph(QWidget* parent = nullptr);
+    ~ResourceGraph() = default;
+
+    /// @param max_value Top of the graph, the series are scaled to their maximum, if it's zero.
+    /// @param unit Unit of the values, shown next to the top value.
+    void set_series(std::vector<Series> series, double max_value, QString unit) noexcept;
+
+    /// @brief Count of the samples, which fit into the graph.
+    void set_capacity(std::size_t capacity) noexcept;
+
+ protected:
+    void paintEvent(QPaintEvent* event) override;
+
+ private:
+    std::vector<Series> m_series{};
+    double m_max_value{};
+    QString m_unit{};
+    std::size_t m_capacity{1};
+};
+
+#endif  // RESOURCE_GRAPH_HPP_
@@ -0,0 +1,264 @@
+// Copyright (C) 2022-2024 Vladislav Nepogodin
+//
+// This file is part of CachyOS kernel manager.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include "source_store.hpp"
+#include "utils.hpp"
+
+#include <algorithm>      // for sort
+#include <chrono>         // for file_clock
+#include <filesystem>     // for exists, create_hard_link, copy_file, directory_iterator
+#include <system_error>   // for error_code
+#include <unordered_set>  // for unordered_set
+#include <vector>         // for vector
+
+#include <fcntl.h>      // for open, O_RDONLY
+#include <linux/fs.h>   // for FICLONE
+#include <sys/ioctl.h>  // for ioctl
+#include <unistd.h>     // for close
+
+#include <fmt/compile.h>
+#include <fmt/core.h>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// NOTE: every extracted kernel tree takes more than 1 GiB.
+constexpr std::size_t pristine_trees_limit = 2;
+
+constexpr auto get_checksum_tool(std::string_view checksum_algo) noexcept -> std::string_view {
+    using namespace std::string_view_literals;
+    if (checksum_algo == "b2"sv) {
+        return "b2sum"sv;
+    } else if (checksum_algo == "sha256"sv) {
+        return "sha256sum"sv;
+    } else if (checksum_algo == "sha512"sv) {
+        return "sha512sum"sv;
+    }
+    return {};
+}
+
+// only remote sources are downloaded into SRCDEST, local files are taken from PKGBUILD directory
+constexpr auto is_downloadable(std::string_view source) noexcept -> bool {
+    return source.find("://") != std::string_view::npos;
+}
+
+// NOTE: extents are shared with reflink on filesystems supporting it, e.g. btrfs or xfs.
+auto reflink_or_copy(const fs::path& from, const fs::path& to) noexcept -> bool {
+    const int src_fd = ::open(from.c_str(), O_RDONLY | O_CLOEXEC);
+    if (src_fd >= 0) {
+        const int dst_fd     = ::open(to.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        const bool is_cloned = dst_fd >= 0 && ::ioctl(dst_fd, FICLONE, src_fd) == 0;
+        if (dst_fd >= 0) {
+            ::close(dst_fd);
+        }
+        ::close(src_fd);
+        if (is_cloned) {
+            return true;
+        }
+    }
+
+    std::error_code err_code{};
+    fs::copy_file(from, to, fs::copy_options::overwrite_existing, err_code);
+    if (err_code) {
+        fmt::print(stderr, "Failed to hand out '{}': {}\n", from.string(), err_code.message());
+        return false;
+    }
+    return true;
+}
+
+auto link_or_copy(const fs::path& from, const fs::path& to) noexcept -> bool {
+    std::error_code err_code{};
+    fs::create_hard_link(from, to, err_code);
+    return !err_code || reflink_or_copy(from, to);
+}
+
+}  // namespace
+
+namespace build {
+
+auto SourceStore::instance() noexcept -> SourceStore& {
+    static SourceStore store{utils::fix_path("~/.cache/cachyos-km/sources")};
+    return store;
+}
+
+auto SourceStore::get_srcdest(std::string_view variant) const noexcept -> std::string {
+    return fmt::format(FMT_COMPILE("{}/srcdest/{}"), m_store_dir, variant);
+}
+
+auto SourceStore::get_object_path(std::string_view checksum_algo, std::string_view checksum) const noexcept -> std::string {
+    return fmt::format(FMT_COMPILE("{}/objects/{}-{}"), m_store_dir, checksum_algo, checksum);
+}
+
+auto SourceStore::get_fetched_index_path(std::string_view url) const noexcept -> std::string {
+    return fmt::format(FMT_COMPILE("{}/fetched/{}"), m_store_dir, utils::sha256_hex(url));
+}
+
+auto SourceStore::get_fetched_etag_path(std::string_view url) const noexcept -> std::string {
+    return fmt::format(FMT_COMPILE("{}.etag"), get_fetched_index_path(url));
+}
+
+auto SourceStore::find_fetched(std::string_view url) const noexcept -> std::string {
+    const auto& object_name = utils::read_whole_file(get_fetched_index_path(url));
+    /* clang-format off */
+    if (object_name.empty()) { return {}; }
+    /* clang-format on */
+
+    auto object_path = fmt::format(FMT_COMPILE("{}/objects/{}"), m_store_dir, object_name);
+    std::error_code err_code{};
+    return fs::exists(object_path, err_code) ? object_path : std::string{};
+}
+
+auto SourceStore::ingest_fetched(std::string_view url, std::string_view file_path) const noexcept -> std::string {
+    const auto& digest      = utils::sha256_hex(utils::read_whole_file(file_path));
+    const auto& object_path = get_object_path("sha256", digest);
+
+    std::error_code err_code{};
+    fs::create_directories(fmt::format(FMT_COMPILE("{}/objects"), m_store_dir), err_code);
+    fs::create_directories(fmt::format(FMT_COMPILE("{}/fetched"), m_store_dir), err_code);
+    if (!fs::exists(object_path, err_code)) {
+        if (!link_or_copy(fs::path{file_path}, fs::path{object_path})) {
+            return {};
+        }
+        fs::permissions(object_path, fs::perms::owner_write | fs::perms::group_write | fs::perms::others_write, fs::perm_options::remove, err_code);
+    }
+
+    // the index is replaced at once, the concurrent fetches of the same url store the same object
+    const auto& index_path      = get_fetched_index_path(url);
+    const auto& temp_index_path = fmt::format(FMT_COMPILE("{}.tmp-{}"), index_path, digest);
+    if (!utils::write_to_file(temp_index_path, fmt::format(FMT_COMPILE("sha256-{}"), digest))) {
+        return {};
+    }
+    fs::rename(temp_index_path, index_path, err_code);
+    return err_code ? std::string{} : object_path;
+}
+
+auto SourceStore::hand_out_object(std::string_view object_path, std::string_view dest_path) noexcept -> bool {
+    std::error_code err_code{};
+    /* clang-format off */
+    if (fs::exists(dest_path, err_code) && fs::equivalent(object_path, dest_path, err_code)) { return true; }
+    /* clang-format on */
+    fs::remove(dest_path, err_code);
+    return link_or_copy(fs::path{object_path}, fs::path{dest_path});
+}
+
+auto SourceStore::hand_out(std::string_view srcdest, std::span<const SourceEntry> entries) const noexcept -> std::size_t {
+    std::error_code err_code{};
+    fs::create_directories(srcdest, err_code);
+    fs::create_directories(fmt::format(FMT_COMPILE("{}/objects"), m_store_dir), err_code);
+    if (err_code) {
+        fmt::print(stderr, "Failed to create source store: {}\n", err_code.message());
+        return 0;
+    }
+
+    std::unordered_set<std::string> handed_out_names{};
+    for (auto&& entry : entries) {
+        /* clang-format off */
+        if (!is_downloadable(entry.source) || entry.checksum.empty()) { continue; }
+        /* clang-format on */
+
+        const fs::path object_path{get_object_path(entry.checksum_algo, entry.checksum)};
+        /* clang-format off */
+        if (!fs::exists(object_path, err_code)) { continue; }
+        /* clang-format on */
+
+        // NOTE: only the file with the same name and the different content is replaced,
+        // the rest, e.g. the sources without the checksum, are reused by makepkg as they are.
+        const auto source_name = std::string{get_source_name(entry.source)};
+        const auto& dest_path  = fs::path{srcdest} / source_name;
+        if (hand_out_object(object_path.string(), dest_path.string())) {
+            handed_out_names.insert(source_name);
+        }
+    }
+    return handed_out_names.size();
+}
+
+auto SourceStore::make_ingest_cmd(std::string_view srcdest, std::span<const SourceEntry> entries) const noexcept -> std::string {
+    const auto& objects_dir = utils::shell_quote(fmt::format(FMT_COMPILE("{}/objects"), m_store_dir));
+
+    std::string result{"echo '==> Storing downloaded sources'\n"};
+    result += fmt::format(FMT_COMPILE("mkdir -p -- {}\n"), objects_dir);
+
+    std::unordered_set<std::string_view> seen_names{};
+    for (auto&& entry : entries) {
+        const auto source_name = get_source_name(entry.source);
+        /* clang-format off */
+        if (!is_downloadable(entry.source) || !seen_names.insert(source_name).second) { continue; }
+        /* clang-format on */
+
+        const auto& file_path    = utils::shell_quote(fmt::format(FMT_COMPILE("{}/{}"), srcdest, source_name));
+        const auto checksum_tool = get_checksum_tool(entry.checksum_algo);
+        if (!entry.checksum.empty() && !checksum_tool.empty()) {
+            // stored under the declared checksum, once the file is verified against it
+            const auto& object_path = utils::shell_quote(get_object_path(entry.checksum_algo, entry.checksum));
+            result += fmt::format(FMT_COMPILE("if [ -f {0} ] && [ ! -e {1} ] && printf '%s  %s\\n' {2} {0} | {3} -c --status; then ln -f -- {0} {1} && chmod a-w -- {1}; fi\n"),
+                file_path, object_path, utils::shell_quote(entry.checksum), checksum_tool);
+            continue;
+        }
+
+        // deduplicated by content, the file is replaced with the link to the same object
+        result += fmt::format(FMT_COMPILE("if [ -f {0} ] && km_digest=$(sha256sum < {0}); then km_object={1}/sha256-${{km_digest%% *}}; "
+                                          "if [ -e \"$km_object\" ]; then ln -f -- \"$km_object\" {0}; else ln -f -- {0} \"$km_object\" && chmod a-w -- \"$km_object\"; fi; fi\n"),
+            file_path, objects_dir);
+    }
+    return result;
+}
+
+auto SourceStore::use_pristine_dir(const SourceEntry& tarball) const noexcept -> std::string {
+    const auto& pristine_root = fs::path{m_store_dir} / "pristine";
+    const auto& pristine_dir  = pristine_root / (tarball.checksum.empty() ? std::string{get_source_name(tarball.source)} : fmt::format(FMT_COMPILE("{}-{}"), tarball.checksum_algo, tarball.checksum));
+
+    std::error_code err_code{};
+    fs::create_directories(pristine_root, err_code);
+    if (fs::exists(pristine_dir, err_code)) {
+        fs::last_write_time(pristine_dir, fs::file_time_type::clock::now(), err_code);
+    }
+
+    // drop the least recently used trees, including the partially extracted ones
+    std::vector<fs::directory_entry> pristine_trees{};
+    for (auto&& dir_entry : fs::directory_iterator{pristine_root, err_code}) {
+        if (dir_entry.path() != pristine_dir) {
+            pristine_trees.emplace_back(dir_entry);
+        }
+    }
+    std::ranges::sort(pristine_trees, [](auto&& lhs, auto&& rhs) { return lhs.last_write_time() > rhs.last_write_time(); });
+    for (std::size_t i = pristine_trees_limit - 1; i < pristine_trees.size(); ++i) {
+        fs::remove_all(pristine_trees[i].path(), err_code);
+    }
+    return pristine_dir.string();
+}
+
+auto SourceStore::make_pristine_extract_cmd(std::string_view pristine_dir, std::string_view tarball_path) noexcept -> std::string {
+    // NOTE: the build and the patch check may extract the same tree at once, each into its own directory.
+    // The one, which loses the race, drops its copy and takes the tree of the other.
+    const auto& quoted_dir           = utils::shell_quote(pristine_dir);
+    const auto& quoted_temp_template = utils::shell_quote(fmt::format(FMT_COMPILE("{}.XXXXXX"), pristine_dir));
+    const auto& quoted_parent_dir    = utils::shell_quote(fs::path{pristine_dir}.parent_path().string());
+    return fmt::format(FMT_COMPILE("[ -d {0} ] || {{ mkdir -p -- {1} && km_pristine_tmp=\"$(mktemp -d {2})\" && chmod 755 -- \"$km_pristine_tmp\" "
+                                   "&& {{ bsdtar -xf {3} -C \"$km_pristine_tmp\" && mv -T -- \"$km_pristine_tmp\" {0} 2>/dev/null || {{ rm -rf -- \"$km_pristine_tmp\"; [ -d {0} ]; }}; }}; }}"),
+        quoted_dir, quoted_parent_dir, quoted_temp_template, tarball_path);
+}
+
+auto SourceStore::make_pristine_restore_cmd(std::string_view pristine_dir, std::string_view tarball_name) noexcept -> std::string {
+    std::string result{"    # restore the pristine tree, the tarball is extracted only once per kernel version\n"};
+    result += fmt::format(FMT_COMPILE("    {} || return 1\n"), make_pristine_extract_cmd(pristine_dir, fmt::format(FMT_COMPILE("\"$srcdir\"/{}"), utils::shell_quote(tarball_name))));
+    result += fmt::format(FMT_COMPILE("    cp -a --reflink=auto -- {}/. \"$srcdir\"/ || return 1\n"), utils::shell_quote(pristine_dir));
+    return result;
+}
+
+}  // namespace build
@@ -0,0 +1,112 @@
+// Copyright (C) 2022-2024 Vladislav Nepogodin
+//
+// This file is part of CachyOS kernel manager.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#ifndef SOURCE_STORE_HPP
+#define SOURCE_STORE_HPP
+
+#include <cstddef>      // for size_t
+#include <span>         // for span
+#include <string>       // for string
+#include <string_view>  // for string_view
+#include <utility>      // for move
+
+namespace build {
+
+/// @brief Name of the source in SRCDEST and srcdir, same as makepkg computes it:
+/// 'name::url' or basename of url.
+constexpr auto get_source_name(std::string_view source) noexcept -> std::string_view {
+    if (auto pos = source.find("::"); pos != std::string_view::npos) {
+        source = source.substr(0, pos);
+    }
+    if (auto pos = source.find_last_of('/'); pos != std::string_view::npos) {
+        source.remove_prefix(pos + 1);
+    }
+    return source;
+}
+
+/// @brief Source from the source array, with the checksum declared by PKGBUILD.
+struct SourceEntry {
+    /// Entry of the source array, e.g. 'name::https://...'.
+    std::string source{};
+    /// Checksum algorithm, e.g. "b2" or "sha256", empty if the checksum is unknown or SKIP.
+    std::string checksum_algo{};
+    std::string checksum{};
+};
+
+/// @brief Content-addressed store of downloaded sources, shared by all kernel variants.
+///
+/// Objects are stored once at <store>/objects/<algo>-<checksum>, and handed out
+/// into SRCDEST of each variant as hardlinks (or reflinked copies), so makepkg
+/// doesn't download them again. Sources without the declared checksum are downloaded again,
+/// and deduplicated by content afterwards, except of the prefetched patches, which are kept by their URL.
+class SourceStore {
+ public:
+    explicit SourceStore(std::string store_dir) noexcept
+      : m_store_dir(std::move(store_dir)) { }
+
+    /// @brief Process-wide store at ~/.cache/cachyos-km/sources.
+    static auto instance() noexcept -> SourceStore&;
+
+    /// @brief SRCDEST of the variant.
+    auto get_srcdest(std::string_view variant) const noexcept -> std::string;
+
+    /// @brief Links the stored sources into srcdest, replacing the files of the same name
+    /// with the different content. Other files in srcdest are left alone.
+    /// @return Count of the sources, which were handed out from the store.
+    auto hand_out(std::string_view srcdest, std::span<const SourceEntry> entries) const noexcept -> std::size_t;
+
+    /// @brief Object of the patch, which was fetched from the url before, empty if there is none.
+    /// NOTE: the content behind the URL may have changed since, unless it's pinned to a commit.
+    auto find_fetched(std::string_view url) const noexcept -> std::string;
+
+    /// @brief File, which keeps the ETag of the url for the revalidation with curl.
+    auto get_fetched_etag_path(std::string_view url) const noexcept -> std::string;
+
+    /// @brief Stores the file fetched from the url by the sha256 of its content, and remembers it for the url.
+    /// @return Path of the object, empty on failure.
+    auto ingest_fetched(std::string_view url, std::string_view file_path) const noexcept -> std::string;
+
+    /// @brief Links the object into dest_path, replacing the file with the different content.
+    static auto hand_out_object(std::string_view object_path, std::string_view dest_path) noexcept -> bool;
+
+    /// @brief Shell command, which moves the downloaded sources into the store.
+    auto make_ingest_cmd(std::string_view srcdest, std::span<const SourceEntry> entries) const noexcept -> std::string;
+
+    /// @brief Directory of the pristine tree, extracted from the tarball.
+    /// Only the most recently used trees are kept, the rest are removed.
+    auto use_pristine_dir(const SourceEntry& tarball) const noexcept -> std::string;
+
+    /// @brief Shell command, which extracts the tarball into the pristine tree, unless it's already there.
+    /// It is extracted into the unique directory first, so the concurrent extractions don't clash.
+    /// @param tarball_path Path of the tarball, already quoted for the shell.
+    static auto make_pristine_extract_cmd(std::string_view pristine_dir, std::string_view tarball_path) noexcept -> std::string;
+
+    /// @brief Shell code for prepare(), which copies the pristine tree into srcdir with reflink,
+    /// the tarball is extracted into the pristine tree only on first use.
+    static auto make_pristine_restore_cmd(std::string_view pristine_dir, std::string_view tarball_name) noexcept -> std::string;
+
+ private:
+    auto get_object_path(std::string_view checksum_algo, std::string_view checksum) const noexcept -> std::string;
+    auto get_fetched_index_path(std::string_view url) const noexcept -> std::string;
+
+    std::string m_store_dir{};
+};
+
+}  // namespace build
+
+#endif  // SOURCE_STORE_HPP
@@ -20,6 +20,7 @@
 #define STRING_UTILS_HPP
 
 #include <algorithm>    // for transform, for_each
+#include <cstdint>      // for uint64_t, uint8_t
 #include <ranges>       // for ranges::*
 #include <span>         // for span
 #include <string>       // for string
@@ -82,6 +83,38 @@ constexpr auto make_multiline_view(std::string_view str, char delim = '\n') noex
     }();
 }
 
+/// @brief Quote a string to be safely passed as a single shell word.
+/// @param str The string to quote.
+/// @return The string wrapped into single quotes.
+constexpr auto shell_quote(std::string_view str) noexcept -> std::string {
+    std::string result{"'"};
+    for (auto ch : str) {
+        /* clang-format off */
+        if (ch == '\'') { result += "'\\''"; } else { result += ch; }
+        /* clang-format on */
+    }
+    result += '\'';
+    return result;
+}
+
+/// @brief Initial value of FNV-1a hash.
+inline constexpr std::uint64_t fnv1a_offset_basis = 0xcbf29ce484222325ULL;
+
+/// @brief Append a field to FNV-1a hash, fields are separated with '\0' to keep the boundaries.
+/// @param hash The hash of the previous fields.
+/// @param data The field to append.
+/// @return The updated hash.
+constexpr auto fnv1a_append(std::uint64_t hash, std::string_view data) noexcept -> std::uint64_t {
+    constexpr std::uint64_t fnv_prime = 0x100000001b3ULL;
+    for (auto ch : data) {
+        hash ^= static_cast<std::uint8_t>(ch);
+        hash *= fnv_prime;
+    }
+    // separator byte
+    hash *= fnv_prime;
+    return hash;
+}
+
 /// @brief Join a vector of strings into a single string using a delimiter.
 /// @param lines The lines to join.
 /// @param delim The delimiter to join the lines.
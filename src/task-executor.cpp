@@ -0,0 +1,98 @@
+// Copyright (C) 2022-2024 Vladislav Nepogodin
+//
+// This file is part of CachyOS kernel manager.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include "task-executor.hpp"
+
+#include <QPointer>
+
+TaskExecutor::TaskExecutor(QObject* parent)
+  : QObject(parent) {
+    m_serial_pool.setMaxThreadCount(1);
+    m_serial_pool.setObjectName("SerialLane");
+    m_pool.setObjectName("PoolLane");
+}
+
+TaskExecutor::~TaskExecutor() {
+    cancel_all();
+    wait_for_done();
+}
+
+void TaskExecutor::cancel(job_id_t job_id) noexcept {
+    const std::lock_guard<std::mutex> lock(m_mutex);
+    if (auto it = m_jobs.find(job_id); it != m_jobs.end()) {
+        it->second.request_stop();
+    }
+    if (auto it = m_delivering.find(job_id); it != m_delivering.end()) {
+        it->second.request_stop();
+    }
+}
+
+void TaskExecutor::cancel_all() noexcept {
+    const std::lock_guard<std::mutex> lock(m_mutex);
+    for (auto&& [job_id, source] : m_jobs) {
+        source.request_stop();
+    }
+    for (auto&& [job_id, source] : m_delivering) {
+        source.request_stop();
+    }
+}
+
+void TaskExecutor::wait_for_done() noexcept {
+    m_serial_pool.waitForDone();
+    m_pool.waitForDone();
+}
+
+auto TaskExecutor::is_running(job_id_t job_id) const noexcept -> bool {
+    const std::lock_guard<std::mutex> lock(m_mutex);
+    return m_jobs.contains(job_id);
+}
+
+auto TaskExecutor::register_job() noexcept -> std::pair<job_id_t, std::stop_token> {
+    const std::lock_guard<std::mutex> lock(m_mutex);
+    const auto job_id = m_next_id++;
+    auto& source      = m_jobs[job_id];
+    return {job_id, source.get_token()};
+}
+
+void TaskExecutor::finish_job(job_id_t job_id, bool canceled) noexcept {
+    {
+        const std::lock_guard<std::mutex> lock(m_mutex);
+        m_jobs.erase(job_id);
+    }
+    // NOTE: emitted from the worker thread, receivers in the GUI thread get it queued.
+    emit job_finished(job_id, canceled);
+}
+
+auto TaskExecutor::begin_delivery(job_id_t job_id) noexcept -> std::shared_ptr<void> {
+    {
+        // NOTE: the copy of stop_source shares the stop state with the job's token.
+        const std::lock_guard<std::mutex> lock(m_mutex);
+        if (auto it = m_jobs.find(job_id); it != m_jobs.end()) {
+            m_delivering.emplace(job_id, it->second);
+        }
+    }
+    // the guard is released, once the callback has run, or was dropped together with its context,
+    // which may happen after the executor is gone.
+    return {nullptr, [executor = QPointer<TaskExecutor>{this}, job_id](void*) {
+                /* clang-format off */
+                if (executor.isNull()) { return; }
+                /* clang-format on */
+                const std::lock_guard<std::mutex> lock(executor->m_mutex);
+                executor->m_delivering.erase(job_id);
+            }};
+}
@@ -0,0 +1,172 @@
+// Copyright (C) 2022-2024 Vladislav Nepogodin
+//
+// This file is part of CachyOS kernel manager.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#ifndef TASK_EXECUTOR_HPP_
+#define TASK_EXECUTOR_HPP_
+
+#include <cstdint>        // for uint64_t, uint8_t
+#include <memory>         // for make_shared, shared_ptr
+#include <mutex>          // for mutex
+#include <stop_token>     // for stop_source, stop_token
+#include <type_traits>    // for decay_t, invoke_result_t, is_null_pointer_v, is_void_v
+#include <unordered_map>  // for unordered_map
+#include <utility>        // for move, pair
+
+#if defined(__clang__)
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wsign-conversion"
+#pragma clang diagnostic ignored "-Wfloat-conversion"
+#pragma clang diagnostic ignored "-Wdouble-promotion"
+#pragma clang diagnostic ignored "-Wimplicit-int-float-conversion"
+#pragma clang diagnostic ignored "-Wdeprecated-enum-enum-conversion"
+#pragma clang diagnostic ignored "-Wshorten-64-to-32"
+#elif defined(__GNUC__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuseless-cast"
+#pragma GCC diagnostic ignored "-Wsign-conversion"
+#pragma GCC diagnostic ignored "-Wconversion"
+#pragma GCC diagnostic ignored "-Wdeprecated-enum-enum-conversion"
+#pragma GCC diagnostic ignored "-Wsuggest-attribute=pure"
+#pragma GCC diagnostic ignored "-Wsuggest-final-types"
+#pragma GCC diagnostic ignored "-Wsuggest-final-methods"
+#endif
+
+#include <QObject>
+#include <QThreadPool>
+
+#if defined(__clang__)
+#pragma clang diagnostic pop
+#elif defined(__GNUC__)
+#pragma GCC diagnostic pop
+#endif
+
+/// @brief Runs background jobs and delivers their results to the GUI thread.
+///
+/// Jobs on the serial lane run one after another in submission order
+/// (e.g. pacman transactions), jobs on the pool lane run concurrently.
+/// Each job receives std::stop_token, which is requested on cancel.
+/// Result of canceled job is dropped, instead of being delivered,
+/// also if the job is canceled after it has finished, but before the result reached the context.
+class TaskExecutor final : public QObject {
+    Q_OBJECT
+    Q_DISABLE_COPY_MOVE(TaskExecutor)
+ public:
+    using job_id_t = std::uint64_t;
+
+    enum class Lane : std::uint8_t {
+        Serial,
+        Pool,
+    };
+
+    explicit TaskExecutor(QObject* parent = nullptr);
+    ~TaskExecutor() override;
+
+    /// @brief Runs func(std::stop_token) in the background,
+    /// and on_done(result) in the thread of the context object.
+    /// NOTE: context must outlive the executor, or the job.
+    template <typename Func, typename Done>
+    auto run(Lane lane, QObject* context, Func&& func, Done&& on_done) noexcept -> job_id_t;
+
+    /// @brief Runs func(std::stop_token) in the background, without result.
+    template <typename Func>
+    auto run(Lane lane, Func&& func) noexcept -> job_id_t {
+        return run(lane, nullptr, std::forward<Func>(func), nullptr);
+    }
+
+    void cancel(job_id_t job_id) noexcept;
+    void cancel_all() noexcept;
+
+    /// @brief Blocks until all of the queued and running jobs are finished.
+    void wait_for_done() noexcept;
+
+    auto is_running(job_id_t job_id) const noexcept -> bool;
+
+ signals:
+    void job_finished(TaskExecutor::job_id_t job_id, bool canceled);
+
+ private:
+    auto register_job() noexcept -> std::pair<job_id_t, std::stop_token>;
+    void finish_job(job_id_t job_id, bool canceled) noexcept;
+    /// @brief Keeps the job cancelable, until the returned guard is released by the delivered callback.
+    auto begin_delivery(job_id_t job_id) noexcept -> std::shared_ptr<void>;
+
+    /* clang-format off */
+    auto get_pool(Lane lane) noexcept -> QThreadPool*
+    { return (lane == Lane::Serial) ? &m_serial_pool : &m_pool; }
+    /* clang-format on */
+
+    mutable std::mutex m_mutex{};
+    job_id_t m_next_id{1};
+    std::unordered_map<job_id_t, std::stop_source> m_jobs{};
+    /// Jobs, whose result is posted to the context, but isn't delivered yet.
+    std::unordered_map<job_id_t, std::stop_source> m_delivering{};
+
+    QThreadPool m_serial_pool{};
+    QThreadPool m_pool{};
+};
+
+template <typename Func, typename Done>
+auto TaskExecutor::run(Lane lane, QObject* context, Func&& func, Done&& on_done) noexcept -> job_id_t {
+    using result_t              = std::invoke_result_t<Func, std::stop_token>;
+    constexpr bool has_on_done  = !std::is_null_pointer_v<std::decay_t<Done>>;
+    const auto& [job_id, token] = register_job();
+
+    get_pool(lane)->start([this, job_id = job_id, token = token, context, func = std::forward<Func>(func), on_done = std::forward<Done>(on_done)]() mutable {
+        if (token.stop_requested()) {
+            finish_job(job_id, true);
+            return;
+        }
+
+        if constexpr (std::is_void_v<result_t>) {
+            func(token);
+            if constexpr (has_on_done) {
+                if (context != nullptr && !token.stop_requested()) {
+                    QMetaObject::invokeMethod(
+                        context,
+                        [token, delivery = begin_delivery(job_id), on_done = std::move(on_done)]() mutable {
+                            /* clang-format off */
+                            if (token.stop_requested()) { return; }
+                            /* clang-format on */
+                            on_done();
+                        },
+                        Qt::QueuedConnection);
+                }
+            }
+        } else {
+            // NOTE: the result is shared, because the functor passed to Qt must be copyable.
+            auto result = std::make_shared<result_t>(func(token));
+            if constexpr (has_on_done) {
+                if (context != nullptr && !token.stop_requested()) {
+                    QMetaObject::invokeMethod(
+                        context,
+                        [token, delivery = begin_delivery(job_id), result, on_done = std::move(on_done)]() mutable {
+                            /* clang-format off */
+                            if (token.stop_requested()) { return; }
+                            /* clang-format on */
+                            on_done(std::move(*result));
+                        },
+                        Qt::QueuedConnection);
+                }
+            }
+        }
+        finish_job(job_id, token.stop_requested());
+    });
+    return job_id;
+}
+
+#endif  // TASK_EXECUTOR_HPP_
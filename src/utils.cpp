@@ -142,6 +142,26 @@ std::string fix_path(std::string&& path) noexcept {
     return std::move(path);
 }
 
+auto sha256_hex(std::string_view data) noexcept -> std::string {
+    auto* checksum = g_checksum_new(G_CHECKSUM_SHA256);
+    g_checksum_update(checksum, reinterpret_cast<const guchar*>(data.data()), static_cast<gssize>(data.size()));
+    std::string result{g_checksum_get_string(checksum)};
+    g_checksum_free(checksum);
+    return result;
+}
+
+auto sha256_hex_fields(std::span<const std::string> fields) noexcept -> std::string {
+    auto* checksum = g_checksum_new(G_CHECKSUM_SHA256);
+    for (auto&& field : fields) {
+        const auto& length_prefix = fmt::format("{}:", field.size());
+        g_checksum_update(checksum, reinterpret_cast<const guchar*>(length_prefix.data()), static_cast<gssize>(length_prefix.size()));
+        g_checksum_update(checksum, reinterpret_cast<const guchar*>(field.data()), static_cast<gssize>(field.size()));
+    }
+    std::string result{g_checksum_get_string(checksum)};
+    g_checksum_free(checksum);
+    return result;
+}
+
 void prepare_build_environment() noexcept {
     static const fs::path app_path       = utils::fix_path("~/.cache/cachyos-km");
     static const fs::path pkgbuilds_path = utils::fix_path("~/.cache/cachyos-km/pkgbuilds");
@@ -170,29 +190,4 @@ void prepare_build_environment() noexcept {
     }
 }
 
-void restore_clean_environment(std::vector<std::string>& previously_set_options, std::string_view all_set_values) noexcept {
-    // Unset env variables before appplying new ones.
-    for (auto&& previous_option : previously_set_options) {
-        if (unsetenv(previous_option.c_str()) != 0) {
-            fmt::print(stderr, "Cannot unset environment variable!: {}\n", std::strerror(errno));
-        }
-    }
-    previously_set_options.clear();
-
-    auto set_values_list = utils::make_split_view(all_set_values, '\n');
-    for (auto&& expr : set_values_list) {
-        auto expr_split = utils::make_multiline(std::move(expr), '=');
-        auto var_name   = expr_split[0];
-
-        const auto& var_val = expr_split[1];
-        if (::setenv(var_name.c_str(), var_val.c_str(), 1) != 0) {
-            fmt::print(stderr, "Cannot set environment variable!: {}\n", std::strerror(errno));
-            continue;
-        }
-
-        // Save env name to unset it before running the next compilation.
-        previously_set_options.emplace_back(std::move(var_name));
-    }
-}
-
 }  // namespace utils
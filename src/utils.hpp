@@ -22,6 +22,7 @@
 #include "alpm_utils.hpp"
 #include "string_utils.hpp"
 
+#include <span>         // for span
 #include <string>       // for string
 #include <string_view>  // for string_view
 #include <vector>       // for vector
@@ -54,11 +55,16 @@ bool write_to_file(std::string_view filepath, std::string_view data) noexcept;
 std::string exec(std::string_view command) noexcept;
 [[nodiscard]] std::string fix_path(std::string&& path) noexcept;
 
+/// @brief SHA-256 of the data, as the lowercase hex string.
+[[nodiscard]] auto sha256_hex(std::string_view data) noexcept -> std::string;
+
+/// @brief SHA-256 of the fields, each prefixed with its length, so the boundaries of the fields can't shift.
+[[nodiscard]] auto sha256_hex_fields(std::span<const std::string> fields) noexcept -> std::string;
+
 // Runs a command in a terminal, escalates using pkexec if escalate is true
 int runCmdTerminal(QString cmd, bool escalate) noexcept;
 
 void prepare_build_environment() noexcept;
-void restore_clean_environment(std::vector<std::string>& previously_set_options, std::string_view all_set_values) noexcept;
 
 }  // namespace utils
 